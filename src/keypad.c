@@ -1,56 +1,766 @@
 #include <keypad.h>
 #include <keypad_config.h>
 
+#if (KEYPAD_SPECULATIVE_EVENTS && (KEYPAD_DEBOUNCE_MODE == KEYPAD_DEBOUNCE_EAGER))
+#error "KEYPAD_SPECULATIVE_EVENTS requires KEYPAD_DEBOUNCE_DEFERRED, eager mode already reports presses immediately"
+#endif
+
+#if (KEYPAD_EDGE_TIMESTAMPS && (KEYPAD_DEBOUNCE_MODE == KEYPAD_DEBOUNCE_EAGER))
+#error "KEYPAD_EDGE_TIMESTAMPS requires KEYPAD_DEBOUNCE_DEFERRED"
+#endif
+
+#if (KEYPAD_BIDIRECTIONAL && KEYPAD_EDGE_TIMESTAMPS)
+#error "KEYPAD_BIDIRECTIONAL swaps the roles of rows and columns, KEYPAD_EDGE_TIMESTAMPS needs fixed column lines"
+#endif
+
+#if (KEYPAD_BIDIRECTIONAL && defined(KEYPAD_LINUX_GPIO_CHIP))
+#error "KEYPAD_BIDIRECTIONAL swaps the line directions at run time, the libgpiod backend requests them only once"
+#endif
+
+#if (KEYPAD_CHARLIEPLEX && (KEYPAD_EDGE_TIMESTAMPS || KEYPAD_BIDIRECTIONAL ||                                  \
+                            (KEYPAD_PRESENCE_DETECT == KEYPAD_PRESENCE_SIGNATURE)))
+#error "KEYPAD_CHARLIEPLEX can not be combined with modes that reconfigure the row and column lines"
+#endif
+
+#if (KEYPAD_CHARLIEPLEX && defined(KEYPAD_LINUX_GPIO_CHIP))
+#error "KEYPAD_CHARLIEPLEX switches the line directions at run time, the libgpiod backend requests them only once"
+#endif
+
+#if (KEYPAD_MUX && (KEYPAD_EDGE_TIMESTAMPS || KEYPAD_BIDIRECTIONAL ||                                          \
+                    (KEYPAD_PRESENCE_DETECT == KEYPAD_PRESENCE_SIGNATURE)))
+#error "KEYPAD_MUX can not be combined with modes that need a GPIO line per column"
+#endif
+
+#if (KEYPAD_MUX && !defined(KEYPAD_GPIO_MODE_OUT_PP))
+#error "KEYPAD_MUX requires push-pull outputs, keypad_config.h does not define KEYPAD_GPIO_MODE_OUT_PP"
+#endif
+
+#if ((KEYPAD_PRESENCE_DETECT == KEYPAD_PRESENCE_SIGNATURE) && !defined(KEYPAD_GPIO_MODE_IPD))
+#error "KEYPAD_PRESENCE_SIGNATURE requires input pull-downs, keypad_config.h does not define KEYPAD_GPIO_MODE_IPD"
+#endif
+
+#if (KEYPAD_MPU && (KEYPAD_EDGE_TIMESTAMPS || KEYPAD_GPIO_BITBAND || KEYPAD_LATENCY_TRACKING ||                 \
+                    KEYPAD_FAULT_INJECTION))
+#error "KEYPAD_MPU can not be combined with modes that reach the DWT, the bit-band region or consumer-written data"
+#endif
+
+#if (KEYPAD_MPU && defined(KEYPAD_LINUX_GPIO_CHIP))
+#error "KEYPAD_MPU requires a FreeRTOS MPU port, the Linux port has no memory protection"
+#endif
+
+// The timing is configured in real time units since the keypad timing layer was introduced.
+#if defined(KEYPAD_TASK_DELAY_TIME) || defined(KEYPAD_DEBOUNCE_TIME) || defined(KEYPAD_GPIO_STABILIZATION_TIME) || \
+    defined(KEYPAD_EAGER_HOLDOFF_TIME)
+#error "keypad_config.h uses tick based *_TIME settings, use KEYPAD_TASK_DELAY_MS, KEYPAD_DEBOUNCE_MS, ... instead"
+#endif
+
+// Compile-time checks of the configuration, a failed check declares an array of negative size.
+#define KEYPAD_STATIC_ASSERT(COND, NAME) typedef char keypad_static_assert_##NAME[(COND) ? 1 : -1]
+
+KEYPAD_STATIC_ASSERT(KEYPAD_TASK_DELAY_MS > 0, scan_period_must_be_positive);
+KEYPAD_STATIC_ASSERT(KEYPAD_DEBOUNCE_MS > 0, debounce_time_must_be_positive);
+KEYPAD_STATIC_ASSERT(KEYPAD_EAGER_HOLDOFF_MS > 0, holdoff_time_must_be_positive);
+KEYPAD_STATIC_ASSERT(KEYPAD_GPIO_STABILIZATION_US < (KEYPAD_TASK_DELAY_MS * 1000UL), stabilization_exceeds_scan_period);
+KEYPAD_STATIC_ASSERT(KEYPAD_PRESENCE_PROBE_MS >= KEYPAD_TASK_DELAY_MS, probe_interval_below_scan_period);
+KEYPAD_STATIC_ASSERT(KEYPAD_WATCHDOG_RECOVER_MS == 0 || KEYPAD_WATCHDOG_RECOVER_MS >= KEYPAD_WATCHDOG_STALL_MS,
+                     recovery_before_stall);
+
+#if KEYPAD_BIDIRECTIONAL && defined(KEY_REVERSE)
+// KEY_REVERSE gives the event word of a reverse key, the key bits must stay within KEY_EVENT_BITMASK.
+KEYPAD_STATIC_ASSERT(KEY_EVENT_KIND(KEY_REVERSE(KEY_EVENT_BITMASK)) == KEY_EVENT_UPPER
+                         && KEY_EVENT_KEYS(KEY_REVERSE(KEY_EVENT_BITMASK)) == KEY_EVENT_BITMASK,
+                     reverse_keys_must_fit_event_word);
+#endif
+
+#if KEYPAD_MPU
+// MPU regions are powers of two, the keypad task stack is one too.
+#define KEYPAD_POWER_OF_TWO(N) ((N) != 0 && ((N) & ((N) - 1)) == 0)
+KEYPAD_STATIC_ASSERT(KEYPAD_POWER_OF_TWO(KEYPAD_MPU_PRIVATE_SIZE), private_region_size_must_be_power_of_two);
+KEYPAD_STATIC_ASSERT(KEYPAD_POWER_OF_TWO(KEYPAD_MPU_SHARED_SIZE), shared_region_size_must_be_power_of_two);
+KEYPAD_STATIC_ASSERT(KEYPAD_MPU_PRIVATE_SIZE >= 32 && KEYPAD_MPU_SHARED_SIZE >= 32, region_size_below_32_bytes);
+KEYPAD_STATIC_ASSERT(KEYPAD_POWER_OF_TWO(KEYPAD_TASK_STACK_SIZE * sizeof(StackType_t)), stack_must_be_power_of_two);
+#endif
+
+// Longest wait of the keypad task for room in the timer command queue, one scan period. A timer command that
+// does not fit in time is a fault, see keypad_timer_check.
+#define KEYPAD_TIMER_TIMEOUT KEYPAD_MS_TO_TICKS(KEYPAD_TASK_DELAY_MS)
+
+#if KEYPAD_WATCHDOG
+// Record the stage of the keypad task in the heartbeat, and flag the timer commands: the task blocks in them
+// while the timer command queue is full. The flag stays set once a command timed out.
+#define KEYPAD_STAGE(STAGE, INDEX)        \
+    do {                                  \
+        keypad_heartbeat.stage = (STAGE); \
+        keypad_heartbeat.index = (INDEX); \
+    } while (0)
+#define KEYPAD_TIMER_WAIT(COMMAND)                         \
+    do {                                                   \
+        keypad_heartbeat.timer_wait = 1;                   \
+        keypad_timer_check(COMMAND);                       \
+        keypad_heartbeat.timer_wait = keypad_timer_failed; \
+    } while (0)
+#else
+#define KEYPAD_STAGE(STAGE, INDEX)
+#define KEYPAD_TIMER_WAIT(COMMAND) keypad_timer_check(COMMAND)
+#endif
+
+#if KEYPAD_FAULT_INJECTION
+// Route the GPIO and kernel object accesses of the keypad task through the fault injection hooks.
+#include <keypad_fault.h>
+#define KEYPAD_COL_FAULT(INDEX, COL, LEVEL) keypad_fault_read(INDEX, COL, LEVEL)
+#define KEYPAD_TIMER_RESET(TIMER)           KEYPAD_TIMER_WAIT(keypad_fault_timer_reset(TIMER, KEYPAD_TIMER_TIMEOUT))
+#define KEYPAD_TIMER_STOP(TIMER)            KEYPAD_TIMER_WAIT(keypad_fault_timer_stop(TIMER, KEYPAD_TIMER_TIMEOUT))
+#define KEYPAD_QUEUE_SEND(QUEUE, ITEM)      keypad_fault_queue_send(QUEUE, ITEM)
+#define KEYPAD_CYCLE_DELAY(DELAY)           keypad_fault_delay(DELAY)
+#else
+#define KEYPAD_COL_FAULT(INDEX, COL, LEVEL) (LEVEL)
+#define KEYPAD_TIMER_RESET(TIMER)           KEYPAD_TIMER_WAIT(xTimerReset(TIMER, KEYPAD_TIMER_TIMEOUT))
+#define KEYPAD_TIMER_STOP(TIMER)            KEYPAD_TIMER_WAIT(xTimerStop(TIMER, KEYPAD_TIMER_TIMEOUT))
+#define KEYPAD_QUEUE_SEND(QUEUE, ITEM)      xQueueSend(QUEUE, ITEM, 0)
+#define KEYPAD_CYCLE_DELAY(DELAY)           (DELAY)
+#endif
+
+// GPIO drivers configured without KEYPAD_GPIO_FINISH use the pins as soon as KEYPAD_GPIO_INIT returns.
+#ifndef KEYPAD_GPIO_FINISH
+#define KEYPAD_GPIO_FINISH() 0
+#endif
+
+// Clock timing the scans for the statistics, the tick count when keypad_config.h has no finer one.
+#ifndef KEYPAD_SCAN_CLOCK
+#define KEYPAD_SCAN_CLOCK()  xTaskGetTickCount()
+#define KEYPAD_SCAN_CLOCK_HZ configTICK_RATE_HZ
+#endif
+
+// Number of keypads serviced by the keypad task.
+#define KEYPAD_INSTANCE_COUNT (sizeof(KEYPAD_LAYOUT) / sizeof(KEYPAD_LAYOUT[0]))
+
+// Number of key sets read from the lines of a keypad, the reverse pass of KEYPAD_BIDIRECTIONAL reads a second one.
+#define KEYPAD_SCAN_PASSES (KEYPAD_BIDIRECTIONAL ? 2 : 1)
+
+#if KEYPAD_MPU
+// Linker sections of the keypad data, see KEYPAD_MPU in keypad_config.h. The keypad task reaches both of them,
+// unprivileged consumers can only read the shared one.
+#define KEYPAD_PRIVATE __attribute__((section(".keypad_mpu_private")))
+#define KEYPAD_SHARED  __attribute__((section(".keypad_mpu_shared")))
+#else
+#define KEYPAD_PRIVATE
+#define KEYPAD_SHARED
+#endif
+
 // Global variables
-keypad_t keypad;                              // Structure holding the state of the keypad.
-EventGroupHandle_t keypad_event_group = NULL; //Event group handle for keypad events.
-QueueHandle_t keypad_queue = NULL;            //Queue handle for keypad input.
+keypad_t keypads[KEYPAD_INSTANCE_COUNT] KEYPAD_SHARED;      // Structures holding the state of every keypad.
+EventGroupHandle_t keypad_event_group KEYPAD_SHARED = NULL; //Event group handle for keypad events of the first keypad.
+QueueHandle_t keypad_queue KEYPAD_SHARED = NULL;            //Queue handle for keypad input of the first keypad.
+
+static uint8_t keypad_row_max KEYPAD_PRIVATE;       // Largest row count of all keypads
+static uint8_t keypad_col_max KEYPAD_PRIVATE;       // Largest column count of all keypads
+static uint8_t keypad_reversed KEYPAD_PRIVATE;      // Whether the columns drive, see KEYPAD_BIDIRECTIONAL
+static uint32_t keypad_scan_cycle KEYPAD_PRIVATE;   // Number of scan cycles, selects the rows sampled in each cycle
+static uint8_t keypad_boosted KEYPAD_PRIVATE;       // Whether the task currently runs at KEYPAD_TASK_PRIORITY_BOOST
+static TickType_t keypad_tick_boost KEYPAD_PRIVATE; // Tick count at which the current boost started
+static keypad_stats_t keypad_stats KEYPAD_PRIVATE;  // Statistics of the keypad task
+static TickType_t keypad_task_delay KEYPAD_SHARED;  // Scan period, KEYPAD_TASK_DELAY_MS unless changed at run time
+
+// Snapshot of the statistics and keypad states, published once per scan cycle for lock-free readers.
+typedef struct {
+    keypad_stats_t stats;                        // Statistics of the keypad task
+    keypad_state_t state[KEYPAD_INSTANCE_COUNT]; // State of every keypad
+} keypad_snapshot_t;
+
+// The keypad task fills the buffer readers are not using and then flips the generation, see keypad_get_stats.
+static keypad_snapshot_t keypad_snapshots[2] KEYPAD_SHARED;
+static volatile uint32_t keypad_snapshot_gen KEYPAD_SHARED = 0;
+
+// Ring of the most recent events, entry N is stored at N % KEYPAD_TRACE_SIZE.
+static keypad_trace_t keypad_trace[KEYPAD_TRACE_SIZE] KEYPAD_SHARED;
+static volatile uint32_t keypad_trace_count KEYPAD_SHARED = 0;
+
+// Handle of the keypad task, deleted and created again by the watchdog recovery.
+static TaskHandle_t keypad_task KEYPAD_PRIVATE = NULL;
+
+#if KEYPAD_WATCHDOG
+// Heartbeat of the keypad task read by keypad_watchdog_check, and the number of restarts it did.
+static volatile keypad_heartbeat_t keypad_heartbeat KEYPAD_SHARED;
+static volatile uint32_t keypad_recoveries KEYPAD_SHARED = 0;
+
+// Whether a timer command of the keypad task timed out, see keypad_timer_check.
+static uint8_t keypad_timer_failed KEYPAD_PRIVATE = 0;
+
+#if (KEYPAD_WATCHDOG_RECOVER_MS > 0)
+// Restarts in a row without a completed cycle, each one doubles the delay before the next, up to
+// KEYPAD_WATCHDOG_BACKOFF_MAX doublings, and the cycle count at the last restart.
+#define KEYPAD_WATCHDOG_BACKOFF_MAX 4
+static uint8_t keypad_recover_backoff KEYPAD_PRIVATE = 0;
+static uint32_t keypad_recover_count KEYPAD_PRIVATE = 0;
+#endif
+#endif
+
+// Timing change requested by keypad_set_timing, applied by the keypad task.
+static volatile TickType_t keypad_request_period KEYPAD_PRIVATE;
+static volatile TickType_t keypad_request_debounce KEYPAD_PRIVATE;
+static volatile uint8_t keypad_request_timing KEYPAD_PRIVATE = 0;
+
+// Self-test requested by keypad_selftest, run by the keypad task.
+static volatile uint8_t keypad_selftest_index KEYPAD_PRIVATE;
+static volatile uint32_t keypad_selftest_result KEYPAD_PRIVATE;
+static volatile uint8_t keypad_selftest_state KEYPAD_PRIVATE = 0; // 0: idle, 1: requested, 2: done
+
+#if KEYPAD_LATENCY_TRACKING
+// Ring of the emit ticks of the events in each keypad queue, in queue order. keypad_publish adds an entry before
+// sending an event and keypad_event_receive removes the oldest one after receiving, so the ring holds up to two
+// entries more than the queue. The ring only follows the queue with a single consumer receiving from it, a second
+// one could take an event between the receive and the ring update of the first.
+#define KEYPAD_EMIT_RING_SIZE (KEYPAD_QUEUE_SIZE + 2)
+static TickType_t keypad_emit_tick[KEYPAD_INSTANCE_COUNT][KEYPAD_EMIT_RING_SIZE];
+static volatile uint8_t keypad_emit_head[KEYPAD_INSTANCE_COUNT]; // Written by the keypad task only
+static volatile uint8_t keypad_emit_tail[KEYPAD_INSTANCE_COUNT]; // Written by the consumer only
+
+// Consumer receiving from each keypad queue, set by keypad_consumer_init.
+static keypad_consumer_t* keypad_emit_consumer[KEYPAD_INSTANCE_COUNT];
+
+// Largest latency above KEYPAD_LATENCY_SLO_MS reported by the consumers of each keypad, published as
+// KEY_LATENCY.
+static volatile TickType_t keypad_latency_miss[KEYPAD_INSTANCE_COUNT];
+#endif
+
+#if KEYPAD_EDGE_TIMESTAMPS
+// Ring of the edge timestamps of one column line, filled by keypad_edge_isr and drained by the keypad task.
+typedef struct {
+    uint32_t stamp[KEYPAD_EDGE_RING_SIZE]; // Edge timestamps, in KEYPAD_EDGE_CLOCK counts
+    volatile uint8_t head;                 // Next entry to fill, written by the interrupt only
+    volatile uint8_t tail;                 // Next entry to drain, written by the keypad task only
+    volatile uint8_t overflow;             // Number of edges dropped because the ring was full
+} keypad_edge_ring_t;
+
+// Edge rings of the column lines of every keypad, and the overflow count of each ring the keypad task has seen.
+static keypad_edge_ring_t keypad_edge_rings[KEYPAD_INSTANCE_COUNT][KEYPAD_EDGE_MAX_COLS];
+static uint8_t keypad_edge_overflow[KEYPAD_INSTANCE_COUNT][KEYPAD_EDGE_MAX_COLS];
+
+// Edges are only recorded while the rows are held low between scans, from the end of the guard time on.
+static volatile uint8_t keypad_edge_armed = 0;
+static volatile uint32_t keypad_edge_armed_at;
+
+// Debounce state of every keypad: the clock of its last edge and whether the pressed keys were then quiet
+// for the settle time. Times are in KEYPAD_EDGE_CLOCK counts.
+static uint32_t keypad_edge_last[KEYPAD_INSTANCE_COUNT];
+static uint8_t keypad_edge_stable[KEYPAD_INSTANCE_COUNT];
+static uint32_t keypad_edge_settle; // KEYPAD_EDGE_SETTLE_US in clock counts
+static uint32_t keypad_edge_guard;  // KEYPAD_EDGE_GUARD_US in clock counts
+#endif
+
+#if KEYPAD_CHARLIEPLEX
+// Largest number of pins of a charlieplexed keypad, 6 pins give 30 keys.
+#define KEYPAD_CHARLIEPLEX_MAX_PINS 6
+
+// Pin driving in the current pass of every charlieplexed keypad, row_count while none drives.
+static uint8_t keypad_charlie_drive[KEYPAD_INSTANCE_COUNT] KEYPAD_PRIVATE;
+
+#ifdef KEYPAD_GPIO_MODE_REG
+// Mode register image of a pin of a charlieplexed keypad, computed by keypad_gpio_init.
+typedef struct {
+    volatile uint32_t* reg; // Mode register of the pin
+    uint32_t mask;          // Mode bits of the pin in the register
+    uint32_t drive;         // Mode bits while the pin drives, open-drain output
+    uint32_t sense;         // Mode bits while the pin senses, input with pull-up
+} keypad_charlie_pin_t;
+
+static keypad_charlie_pin_t keypad_charlie_pins[KEYPAD_INSTANCE_COUNT][KEYPAD_CHARLIEPLEX_MAX_PINS] KEYPAD_PRIVATE;
+#endif
+#endif
+
+#if KEYPAD_MUX
+// Multiplexer geometry: three select lines pick one of eight channels.
+#define KEYPAD_MUX_SELECT_LINES 3
+#define KEYPAD_MUX_CHANNELS     8
+
+// Channel order of every multiplexed keypad, the Gray code sequence without the unused channels, and the
+// channel currently selected. Computed by keypad_init.
+static uint8_t keypad_mux_order[KEYPAD_INSTANCE_COUNT][KEYPAD_MUX_CHANNELS] KEYPAD_PRIVATE;
+static uint8_t keypad_mux_channel[KEYPAD_INSTANCE_COUNT] KEYPAD_PRIVATE;
+
+// Entry I of the reflected Gray code, consecutive entries differ in one bit.
+#define KEYPAD_GRAY(I) ((I) ^ ((I) >> 1))
+#endif
+
+#if KEYPAD_SEQUENCE_DETECT
+// Sequence automaton set with keypad_set_sequences, and the automaton and state every keypad is at.
+static const keypad_sequence_table_t* volatile keypad_sequences KEYPAD_PRIVATE = NULL;
+static const keypad_sequence_table_t* keypad_sequence_table[KEYPAD_INSTANCE_COUNT] KEYPAD_PRIVATE;
+static uint16_t keypad_sequence_state[KEYPAD_INSTANCE_COUNT] KEYPAD_PRIVATE;
+#endif
+
+#if KEYPAD_GPIO_BITBAND
+// Largest number of lines of a keypad, 32 keys in a single row use 33 lines.
+#define KEYPAD_MAX_LINES 33
+
+// Bit-band alias of every line of every keypad, computed by keypad_gpio_init. The rows come first and alias
+// their output register bit, the columns follow and alias their input register bit.
+static volatile uint32_t* keypad_alias[KEYPAD_INSTANCE_COUNT][KEYPAD_MAX_LINES];
+
+#if KEYPAD_BIDIRECTIONAL
+// Bit-band aliases of the reverse pass: the columns alias their output register bit, the rows follow and alias
+// their input register bit.
+static volatile uint32_t* keypad_alias_reverse[KEYPAD_INSTANCE_COUNT][KEYPAD_MAX_LINES];
+#endif
+#endif
+
+// Orders the accesses to the snapshot and trace buffers against their counters.
+#ifndef portMEMORY_BARRIER
+#define portMEMORY_BARRIER() __asm volatile("" ::: "memory")
+#endif
+
+#if KEYPAD_MPU
+// Loops of KEYPAD_DELAY_US per microsecond, set by KEYPAD_DELAY_INIT.
+static uint32_t keypad_delay_loops KEYPAD_PRIVATE;
+
+// Stack of the restricted keypad task, the MPU port guards it with a region of its size.
+static StackType_t keypad_task_stack[KEYPAD_TASK_STACK_SIZE]
+    __attribute__((aligned(KEYPAD_TASK_STACK_SIZE * sizeof(StackType_t))));
+
+// Section bounds defined by the linker script.
+extern uint8_t __keypad_mpu_private_start__[];
+extern uint8_t __keypad_mpu_shared_start__[];
+#endif
+
+// Event callbacks registered with keypad_register_callback.
+static struct {
+    keypad_callback_t callback; // Function to call, NULL if the slot is free
+    void* ctx;                  // Context pointer passed back to the callback
+} keypad_callbacks[KEYPAD_MAX_CALLBACKS] KEYPAD_PRIVATE;
+
+#if (KEYPAD_GPIO_BITBAND || (KEYPAD_CHARLIEPLEX && defined(KEYPAD_GPIO_MODE_REG)))
+/**
+ * @brief Returns the bit number of a pin mask.
+ *
+ * @param pin Pin mask, with a single bit set.
+ */
+static uint32_t keypad_gpio_bit(uint32_t pin) {
+    uint32_t bit = 0;
+
+    while ((pin >> bit) > 1) {
+        bit++;
+    }
+    return bit;
+}
+#endif
 
+#if KEYPAD_GPIO_BITBAND
 /**
- * @brief Initializes the GPIO pins for the rows and columns of the keypad.
+ * @brief Returns the bit-band alias of a pin in a GPIO register.
+ *
+ * Every bit of the peripheral region of a Cortex-M3 has its own word in the alias region. Writing
+ * 0 or 1 to it clears or sets the bit in one bus transaction and reading it returns the bit.
+ *
+ * @param reg Address of the GPIO register.
+ * @param pin Pin mask, with a single bit set.
+ */
+static volatile uint32_t* keypad_gpio_alias(uint32_t reg, uint32_t pin) {
+    return KEYPAD_BITBAND_ALIAS(reg, keypad_gpio_bit(pin));
+}
+#endif
+
+/**
+ * @brief Initializes the GPIO pins for the rows and columns of a keypad.
  *
  * This function configures the GPIO pins for the keypad rows as output pins with open-drain,
  * and the GPIO pins for the keypad columns as input pins with internal pull-up resistors enabled.
  * The row pins are set to a floating state by default to avoid short circuits when multiple keys
  * are pressed simultaneously. The column pins can be read to detect when a key connected to them is pressed.
  *
+ * @param kp The keypad to initialize.
+ *
  * @note This function is called internally by the `keypad_init` function and should not be called directly.
  */
-static void keypad_gpio_init(void) {
+static void keypad_gpio_init(const keypad_t* kp) {
+    const keypad_layout_t* layout = &KEYPAD_LAYOUT[kp->index];
+#if (KEYPAD_CHARLIEPLEX && defined(KEYPAD_GPIO_MODE_REG))
+    keypad_charlie_pin_t* image;
+    uint32_t bit;
+#endif
     uint8_t i;
 
     // Initialize GPIO for rows
-    // We are iterating over each row pin defined in KEYPAD_ROW_GPIO and initializing it.
-    for (i = 0; i < keypad.row_count; i++) {
+    // We are iterating over each row pin of the keypad layout and initializing it.
+    for (i = 0; i < kp->row_count; i++) {
         // Enable the peripheral clock for the GPIO port associated with the current row pin
-        KEYPAD_GPIO_ENABLE_CLK(KEYPAD_ROW_GPIO[i].periph);
+        KEYPAD_GPIO_ENABLE_CLK(layout->rows[i].periph);
 
         // Configure the current row pin as output with open-drain.
         // This is to ensure that even if multiple keys are pressed at the same time,
         // no short circuit will occur between two output pins with different voltage levels.
         // The open-drain configuration allows the pin to be driven low (0) or to be left floating (Z),
         // which effectively disconnects the pin from the circuit.
-        KEYPAD_GPIO_INIT(KEYPAD_ROW_GPIO[i].port, KEYPAD_ROW_GPIO[i].pin, KEYPAD_GPIO_MODE_OUT_OD);
+        // The pins of a charlieplexed keypad sense with their pull-ups until their pass comes.
+        KEYPAD_GPIO_INIT(layout->rows[i].port, layout->rows[i].pin,
+                         layout->charlieplex ? KEYPAD_GPIO_MODE_IPU : KEYPAD_GPIO_MODE_OUT_OD);
 
         // Set the row pin to a floating state (no voltage applied).
         // This is the default state of the row pins when no keypress is being scanned.
         // The floating state also helps to avoid potential short circuits
         // when multiple keys are pressed simultaneously.
-        KEYPAD_GPIO_SET(KEYPAD_ROW_GPIO[i].port, KEYPAD_ROW_GPIO[i].pin);
+        KEYPAD_GPIO_SET(layout->rows[i].port, layout->rows[i].pin);
     }
 
     // Initialize GPIO for columns
-    // We are iterating over each column pin defined in KEYPAD_COL_GPIO and initializing it.
-    for (i = 0; i < keypad.col_count; i++) {
+    // We are iterating over each column pin of the keypad layout and initializing it.
+    // A charlieplexed keypad has no separate columns, its pins are all in the rows table.
+    // A multiplexed keypad has select lines and an input instead, see below.
+    for (i = 0; i < kp->col_count && !layout->charlieplex && !layout->mux; i++) {
         // Enable the peripheral clock for the GPIO port associated with the current column pin
-        KEYPAD_GPIO_ENABLE_CLK(KEYPAD_COL_GPIO[i].periph);
+        KEYPAD_GPIO_ENABLE_CLK(layout->cols[i].periph);
 
         // Configure the current column pin as input with internal pull-up resistor enabled.
         // This configuration allows us to read the state of the column pin
         // and detect when a key connected to it is pressed.
-        KEYPAD_GPIO_INIT(KEYPAD_COL_GPIO[i].port, KEYPAD_COL_GPIO[i].pin, KEYPAD_GPIO_MODE_IPU);
+        KEYPAD_GPIO_INIT(layout->cols[i].port, layout->cols[i].pin, KEYPAD_GPIO_MODE_IPU);
+    }
+
+#if KEYPAD_MUX
+    // The select lines of a multiplexer start on channel 0, its input senses with the pull-up.
+    if (layout->mux) {
+        for (i = 0; i <= KEYPAD_MUX_SELECT_LINES; i++) {
+            KEYPAD_GPIO_ENABLE_CLK(layout->cols[i].periph);
+        }
+        for (i = 0; i < KEYPAD_MUX_SELECT_LINES; i++) {
+            KEYPAD_GPIO_INIT(layout->cols[i].port, layout->cols[i].pin, KEYPAD_GPIO_MODE_OUT_PP);
+            KEYPAD_GPIO_RESET(layout->cols[i].port, layout->cols[i].pin);
+        }
+        KEYPAD_GPIO_INIT(layout->cols[KEYPAD_MUX_SELECT_LINES].port, layout->cols[KEYPAD_MUX_SELECT_LINES].pin,
+                         KEYPAD_GPIO_MODE_IPU);
+    }
+#endif
+
+#if (KEYPAD_PRESENCE_DETECT == KEYPAD_PRESENCE_PIN)
+    // The detect pin is grounded by the keypad and pulled up while it is unplugged.
+    if (layout->detect != NULL) {
+        KEYPAD_GPIO_ENABLE_CLK(layout->detect->periph);
+        KEYPAD_GPIO_INIT(layout->detect->port, layout->detect->pin, KEYPAD_GPIO_MODE_IPU);
+    }
+#endif
+
+#if KEYPAD_GPIO_BITBAND
+    // Resolve the bit-band alias of every line once, so scanning only loads and stores words.
+    for (i = 0; i < kp->row_count; i++) {
+        keypad_alias[kp->index][i] =
+            keypad_gpio_alias(KEYPAD_GPIO_OUT_REG(layout->rows[i].port), layout->rows[i].pin);
+    }
+    // The pins of a charlieplexed keypad all sense, one more than the sense lines of a pass
+    for (i = 0; i < kp->col_count + layout->charlieplex && !layout->mux; i++) {
+        keypad_alias[kp->index][kp->row_count + i] =
+            keypad_gpio_alias(KEYPAD_GPIO_IN_REG(layout->cols[i].port), layout->cols[i].pin);
+    }
+#if KEYPAD_MUX
+    // A multiplexer has the output bits of its select lines, then the input bit of its input
+    for (i = 0; i <= KEYPAD_MUX_SELECT_LINES && layout->mux; i++) {
+        keypad_alias[kp->index][kp->row_count + i] =
+            keypad_gpio_alias((i < KEYPAD_MUX_SELECT_LINES) ? KEYPAD_GPIO_OUT_REG(layout->cols[i].port)
+                                                            : KEYPAD_GPIO_IN_REG(layout->cols[i].port),
+                              layout->cols[i].pin);
+    }
+#endif
+#if KEYPAD_BIDIRECTIONAL
+    for (i = 0; i < kp->col_count; i++) {
+        keypad_alias_reverse[kp->index][i] =
+            keypad_gpio_alias(KEYPAD_GPIO_OUT_REG(layout->cols[i].port), layout->cols[i].pin);
+    }
+    for (i = 0; i < kp->row_count; i++) {
+        keypad_alias_reverse[kp->index][kp->col_count + i] =
+            keypad_gpio_alias(KEYPAD_GPIO_IN_REG(layout->rows[i].port), layout->rows[i].pin);
+    }
+#endif
+#endif
+
+#if (KEYPAD_CHARLIEPLEX && defined(KEYPAD_GPIO_MODE_REG))
+    // Compute the mode bits of every pin once, so switching a pin is a single read-modify-write.
+    for (i = 0; i < kp->row_count && layout->charlieplex; i++) {
+        bit = keypad_gpio_bit(layout->rows[i].pin);
+        image = &keypad_charlie_pins[kp->index][i];
+        image->reg = KEYPAD_GPIO_MODE_REG(layout->rows[i].port, bit);
+        image->mask = KEYPAD_GPIO_MODE_MASK << KEYPAD_GPIO_MODE_SHIFT(bit);
+        image->drive = KEYPAD_GPIO_MODE_BITS_OUT_OD << KEYPAD_GPIO_MODE_SHIFT(bit);
+        image->sense = KEYPAD_GPIO_MODE_BITS_IPU << KEYPAD_GPIO_MODE_SHIFT(bit);
+    }
+#endif
+}
+
+#if KEYPAD_CHARLIEPLEX
+/**
+ * @brief Switches a pin of a charlieplexed keypad between driving and sensing.
+ *
+ * The output register of the pin must be high when it switches, the pin then starts driving released and
+ * senses with its pull-up.
+ *
+ * @param kp The keypad.
+ * @param pin Index of the pin in the rows table.
+ * @param drive 1 to make the pin an open-drain output, 0 to make it an input with pull-up.
+ */
+static void keypad_charlie_mode(const keypad_t* kp, uint8_t pin, uint8_t drive) {
+#ifdef KEYPAD_GPIO_MODE_REG
+    const keypad_charlie_pin_t* image = &keypad_charlie_pins[kp->index][pin];
+
+    *image->reg = (*image->reg & ~image->mask) | (drive ? image->drive : image->sense);
+#else
+    const keypad_gpio_t* gpio = &KEYPAD_LAYOUT[kp->index].rows[pin];
+
+    KEYPAD_GPIO_INIT(gpio->port, gpio->pin, drive ? KEYPAD_GPIO_MODE_OUT_OD : KEYPAD_GPIO_MODE_IPU);
+#endif
+}
+#endif
+
+#if KEYPAD_MUX
+/**
+ * @brief Selects a channel of the multiplexer of a keypad.
+ *
+ * Only the select lines that differ from the current channel are written.
+ *
+ * @param kp The keypad.
+ * @param channel The channel.
+ * @param settle Whether to wait KEYPAD_MUX_SETTLE_US after a change, before the input is read.
+ */
+static void keypad_mux_select(const keypad_t* kp, uint8_t channel, uint8_t settle) {
+    uint8_t changed = channel ^ keypad_mux_channel[kp->index];
+#if !KEYPAD_GPIO_BITBAND
+    const keypad_gpio_t* select = KEYPAD_LAYOUT[kp->index].cols;
+#endif
+    uint8_t i;
+
+    if (changed == 0) {
+        return;
+    }
+    for (i = 0; i < KEYPAD_MUX_SELECT_LINES; i++) {
+        if (!(changed & (1U << i))) {
+            continue;
+        }
+#if KEYPAD_GPIO_BITBAND
+        *keypad_alias[kp->index][kp->row_count + i] = (channel >> i) & 1U;
+#else
+        if ((channel >> i) & 1U) {
+            KEYPAD_GPIO_SET(select[i].port, select[i].pin);
+        } else {
+            KEYPAD_GPIO_RESET(select[i].port, select[i].pin);
+        }
+#endif
+    }
+    keypad_mux_channel[kp->index] = channel;
+    if (settle) {
+        KEYPAD_DELAY_US(KEYPAD_MUX_SETTLE_US);
+    }
+}
+#endif
+
+#if KEYPAD_MUX
+/**
+ * @brief Computes the channel order of the multiplexer of a keypad.
+ *
+ * The order walks the reflected Gray code cycle of the smallest number of select lines covering the columns,
+ * starting right after the unused channels. Those form a single run of the cycle, so leaving them out keeps
+ * one select line change per step, where the plain 8 channel sequence would jump over them.
+ *
+ * @param kp The keypad.
+ */
+static void keypad_mux_order_init(const keypad_t* kp) {
+    uint8_t cycle = 1;
+    uint8_t start = 0;
+    uint8_t i, n;
+
+    while (cycle < kp->col_count) {
+        cycle <<= 1;
+    }
+    for (i = 0; i < cycle; i++) {
+        if (KEYPAD_GRAY(i) < kp->col_count && KEYPAD_GRAY((i + cycle - 1) % cycle) >= kp->col_count) {
+            start = i;
+        }
+    }
+    for (i = 0, n = 0; i < cycle; i++) {
+        if (KEYPAD_GRAY((start + i) % cycle) < kp->col_count) {
+            keypad_mux_order[kp->index][n++] = KEYPAD_GRAY((start + i) % cycle);
+        }
+    }
+}
+#endif
+
+/**
+ * @brief Returns the column of a keypad read at a step of the column loop of a row.
+ *
+ * Columns are read in order, except on multiplexed keypads: their channels are read in Gray code order so
+ * that one select line changes per step, and odd rows walk the order backwards so that a row starts on the
+ * channel the previous row ended on.
+ *
+ * @param kp The keypad.
+ * @param row The row being scanned.
+ * @param step The step of the column loop.
+ */
+static uint8_t keypad_col_order(const keypad_t* kp, uint8_t row, uint8_t step) {
+#if KEYPAD_MUX
+    if (KEYPAD_LAYOUT[kp->index].mux) {
+        return keypad_mux_order[kp->index][(row & 1U) ? (kp->col_count - 1 - step) : step];
+    }
+#endif
+    return step;
+}
+
+/**
+ * @brief Drives a row of a keypad low or releases it to the floating state.
+ *
+ * @param kp The keypad.
+ * @param row The row.
+ * @param level 0 to drive the row low, 1 to release it.
+ */
+static void keypad_row_write(const keypad_t* kp, uint8_t row, uint8_t level) {
+#if !KEYPAD_GPIO_BITBAND
+    const keypad_gpio_t* gpio = &KEYPAD_LAYOUT[kp->index].rows[row];
+#endif
+
+#if KEYPAD_MUX
+    // Select the first channel of the row before driving it, the multiplexer settles along with the row
+    if (KEYPAD_LAYOUT[kp->index].mux && !level) {
+        keypad_mux_select(kp, keypad_col_order(kp, row, 0), 0);
+    }
+#endif
+
+#if KEYPAD_CHARLIEPLEX
+    // A pin of a charlieplexed keypad is only an output during its own pass
+    if (KEYPAD_LAYOUT[kp->index].charlieplex && !level) {
+        keypad_charlie_mode(kp, row, 1);
+        keypad_charlie_drive[kp->index] = row;
+    }
+#endif
+
+#if KEYPAD_GPIO_BITBAND
+    *keypad_alias[kp->index][row] = level;
+#else
+    if (level) {
+        KEYPAD_GPIO_SET(gpio->port, gpio->pin);
+    } else {
+        KEYPAD_GPIO_RESET(gpio->port, gpio->pin);
+    }
+#endif
+
+#if KEYPAD_CHARLIEPLEX
+    if (KEYPAD_LAYOUT[kp->index].charlieplex && level) {
+        keypad_charlie_mode(kp, row, 0);
+        keypad_charlie_drive[kp->index] = kp->row_count;
+    }
+#endif
+}
+
+/**
+ * @brief Reads the level of a column of a keypad.
+ *
+ * The columns of a charlieplex pass are the pins other than the driving one, in order. While no pin drives,
+ * column N is pin N. The columns of a multiplexed keypad are read through the input after selecting them.
+ *
+ * @param kp The keypad.
+ * @param col The column.
+ *
+ * @return 0 if the column reads low, non-zero otherwise.
+ */
+static uint32_t keypad_col_read(const keypad_t* kp, uint8_t col) {
+#if KEYPAD_CHARLIEPLEX
+    if (KEYPAD_LAYOUT[kp->index].charlieplex && col >= keypad_charlie_drive[kp->index]) {
+        col++;
+    }
+#endif
+#if KEYPAD_MUX
+    if (KEYPAD_LAYOUT[kp->index].mux) {
+        keypad_mux_select(kp, col, 1);
+#if KEYPAD_GPIO_BITBAND
+        return KEYPAD_COL_FAULT(kp->index, col,
+                                *keypad_alias[kp->index][kp->row_count + KEYPAD_MUX_SELECT_LINES]);
+#else
+        return KEYPAD_COL_FAULT(kp->index, col,
+                                KEYPAD_GPIO_GET(KEYPAD_LAYOUT[kp->index].cols[KEYPAD_MUX_SELECT_LINES].port,
+                                                KEYPAD_LAYOUT[kp->index].cols[KEYPAD_MUX_SELECT_LINES].pin));
+#endif
+    }
+#endif
+#if KEYPAD_GPIO_BITBAND
+    return KEYPAD_COL_FAULT(kp->index, col, *keypad_alias[kp->index][kp->row_count + col]);
+#else
+    const keypad_gpio_t* gpio = &KEYPAD_LAYOUT[kp->index].cols[col];
+
+    return KEYPAD_COL_FAULT(kp->index, col, KEYPAD_GPIO_GET(gpio->port, gpio->pin));
+#endif
+}
+
+#if KEYPAD_BIDIRECTIONAL
+/**
+ * @brief Drives a column of a keypad low or releases it, in the reverse pass.
+ *
+ * @param kp The keypad.
+ * @param col The column.
+ * @param level 0 to drive the column low, 1 to release it.
+ */
+static void keypad_col_write(const keypad_t* kp, uint8_t col, uint8_t level) {
+#if KEYPAD_GPIO_BITBAND
+    *keypad_alias_reverse[kp->index][col] = level;
+#else
+    const keypad_gpio_t* gpio = &KEYPAD_LAYOUT[kp->index].cols[col];
+
+    if (level) {
+        KEYPAD_GPIO_SET(gpio->port, gpio->pin);
+    } else {
+        KEYPAD_GPIO_RESET(gpio->port, gpio->pin);
+    }
+#endif
+}
+
+/**
+ * @brief Reads the level of a row of a keypad, in the reverse pass.
+ *
+ * For the fault injection hooks the rows are numbered after the columns.
+ *
+ * @param kp The keypad.
+ * @param row The row.
+ *
+ * @return 0 if the row reads low, non-zero otherwise.
+ */
+static uint32_t keypad_row_read(const keypad_t* kp, uint8_t row) {
+#if KEYPAD_GPIO_BITBAND
+    return KEYPAD_COL_FAULT(kp->index, kp->col_count + row, *keypad_alias_reverse[kp->index][kp->col_count + row]);
+#else
+    const keypad_gpio_t* gpio = &KEYPAD_LAYOUT[kp->index].rows[row];
+
+    return KEYPAD_COL_FAULT(kp->index, kp->col_count + row, KEYPAD_GPIO_GET(gpio->port, gpio->pin));
+#endif
+}
+
+/**
+ * @brief Swaps the roles of the rows and columns of all keypads.
+ *
+ * The lines that drove become inputs with pull-ups before the lines that sensed become released open-drain
+ * outputs, so no line is ever driven against another one.
+ *
+ * @param reversed 1 to let the columns drive and the rows sense, 0 for the forward direction.
+ */
+static void keypad_orient(uint8_t reversed) {
+    const keypad_layout_t* layout;
+    uint8_t i, k;
+
+    if (reversed == keypad_reversed) {
+        return;
+    }
+    for (k = 0; k < KEYPAD_INSTANCE_COUNT; k++) {
+        layout = &KEYPAD_LAYOUT[k];
+        for (i = 0; i < layout->row_count && reversed; i++) {
+            KEYPAD_GPIO_INIT(layout->rows[i].port, layout->rows[i].pin, KEYPAD_GPIO_MODE_IPU);
+        }
+        for (i = 0; i < layout->col_count; i++) {
+            if (reversed) {
+                KEYPAD_GPIO_INIT(layout->cols[i].port, layout->cols[i].pin, KEYPAD_GPIO_MODE_OUT_OD);
+                KEYPAD_GPIO_SET(layout->cols[i].port, layout->cols[i].pin);
+            } else {
+                KEYPAD_GPIO_INIT(layout->cols[i].port, layout->cols[i].pin, KEYPAD_GPIO_MODE_IPU);
+            }
+        }
+        for (i = 0; i < layout->row_count && !reversed; i++) {
+            KEYPAD_GPIO_INIT(layout->rows[i].port, layout->rows[i].pin, KEYPAD_GPIO_MODE_OUT_OD);
+            KEYPAD_GPIO_SET(layout->rows[i].port, layout->rows[i].pin);
+        }
     }
+    keypad_reversed = reversed;
 }
+#endif
 
 /**
  * @brief Dummy timer callback function.
@@ -68,163 +778,1874 @@ static void dummy_timer_callback(TimerHandle_t x_timer) {
 }
 
 /**
- * @brief Scans the keypad for any pressed keys.
+ * @brief Checks the result of a timer command of the keypad task.
+ *
+ * The commands wait at most KEYPAD_TIMER_TIMEOUT for room in the timer command queue. A command that timed out
+ * left its timer out of step with the debounce state and is counted in timer_faults. With KEYPAD_WATCHDOG the
+ * task stops publishing its heartbeat from then on, so keypad_watchdog_check restarts it from a clean state.
+ *
+ * @param result Result of the timer command.
+ */
+static void keypad_timer_check(BaseType_t result) {
+    if (result != pdPASS) {
+        keypad_stats.timer_faults++;
+#if KEYPAD_WATCHDOG
+        keypad_timer_failed = 1;
+#endif
+    }
+}
+
+/**
+ * @brief Returns whether a row of a keypad is sampled in the current scan cycle.
+ *
+ * Rows are sampled according to their scan rate class in the row divider table of the keypad layout.
+ * Keypads found unplugged by the presence detection are not sampled.
+ */
+static uint8_t keypad_row_due(const keypad_t* kp, uint8_t row) {
+    return kp->present && row < kp->row_count &&
+           (keypad_scan_cycle % KEYPAD_LAYOUT[kp->index].row_divider[row]) == 0;
+}
+
+/**
+ * @brief Waits for the lines of the driven row to settle.
+ *
+ * Waits shorter than a tick are busy-waited with KEYPAD_DELAY_US, a vTaskDelay of zero ticks would only
+ * yield. Longer waits sleep for the wait rounded up to whole ticks. The choice is made at compile time.
+ */
+static void keypad_stabilize(void) {
+    if (((uint64_t)KEYPAD_GPIO_STABILIZATION_US * configTICK_RATE_HZ) < 1000000U) {
+        KEYPAD_DELAY_US(KEYPAD_GPIO_STABILIZATION_US);
+    } else {
+        vTaskDelay(KEYPAD_US_TO_TICKS(KEYPAD_GPIO_STABILIZATION_US));
+    }
+}
+
+/**
+ * @brief Scans all keypads for any pressed keys.
  *
- * This function scans the keypad to detect any keypresses. It iteratively 
+ * This function scans the keypads to detect any keypresses. It iteratively
  * drives each row pin low while leaving others floating, and checks the state
  * of the column pins. If a key is pressed, the corresponding column pin will be
  * pulled low, and the function detects this change.
  *
- * Each bit in the returned 32-bit value corresponds to a key, with a '1' indicating
- * a pressed key and '0' indicating an unpressed key. The bit position (0 to 31) corresponds 
+ * The keypads are scanned on a combined schedule: row N of every keypad is driven at the same
+ * time and all of them share a single stabilization delay before their columns are read. The scan
+ * time therefore grows with the largest row count, not with the number of keypads.
+ *
+ * Rows are sampled according to their scan rate class (see KEYPAD_ROW_SCAN_DIVIDER). A row that is
+ * not due in the current cycle is not driven, and its keys keep the state of the previous scan.
+ *
+ * The result is stored in keys_pressed of every keypad. Each bit corresponds to a key, with a '1'
+ * indicating a pressed key and '0' indicating an unpressed key. The bit position (0 to 31) corresponds
  * to the key label defined in keypad_config.h.
  *
- * Note: This function is blocking and will not return until all row and column pins 
+ * Note: This function is blocking and will not return until all row and column pins
  * have been scanned. Therefore, it should be called from a context that is not time-sensitive.
- *
- * @return uint32_t: A 32-bit value representing the state of all keys on the keypad.
  */
-uint32_t keypad_scan(void) {
-    // Initialize key variable to 0. This variable will store the states of each key press.
-    uint32_t key = 0;
+static void keypad_scan(void) {
+    keypad_t* kp;
 
-    // Variables for the row and column iteration.
-    uint8_t row, col;
+    // Variables for the row, column and keypad iteration.
+    uint8_t row, col, step, i;
 
-    // Iterate over each row in the keypad.
-    for (row = 0; row < keypad.row_count; row++) {
-        // Drive the current row's GPIO pin to low. This is done to prepare for reading the column inputs.
-        KEYPAD_GPIO_RESET(KEYPAD_ROW_GPIO[row].port, KEYPAD_ROW_GPIO[row].pin);
+    // Bits of the keys in the current row.
+    uint32_t row_mask;
 
-        // Insert a short delay to ensure the GPIO pin voltage level has stabilized.
-        vTaskDelay(KEYPAD_GPIO_STABILIZATION_TIME);
+    // Whether any keypad drives the current row.
+    uint8_t driven;
 
-        // Now, iterate over each column for the current row.
-        for (col = 0; col < keypad.col_count; col++) {
-            // Check if the current key (at the intersection of the current row and column) is pressed.
-            // The key is considered pressed if the column GPIO pin is reading low.
-            if (KEYPAD_GPIO_GET(KEYPAD_COL_GPIO[col].port, KEYPAD_COL_GPIO[col].pin) == 0) {
-                // If the key is pressed, mark its corresponding bit in the 'key' variable.
-                // We use bitwise OR operation to set the bit without affecting other bits.
-                key |= 1 << ((row * keypad.col_count) + col);
+    // Iterate over each row index of the keypads.
+    for (row = 0; row < keypad_row_max; row++) {
+        driven = 0;
+
+        // Drive the current row's GPIO pin to low on every keypad where it is due.
+        // This is done to prepare for reading the column inputs.
+        for (i = 0; i < KEYPAD_INSTANCE_COUNT; i++) {
+            if (keypad_row_due(&keypads[i], row)) {
+                keypad_row_write(&keypads[i], row, 0);
+                driven = 1;
             }
         }
 
-        // Set the current row's GPIO pin back to high, effectively returning it to the floating state.
-        // This is done after we finish scanning each column for the current row.
-        KEYPAD_GPIO_SET(KEYPAD_ROW_GPIO[row].port, KEYPAD_ROW_GPIO[row].pin);
+        // Rows of a slower rate class keep their previous state until they are due again.
+        if (!driven) {
+            continue;
+        }
+
+        // Insert a short delay to ensure the GPIO pin voltage level has stabilized, once for all keypads.
+        keypad_stabilize();
+
+        for (i = 0; i < KEYPAD_INSTANCE_COUNT; i++) {
+            kp = &keypads[i];
+            if (!keypad_row_due(kp, row)) {
+                continue;
+            }
+
+            // Forget the previous state of the row, it is read again now.
+            row_mask = ((1UL << kp->col_count) - 1) << (row * kp->col_count);
+            kp->keys_pressed &= ~row_mask;
+
+            // Now, iterate over each column for the current row, in the order the keypad reads them best.
+            for (step = 0; step < kp->col_count; step++) {
+                col = keypad_col_order(kp, row, step);
+
+                // Check if the current key (at the intersection of the current row and column) is pressed.
+                // The key is considered pressed if the column GPIO pin is reading low.
+                if (keypad_col_read(kp, col) == 0) {
+                    // If the key is pressed, mark its corresponding bit in keys_pressed.
+                    // We use bitwise OR operation to set the bit without affecting other bits.
+                    kp->keys_pressed |= 1UL << ((row * kp->col_count) + col);
+                }
+            }
+
+            // Set the current row's GPIO pin back to high, effectively returning it to the floating state.
+            // This is done after we finish scanning each column for the current row.
+            keypad_row_write(kp, row, 1);
+        }
     }
 
-    // Return the resultant 'key' variable, where each bit represents the state of a key on the keypad.
-    // '1' signifies that the corresponding key is pressed, while '0' means it's not pressed.
-    return key;
+    keypad_scan_cycle++;
 }
 
+#if KEYPAD_BIDIRECTIONAL
 /**
- * @brief Task function dedicated to handling the keypad.
- *
- * This function `keypad_read` runs indefinitely as a task in the FreeRTOS environment,
- * dedicated to monitoring and handling user interactions with the keypad.
- *
- * Its primary responsibilities involve:
- * - Scanning the keypad for keypresses
- * - Applying a software debouncing mechanism to filter unintended quick, repeated actuations
- *
- * In each iteration of the main task loop, the function first scans the entire keypad for
- * any pressed keys. To address the problem of key 'bouncing', it makes use of a FreeRTOS
- * timer which adds a delay before a keypress is registered. This debounce timer is reset
- * whenever a keypress is detected.
- *
- * When no keys are pressed, the function the timer and resets the necessary tracking
- * variables.
+ * @brief Scans all keypads in the reverse direction, columns driving and rows sensing.
  *
- * The state of the keypad is communicated to other parts of the application through two means
- * an event group and a queue. Both of these provide similar functionality and can be disabled
- * based on the user's requirements and application scenario. They facilitate inter-task communication
- * and synchronization.
- *
- * @note Even though the `param` parameter is included in the function signature, it is not
- * currently utilized in this implementation. Its presence is required to comply with
- * the FreeRTOS task function signature.
- *
- * @param param Unused parameter.
+ * On a diode-pair keypad every position holds a second key whose diode only conducts from the column to the
+ * row. It is stored row_count * col_count bits above the key at the same position. Like the forward scan,
+ * column N of every keypad is driven at the same time. The rows of all keypads are read on every cycle,
+ * the scan rate classes only apply to the forward scan.
  */
-void keypad_read(void* param) {
-    // Create a timer to handle debounce. The dummy_timer_callback function is used as the callback.
-    keypad.timer_debounce = xTimerCreate("Debounce", KEYPAD_DEBOUNCE_TIME, pdFALSE, (void*)0, dummy_timer_callback);
+static void keypad_scan_reverse(void) {
+    uint32_t col_mask;
+    uint8_t row, col, i;
+    keypad_t* kp;
 
-    // Create an Event Group to handle synchronization across tasks that depend on keypress events.
-    keypad_event_group = xEventGroupCreate();
+    for (col = 0; col < keypad_col_max; col++) {
+        for (i = 0; i < KEYPAD_INSTANCE_COUNT; i++) {
+            if (keypads[i].present && col < keypads[i].col_count) {
+                keypad_col_write(&keypads[i], col, 0);
+            }
+        }
 
-    // All bits in the event group are cleared at the start to avoid carrying over any previous state.
-    xEventGroupClearBits(keypad_event_group, KEY_EVENT_BITMASK);
+        keypad_stabilize();
 
-    // Create a queue to handle inter-task communication. The queue size is defined by KEYPAD_QUEUE_SIZE.
-    keypad_queue = xQueueCreate(KEYPAD_QUEUE_SIZE, sizeof(uint32_t));
+        for (i = 0; i < KEYPAD_INSTANCE_COUNT; i++) {
+            kp = &keypads[i];
+            if (!kp->present || col >= kp->col_count) {
+                continue;
+            }
 
-    // The main loop of the task.
-    for (;;) {
-        // Scan the keypad and store the result in keys_pressed.
-        keypad.keys_pressed = keypad_scan();
-
-        // If any key is currently pressed:
-        if (keypad.keys_pressed) {
-            // If the pressed keys differ from the keys in the previous iteration:
-            if (keypad.keys_pressed != keypad.keys_down) {
-                // Reset the debounce timer
-                xTimerReset(keypad.timer_debounce, portMAX_DELAY);
+            // Forget the previous state of the reverse keys of the column, they are read again now
+            col_mask = 0;
+            for (row = 0; row < kp->row_count; row++) {
+                col_mask |= 1UL << ((kp->row_count + row) * kp->col_count + col);
             }
+            kp->keys_pressed &= ~col_mask;
 
-            // Update keys_down to remember the current state of keys.
-            keypad.keys_down |= keypad.keys_pressed;
-        } else {
-            // Key released
-            // Check if the debounce timer is not active (debounce time has passed) and a key was previously pressed
-            if (keypad.keys_down != KEY_NONE && !xTimerIsTimerActive(keypad.timer_debounce)) {
-                // Broadcast the released key through the event group
-                xEventGroupSetBits(keypad_event_group, (keypad.keys_down & KEY_EVENT_BITMASK));
-                // Add the released key to the keypad queue for further processing
-                xQueueSend(keypad_queue, &keypad.keys_down, 0);
+            for (row = 0; row < kp->row_count; row++) {
+                if (keypad_row_read(kp, row) == 0) {
+                    kp->keys_pressed |= 1UL << ((kp->row_count + row) * kp->col_count + col);
+                }
             }
 
-            // Reset keys_down state
-            keypad.keys_down = KEY_NONE;
+            keypad_col_write(kp, col, 1);
         }
+    }
+}
 
-        // Yield the CPU to other tasks
-        vTaskDelay(KEYPAD_TASK_DELAY_TIME);
+/**
+ * @brief Scans all keypads in both directions.
+ *
+ * Each cycle starts with the direction the lines were left in by the previous one, so the lines are only
+ * reconfigured once per cycle instead of twice.
+ */
+static void keypad_scan_bidirectional(void) {
+    if (keypad_reversed) {
+        keypad_scan_reverse();
+        keypad_orient(0);
+        keypad_scan();
+    } else {
+        keypad_scan();
+        keypad_orient(1);
+        keypad_scan_reverse();
     }
 }
+#endif
 
 /**
- * @brief Initializes the keypad.
+ * @brief Sets the bits of keys in the event groups of a keypad.
  *
- * This function initializes the keypad by performing the following steps:
- * - Calculates the number of rows and columns based on the size of the GPIO arrays.
- * - Sets the initial state of key-related variables.
- * - Calls the keypad_gpio_init function to initialize GPIO.
- * - Creates a FreeRTOS task for reading keypad input.
+ * The keys are spread over the shards of the groups, KEYPAD_EVENT_GROUP_BITS keys each, so every key
+ * of the keypad has a bit despite the FreeRTOS limit.
  *
- * @note This function should be called before using the keypad.
- *       It sets up the necessary components and starts the keypad task for input scanning.
+ * @param groups Event groups of the keypad, pulse_groups or held_groups.
+ * @param set Bitmask of the keys whose bits are set.
+ * @param clear Bitmask of the keys whose bits are cleared.
  */
-void keypad_init(void) {
-    // Calculate number of rows and columns based on the size of the GPIO array
-    // We get the total size of each array and divide it by the size of an individual element to get the count.
-    keypad.row_count = sizeof(KEYPAD_ROW_GPIO) / sizeof(KEYPAD_ROW_GPIO[0]);
-    keypad.col_count = sizeof(KEYPAD_COL_GPIO) / sizeof(KEYPAD_COL_GPIO[0]);
+static void keypad_update_groups(EventGroupHandle_t* groups, uint32_t set, uint32_t clear) {
+    uint8_t shard;
 
-    // Initialize key state
-    keypad.keys_pressed = 0; // Set all keys to not pressed (0) as the initial state.
-    keypad.keys_down = 0;    // Set no keys as being pressed down (0) as the initial state.
+    for (shard = 0; shard < KEYPAD_EVENT_GROUP_SHARDS && groups[shard] != NULL; shard++) {
+        if (KEYPAD_EVENT_GROUP_KEYS(clear, shard)) {
+            xEventGroupClearBits(groups[shard], KEYPAD_EVENT_GROUP_KEYS(clear, shard));
+        }
+        if (KEYPAD_EVENT_GROUP_KEYS(set, shard)) {
+            xEventGroupSetBits(groups[shard], KEYPAD_EVENT_GROUP_KEYS(set, shard));
+        }
+    }
+}
+
+/**
+ * @brief Broadcasts an event word to the other tasks.
+ *
+ * Events go to the queue of the keypad that produced them.
+ * Every event is recorded in the trace ring and passed to the registered callbacks.
+ * KEY_STATE and KEY_LATENCY events go to the callbacks only, all other events are also added to the queue.
+ *
+ * @param kp The keypad publishing the event.
+ * @param event Event word, see KEY_EVENT_KIND_MASK.
+ */
+static void keypad_publish_event(keypad_t* kp, uint32_t event) {
+    uint32_t kind = KEY_EVENT_BASE_KIND(event);
+    TickType_t tick = xTaskGetTickCount();
+#if KEYPAD_LATENCY_TRACKING
+    uint8_t head;
+#endif
+    uint8_t i;
+
+    // Add the event to the keypad queue for further processing, held state changes are too frequent for it
+    if (kind != KEY_STATE && kind != KEY_LATENCY) {
+#if KEYPAD_LATENCY_TRACKING
+        // Record the emit tick first, a waiting consumer of higher priority receives the event inside xQueueSend
+        head = keypad_emit_head[kp->index];
+        keypad_emit_tick[kp->index][head] = tick;
+        portMEMORY_BARRIER();
+        keypad_emit_head[kp->index] = (head + 1) % KEYPAD_EMIT_RING_SIZE;
+#endif
+        if (KEYPAD_QUEUE_SEND(kp->queue, &event) != pdPASS) {
+            keypad_stats.queue_drops++;
+#if KEYPAD_LATENCY_TRACKING
+            // The queue was full, so no consumer can have taken the entry
+            keypad_emit_head[kp->index] = head;
+#endif
+        }
+    }
+
+    // Record the event in the trace ring, the counter is advanced once the entry is complete
+    keypad_trace[keypad_trace_count % KEYPAD_TRACE_SIZE].tick = tick;
+    keypad_trace[keypad_trace_count % KEYPAD_TRACE_SIZE].event = event;
+    keypad_trace[keypad_trace_count % KEYPAD_TRACE_SIZE].index = kp->index;
+    portMEMORY_BARRIER();
+    keypad_trace_count++;
+
+    // Hand the event to the registered callbacks
+    for (i = 0; i < KEYPAD_MAX_CALLBACKS; i++) {
+        if (keypad_callbacks[i].callback != NULL) {
+            keypad_callbacks[i].callback(kp, event, keypad_callbacks[i].ctx);
+        }
+    }
+}
+
+/**
+ * @brief Broadcasts keys to the other tasks.
+ *
+ * Only plain key events are broadcast through the pulse event groups, the other kinds (see KEY_EVENT_KIND_MASK)
+ * would otherwise look like key presses to their waiters. The pulse event groups receive all keys at once, the
+ * event words split them into lower and upper keys (see KEY_EVENT_UPPER), so no key is lost to the width of
+ * KEY_EVENT_BITMASK. Words without keys are left out, except the KEY_STATE words, which carry the held keys of
+ * their half of the keypad even once they are all released.
+ *
+ * @param kp The keypad publishing the event.
+ * @param kind Kind of the event, see KEY_EVENT_KIND_MASK.
+ * @param keys Bitmask of the keys to broadcast, or the value carried by the event kind.
+ */
+static void keypad_publish(keypad_t* kp, uint32_t kind, uint32_t keys) {
+    uint8_t key_count = kp->row_count * kp->col_count * KEYPAD_SCAN_PASSES;
+    uint32_t lower = keys & ((1UL << kp->upper_shift) - 1U);
+    uint32_t upper = keys >> kp->upper_shift;
+
+    // The kinds from KEY_LATENCY on carry a value, kept within KEY_EVENT_BITMASK by their publishers
+    if (kind >= KEY_LATENCY) {
+        configASSERT(keys == KEY_EVENT_KEYS(keys));
+        keypad_publish_event(kp, kind | keys);
+        return;
+    }
+
+    // Broadcast plain key events through the pulse event groups
+    if (kind == KEY_EVENT_KEY) {
+        keypad_update_groups(kp->pulse_groups, keys, 0);
+    }
+    if (lower != KEY_NONE || kind == KEY_STATE) {
+        keypad_publish_event(kp, kind | lower);
+    }
+    if (upper != KEY_NONE || (kind == KEY_STATE && key_count > kp->upper_shift)) {
+        keypad_publish_event(kp, KEY_EVENT_UPPER | kind | upper);
+    }
+}
+
+/**
+ * @brief Updates the debounced set of held keys.
+ *
+ * Publishes a KEY_STATE event when the set changes, so level-driven consumers such as the
+ * HID report generator can follow presses and releases of individual keys, and updates the
+ * held event groups.
+ *
+ * @param kp The keypad.
+ * @param keys Bitmask of the keys now considered held.
+ */
+static void keypad_update_held(keypad_t* kp, uint32_t keys) {
+    if (keys != kp->keys_held) {
+        // The held event groups follow the held state, so waiters see the keys currently held
+        keypad_update_groups(kp->held_groups, keys & ~kp->keys_held, kp->keys_held & ~keys);
+        kp->keys_held = keys;
+        keypad_publish(kp, KEY_STATE, keys);
+    }
+}
+
+#if KEYPAD_SEQUENCE_DETECT
+/**
+ * @brief Advances the sequence automaton of a keypad by a key event.
+ *
+ * Every key event is a single table lookup. Events of a single key are the symbols of the sequences, chords
+ * and keys outside all sequences bring the automaton back to its start state. When a sequence is completed,
+ * including one ending the sequence typed so far, KEY_SEQUENCE is published with its ID and the automaton
+ * starts over, so the keys of a completed sequence are not reused by the next one.
+ *
+ * @param kp The keypad.
+ * @param keys Bitmask of the keys of the event.
+ */
+static void keypad_sequence_advance(keypad_t* kp, uint32_t keys) {
+    const keypad_sequence_table_t* table = keypad_sequences;
+    uint8_t symbol = KEYPAD_SEQUENCE_NO_SYMBOL;
+    uint16_t state = 0;
+    uint8_t bit = 0;
+
+    // A new automaton starts from its start state
+    if (table != keypad_sequence_table[kp->index]) {
+        keypad_sequence_table[kp->index] = table;
+        keypad_sequence_state[kp->index] = 0;
+    }
+    if (table == NULL) {
+        return;
+    }
+
+    if (keys != KEY_NONE && (keys & (keys - 1)) == 0) {
+        while ((keys >> bit) > 1) {
+            bit++;
+        }
+        symbol = table->symbol[bit];
+    }
+    if (symbol != KEYPAD_SEQUENCE_NO_SYMBOL) {
+        state = table->next[keypad_sequence_state[kp->index] * table->symbol_count + symbol];
+    }
+
+    if (table->match[state] != 0) {
+        keypad_publish(kp, KEY_SEQUENCE, table->match[state] - 1U);
+        state = 0;
+    }
+    keypad_sequence_state[kp->index] = state;
+}
+#endif
+
+/**
+ * @brief Publishes a debounced key event and feeds it to the sequence detection.
+ *
+ * @param kp The keypad.
+ * @param keys Bitmask of the reported keys.
+ */
+static void keypad_publish_keys(keypad_t* kp, uint32_t keys) {
+    keypad_publish(kp, KEY_EVENT_KEY, keys);
+#if KEYPAD_SEQUENCE_DETECT
+    keypad_sequence_advance(kp, keys);
+#endif
+}
+
+#if KEYPAD_EDGE_TIMESTAMPS
+/**
+ * @brief Holds the rows of all keypads low between scans, or releases them for the next scan.
+ *
+ * With every row held low, a key closing or bouncing produces an edge on its column line. Driving the rows
+ * produces edges of its own on the columns of pressed keys, so edges are only recorded once the guard time
+ * has passed. The rows are released before the next scan, which expects all of them floating.
+ *
+ * @param arm Whether to drive the rows and record edges, or to stop recording and release the rows.
+ */
+static void keypad_edge_arm(uint8_t arm) {
+    uint8_t i, row;
+
+    if (!arm) {
+        keypad_edge_armed = 0;
+    }
+    for (i = 0; i < KEYPAD_INSTANCE_COUNT; i++) {
+        for (row = 0; row < keypads[i].row_count; row++) {
+            keypad_row_write(&keypads[i], row, !arm);
+        }
+    }
+    if (arm) {
+        keypad_edge_armed_at = KEYPAD_EDGE_CLOCK() + keypad_edge_guard;
+        portMEMORY_BARRIER();
+        keypad_edge_armed = 1;
+    }
+}
+
+/**
+ * @brief Restarts the edge debounce of a keypad, as if an edge was seen now.
+ */
+static void keypad_edge_mark(const keypad_t* kp) {
+    keypad_edge_last[kp->index] = KEYPAD_EDGE_CLOCK();
+    keypad_edge_stable[kp->index] = 0;
+}
+
+/**
+ * @brief Drains the edge rings of a keypad and updates its debounce state.
+ *
+ * Edges only extend the debounce while keys are pressed and have not been stable yet, so the release
+ * bounce of keys that already settled can not cancel them. A ring overflow counts as an edge seen now.
+ * The keys become stable once KEYPAD_EDGE_SETTLE_US has passed since the last edge.
+ */
+static void keypad_edge_update(const keypad_t* kp) {
+    uint32_t now = KEYPAD_EDGE_CLOCK();
+    uint8_t track = kp->keys_pressed != KEY_NONE && !keypad_edge_stable[kp->index];
+    keypad_edge_ring_t* ring;
+    uint32_t stamp;
+    uint8_t col, tail;
+
+    for (col = 0; col < kp->col_count; col++) {
+        ring = &keypad_edge_rings[kp->index][col];
+        tail = ring->tail;
+        while (tail != ring->head) {
+            portMEMORY_BARRIER();
+            stamp = ring->stamp[tail];
+            tail = (tail + 1) % KEYPAD_EDGE_RING_SIZE;
+            if (track && (int32_t)(stamp - keypad_edge_last[kp->index]) > 0) {
+                keypad_edge_last[kp->index] = stamp;
+            }
+        }
+        portMEMORY_BARRIER();
+        ring->tail = tail;
+
+        if (ring->overflow != keypad_edge_overflow[kp->index][col]) {
+            keypad_edge_overflow[kp->index][col] = ring->overflow;
+            if (track) {
+                keypad_edge_last[kp->index] = now;
+            }
+        }
+    }
+
+    if (track && (uint32_t)(now - keypad_edge_last[kp->index]) >= keypad_edge_settle) {
+        keypad_edge_stable[kp->index] = 1;
+    }
+}
+#endif
+
+#if (KEYPAD_DEBOUNCE_MODE == KEYPAD_DEBOUNCE_EAGER)
+/**
+ * @brief Eager debounce: reports presses immediately and debounces releases.
+ *
+ * A key is reported on the first scan that sees it pressed. The hold-off timer is then started
+ * and every scan taken while it runs is dropped, so the bounce that follows the closure can not
+ * produce a second report. A reported key is forgotten only after the scan result has been
+ * stable for KEYPAD_DEBOUNCE_MS without it, which keeps release bounce from re-triggering it.
+ *
+ * Press latency is one scan period instead of KEYPAD_DEBOUNCE_MS, at the cost of trusting every
+ * closure. Use it only with switches that do not produce false closures.
+ */
+static void keypad_debounce(keypad_t* kp) {
+    uint32_t keys_new;
+
+    // Contacts are still settling from the last reported press, ignore whatever they read.
+    if (xTimerIsTimerActive(kp->timer_holdoff)) {
+        return;
+    }
+
+    // Keys that read pressed but have not been reported yet are reported right away.
+    keys_new = kp->keys_pressed & ~kp->keys_down;
+    if (keys_new) {
+        keypad_publish_keys(kp, keys_new);
+        kp->keys_down |= keys_new;
+        kp->keys_last = kp->keys_pressed;
+        keypad_update_held(kp, kp->keys_down);
+
+        // Open the hold-off window
+        KEYPAD_TIMER_RESET(kp->timer_holdoff);
+        return;
+    }
+
+    if (kp->keys_pressed != kp->keys_last) {
+        // Contacts changed, restart the release debounce
+        kp->keys_last = kp->keys_pressed;
+        KEYPAD_TIMER_RESET(kp->timer_debounce);
+    } else if (!xTimerIsTimerActive(kp->timer_debounce)) {
+        // Stable for the whole debounce time, forget the released keys so they can be reported again
+        kp->keys_down &= kp->keys_pressed;
+        keypad_update_held(kp, kp->keys_down);
+    }
+}
+#else
+/**
+ * @brief Restarts the debounce time of a keypad after its pressed keys changed.
+ */
+static void keypad_debounce_restart(keypad_t* kp) {
+#if KEYPAD_EDGE_TIMESTAMPS
+    keypad_edge_mark(kp);
+#else
+    KEYPAD_TIMER_RESET(kp->timer_debounce);
+#endif
+}
+
+/**
+ * @brief Returns whether the pressed keys of a keypad are still being debounced.
+ *
+ * With KEYPAD_EDGE_TIMESTAMPS the keys are debounced once KEYPAD_EDGE_SETTLE_US has passed since their
+ * last edge, otherwise once the debounce timer expired.
+ */
+static BaseType_t keypad_debounce_running(const keypad_t* kp) {
+#if KEYPAD_EDGE_TIMESTAMPS
+    return !keypad_edge_stable[kp->index];
+#else
+    return xTimerIsTimerActive(kp->timer_debounce);
+#endif
+}
+
+/**
+ * @brief Deferred debounce: reports keys on release once they were stable for the debounce time.
+ *
+ * The debounce timer is reset whenever the set of pressed keys changes. Keys are accumulated in
+ * keys_down while they are held and reported together when all of them are released, provided
+ * the debounce timer expired in the meantime.
+ *
+ * With KEYPAD_SPECULATIVE_EVENTS enabled, keys are additionally announced with KEY_TENTATIVE on
+ * their first raw edge. The announcement is resolved once the pressed keys have not changed for the
+ * debounce time: by KEY_CONFIRM for the keys that were pressed all along, by KEY_CANCEL for the keys
+ * that were released in the meantime. Contact bounce before that announces nothing more, so a press
+ * produces a single TENTATIVE and a single verdict however often it bounces.
+ *
+ * With KEYPAD_EDGE_TIMESTAMPS, the debounce time is measured from the last edge the column interrupts
+ * timestamped instead of from the last scan that changed, see keypad_edge_update.
+ *
+ * The held state is tracked separately: it follows the scan result once that has not changed
+ * for the debounce time.
+ */
+static void keypad_debounce(keypad_t* kp) {
+    TickType_t now = xTaskGetTickCount();
+#if (KEYPAD_SPECULATIVE_EVENTS)
+    uint32_t keys_new;
+    uint32_t keys_confirm;
+#endif
+
+#if KEYPAD_EDGE_TIMESTAMPS
+    // Take in the edges seen since the last cycle
+    keypad_edge_update(kp);
+#endif
+
+    // Track the held state, it only follows scan results that stayed unchanged for the debounce time
+    if (kp->keys_pressed != kp->keys_last) {
+        kp->keys_last = kp->keys_pressed;
+        kp->tick_last_change = now;
+    } else if ((TickType_t)(now - kp->tick_last_change) >= kp->debounce_time) {
+        keypad_update_held(kp, kp->keys_pressed);
+    }
+
+#if (KEYPAD_SPECULATIVE_EVENTS)
+    // The pressed keys settled, resolve the tentative keys. Keys held since the last scan survived the
+    // debounce time, keys_down only lost the keys released while the debounce timer was still running.
+    if (kp->keys_tentative && !keypad_debounce_running(kp)) {
+        keys_confirm = kp->keys_tentative & (kp->keys_pressed | kp->keys_down);
+        if (keys_confirm) {
+            keypad_publish(kp, KEY_CONFIRM, keys_confirm);
+        }
+        if (kp->keys_tentative & ~keys_confirm) {
+            keypad_publish(kp, KEY_CANCEL, kp->keys_tentative & ~keys_confirm);
+        }
+        kp->keys_confirmed |= keys_confirm;
+        kp->keys_tentative = KEY_NONE;
+    }
+#endif
+
+    // If any key is currently pressed:
+    if (kp->keys_pressed) {
+#if (KEYPAD_SPECULATIVE_EVENTS)
+        // First raw edge of these keys, announce them before they are debounced. Keys still waiting for
+        // their verdict are not announced again when they bounce.
+        keys_new = kp->keys_pressed & ~(kp->keys_tentative | kp->keys_confirmed);
+        if (keys_new) {
+            keypad_publish(kp, KEY_TENTATIVE, keys_new);
+            kp->keys_tentative |= keys_new;
+        }
+#endif
+
+        // If the pressed keys differ from the keys in the previous iteration:
+        if (kp->keys_pressed != kp->keys_down) {
+            // Reset the debounce timer
+            keypad_debounce_restart(kp);
+        }
+
+        // Update keys_down to remember the current state of keys.
+        kp->keys_down |= kp->keys_pressed;
+    } else {
+        // Key released
+#if (KEYPAD_SPECULATIVE_EVENTS)
+        // A new press of the confirmed keys is announced again, the tentative keys wait for their verdict
+        kp->keys_confirmed = KEY_NONE;
+#endif
+
+        // Check if the debounce timer is not active (debounce time has passed) and a key was previously pressed
+        if (kp->keys_down != KEY_NONE && !keypad_debounce_running(kp)) {
+            // Broadcast the released keys
+            keypad_publish_keys(kp, kp->keys_down);
+        }
+
+        // Reset keys_down state
+        kp->keys_down = KEY_NONE;
+    }
+}
+#endif
+
+/**
+ * @brief Raises the task priority while keys are being debounced and drops it again when idle.
+ *
+ * Idle keypads only need background scanning, so the task runs at KEYPAD_TASK_PRIORITY and
+ * does not preempt real work. While a keypad has a debounce or hold-off timer running, a tentative
+ * press waiting for its verdict, a held state still to settle or events its consumers did not take
+ * yet, the task is raised to KEYPAD_TASK_PRIORITY_BOOST so that the debounce timing does not stretch
+ * under load. A key held down once its state is stable is idle again. Boosts are counted in the statistics.
+ */
+static void keypad_update_priority(void) {
+    UBaseType_t busy = 0;
+    const keypad_t* kp;
+    TickType_t now;
+    uint8_t i;
+
+    // The task is busy as long as any of its keypads is
+    for (i = 0; i < KEYPAD_INSTANCE_COUNT; i++) {
+        kp = &keypads[i];
+#if (KEYPAD_DEBOUNCE_MODE == KEYPAD_DEBOUNCE_EAGER)
+        busy |= xTimerIsTimerActive(kp->timer_debounce) || xTimerIsTimerActive(kp->timer_holdoff);
+#else
+        busy |= keypad_debounce_running(kp);
+#endif
+        busy |= kp->keys_tentative != KEY_NONE || kp->keys_held != kp->keys_pressed;
+        busy |= uxQueueMessagesWaiting(kp->queue) != 0;
+    }
+
+    if (busy && !keypad_boosted) {
+        vTaskPrioritySet(NULL, KEYPAD_TASK_PRIORITY_BOOST);
+        keypad_boosted = 1;
+        keypad_tick_boost = xTaskGetTickCount();
+        keypad_stats.boost_count++;
+    } else if (!busy && keypad_boosted) {
+        now = xTaskGetTickCount();
+        vTaskPrioritySet(NULL, KEYPAD_TASK_PRIORITY);
+        keypad_boosted = 0;
+        keypad_stats.boost_ticks += (TickType_t)(now - keypad_tick_boost);
+    }
+}
+
+/**
+ * @brief Returns the debounce time to use for a keypad.
+ *
+ * A key is only debounced if the debounce time spans at least two samples of its row.
+ * The requested time is stretched when the slowest rate class would not be sampled twice.
+ *
+ * @param kp The keypad.
+ * @param debounce_time Requested debounce time in ticks.
+ */
+static TickType_t keypad_debounce_time(const keypad_t* kp, TickType_t debounce_time) {
+    const keypad_layout_t* layout = &KEYPAD_LAYOUT[kp->index];
+    uint8_t i;
+
+    for (i = 0; i < kp->row_count; i++) {
+        if (debounce_time < 2 * layout->row_divider[i] * keypad_task_delay) {
+            debounce_time = 2 * layout->row_divider[i] * keypad_task_delay;
+        }
+    }
+    return debounce_time;
+}
+
+/**
+ * @brief Applies a timing change requested with keypad_set_timing.
+ *
+ * Changing the period of a dormant FreeRTOS timer also starts it, so only the debounce timers that were
+ * dormant are stopped again. A running debounce goes on with the new period, counted from now.
+ */
+static void keypad_apply_timing(void) {
+    TickType_t debounce_time;
+    BaseType_t running;
+    keypad_t* kp;
+    uint8_t i;
+
+    keypad_task_delay = keypad_request_period;
+    for (i = 0; i < KEYPAD_INSTANCE_COUNT; i++) {
+        kp = &keypads[i];
+        debounce_time = (keypad_request_debounce != 0) ? keypad_request_debounce : kp->debounce_time;
+        kp->debounce_time = keypad_debounce_time(kp, debounce_time);
+        running = xTimerIsTimerActive(kp->timer_debounce);
+        KEYPAD_TIMER_WAIT(xTimerChangePeriod(kp->timer_debounce, kp->debounce_time, KEYPAD_TIMER_TIMEOUT));
+        if (running == pdFALSE) {
+            KEYPAD_TIMER_STOP(kp->timer_debounce);
+        }
+    }
+    keypad_request_timing = 0;
+}
+
+/**
+ * @brief Runs the line self-test requested with keypad_selftest.
+ *
+ * Rows are released between scans, so every column has to read high through its pull-up.
+ * A column reading low is stuck low or shorted to ground.
+ */
+static void keypad_run_selftest(void) {
+    const keypad_t* kp = &keypads[keypad_selftest_index];
+    uint32_t stuck = 0;
+    uint8_t col;
+
+#if KEYPAD_BIDIRECTIONAL
+    // The test reads the columns as inputs
+    keypad_orient(0);
+#endif
+
+    // A charlieplexed keypad has one pin more than the columns of a pass
+    for (col = 0; col < kp->col_count + KEYPAD_LAYOUT[kp->index].charlieplex; col++) {
+        if (keypad_col_read(kp, col) == 0) {
+            stuck |= 1UL << col;
+        }
+    }
+    keypad_selftest_result = stuck;
+    portMEMORY_BARRIER();
+    keypad_selftest_state = 2;
+}
+
+#if (KEYPAD_PRESENCE_DETECT != KEYPAD_PRESENCE_NONE)
+/**
+ * @brief Probes whether a keypad is attached.
+ *
+ * With KEYPAD_PRESENCE_PIN the detect pin reads low while the keypad is plugged in. With
+ * KEYPAD_PRESENCE_SIGNATURE the columns are switched to the internal pull-downs and read with the rows
+ * released: the pull-ups of the keypad hold every column high, an unplugged cable lets them fall low.
+ * The columns are switched back to the pull-ups before returning.
+ *
+ * @param kp The keypad.
+ *
+ * @return 1 if the keypad is attached, 0 otherwise.
+ */
+static uint8_t keypad_presence_probe(const keypad_t* kp) {
+    const keypad_layout_t* layout = &KEYPAD_LAYOUT[kp->index];
+#if (KEYPAD_PRESENCE_DETECT == KEYPAD_PRESENCE_PIN)
+    return layout->detect == NULL || KEYPAD_GPIO_GET(layout->detect->port, layout->detect->pin) == 0;
+#else
+    uint8_t present = 1;
+    uint8_t col;
+
+#if KEYPAD_BIDIRECTIONAL
+    keypad_orient(0);
+#endif
+    for (col = 0; col < kp->col_count; col++) {
+        KEYPAD_GPIO_INIT(layout->cols[col].port, layout->cols[col].pin, KEYPAD_GPIO_MODE_IPD);
+    }
+    keypad_stabilize();
+    for (col = 0; col < kp->col_count; col++) {
+        if (keypad_col_read(kp, col) == 0) {
+            present = 0;
+        }
+        KEYPAD_GPIO_INIT(layout->cols[col].port, layout->cols[col].pin, KEYPAD_GPIO_MODE_IPU);
+    }
+    return present;
+#endif
+}
+
+/**
+ * @brief Follows the presence of a keypad.
+ *
+ * Absent keypads are probed every KEYPAD_PRESENCE_PROBE_MS, attached ones every scan cycle with a detect pin
+ * and every KEYPAD_PRESENCE_PROBE_MS with the line signature. A probe that disagrees with the current state
+ * is repeated on the next cycle, and the state only changes when the repeated probe agrees.
+ *
+ * When the keypad is removed, keys that were held are released without reporting them, tentative keys are
+ * cancelled and KEY_REMOVED is published. The scan skips the keypad from then on. When it is attached again,
+ * KEY_ATTACHED is published and the next scan starts from a released keypad.
+ *
+ * @param kp The keypad.
+ */
+static void keypad_update_presence(keypad_t* kp) {
+    TickType_t now = xTaskGetTickCount();
+    uint8_t present;
+
+    if ((!kp->present || KEYPAD_PRESENCE_DETECT == KEYPAD_PRESENCE_SIGNATURE) && kp->presence_count == 0 &&
+        (TickType_t)(now - kp->tick_probe) < KEYPAD_MS_TO_TICKS(KEYPAD_PRESENCE_PROBE_MS)) {
+        return;
+    }
+    kp->tick_probe = now;
+
+    present = keypad_presence_probe(kp);
+    if (present == kp->present) {
+        kp->presence_count = 0;
+        return;
+    }
+    if (++kp->presence_count < 2) {
+        return;
+    }
+    kp->presence_count = 0;
+    kp->present = present;
+
+    if (present) {
+        keypad_publish(kp, KEY_ATTACHED, KEY_NONE);
+        return;
+    }
+
+#if (KEYPAD_SPECULATIVE_EVENTS)
+    // Tentative keys can not be confirmed anymore
+    if (kp->keys_tentative) {
+        keypad_publish(kp, KEY_CANCEL, kp->keys_tentative);
+    }
+#endif
+    KEYPAD_TIMER_STOP(kp->timer_debounce);
+#if (KEYPAD_DEBOUNCE_MODE == KEYPAD_DEBOUNCE_EAGER)
+    KEYPAD_TIMER_STOP(kp->timer_holdoff);
+#endif
+    kp->keys_pressed = KEY_NONE;
+    kp->keys_down = KEY_NONE;
+    kp->keys_last = KEY_NONE;
+    kp->keys_tentative = KEY_NONE;
+    kp->keys_confirmed = KEY_NONE;
+    keypad_publish(kp, KEY_REMOVED, KEY_NONE);
+    keypad_update_held(kp, KEY_NONE);
+}
+#endif
+
+#if KEYPAD_LATENCY_TRACKING
+/**
+ * @brief Publishes the latency SLO misses reported by the consumers.
+ *
+ * Consumers cannot publish events themselves since callbacks run in the keypad task, so keypad_event_receive
+ * and keypad_event_done leave the largest latency for the keypad task to publish as a KEY_LATENCY event.
+ */
+static void keypad_publish_latency(void) {
+    TickType_t latency;
+    uint8_t i;
+
+    for (i = 0; i < KEYPAD_INSTANCE_COUNT; i++) {
+        if (keypad_latency_miss[i] != 0) {
+            taskENTER_CRITICAL();
+            latency = keypad_latency_miss[i];
+            keypad_latency_miss[i] = 0;
+            taskEXIT_CRITICAL();
+            keypad_publish(&keypads[i], KEY_LATENCY, (latency < KEY_EVENT_BITMASK) ? latency : KEY_EVENT_BITMASK);
+        }
+    }
+}
+#endif
+
+/**
+ * @brief Returns the time until the next scan, in ticks.
+ *
+ * This is the scan period. With KEYPAD_EDGE_TIMESTAMPS the task wakes up earlier when the settle time of
+ * pressed keys ends before that, so they are confirmed right after their last edge and not a period later.
+ * When no keypad is attached there is nothing to scan, and the task only wakes up for the presence probes.
+ */
+static TickType_t keypad_next_delay(void) {
+    TickType_t delay = keypad_task_delay;
+#if (KEYPAD_PRESENCE_DETECT != KEYPAD_PRESENCE_NONE)
+    uint8_t k, present = 0;
+
+    for (k = 0; k < KEYPAD_INSTANCE_COUNT; k++) {
+        present |= keypads[k].present || keypads[k].presence_count != 0;
+    }
+    if (!present) {
+        return KEYPAD_MS_TO_TICKS(KEYPAD_PRESENCE_PROBE_MS);
+    }
+#endif
+#if KEYPAD_EDGE_TIMESTAMPS
+    uint32_t counts_per_tick = KEYPAD_EDGE_CLOCK_HZ / configTICK_RATE_HZ;
+    uint32_t now = KEYPAD_EDGE_CLOCK();
+    uint32_t elapsed, remaining;
+    TickType_t ticks;
+    uint8_t i;
+
+    for (i = 0; i < KEYPAD_INSTANCE_COUNT; i++) {
+        if (keypads[i].keys_pressed == KEY_NONE || keypad_edge_stable[i]) {
+            continue;
+        }
+        elapsed = now - keypad_edge_last[i];
+        remaining = (elapsed < keypad_edge_settle) ? (keypad_edge_settle - elapsed) : 0;
+        ticks = (remaining + counts_per_tick - 1) / counts_per_tick;
+        ticks = (ticks > 0) ? ticks : 1;
+        delay = (ticks < delay) ? ticks : delay;
+    }
+#endif
+    return delay;
+}
+
+/**
+ * @brief Counts a scan in the statistics and in the scan time histogram.
+ *
+ * @param counts Time the scan took, in KEYPAD_SCAN_CLOCK counts.
+ */
+static void keypad_scan_record(uint32_t counts) {
+    uint32_t slots = (uint32_t)(((uint64_t)counts * 1000000UL) / KEYPAD_SCAN_CLOCK_HZ / KEYPAD_SCAN_HISTOGRAM_US);
+    uint8_t bin = 0;
+
+    while (bin < (KEYPAD_SCAN_HISTOGRAM_BINS - 1) && (slots >> bin) != 0) {
+        bin++;
+    }
+    keypad_stats.scan_count++;
+    keypad_stats.scan_histogram[bin]++;
+}
+
+/**
+ * @brief Publishes the snapshot read by keypad_get_stats and keypad_get_state.
+ *
+ * The snapshot is written into the buffer that readers are not directed to, then the generation is
+ * advanced to direct them to it. Only the keypad task writes snapshots.
+ */
+static void keypad_publish_snapshot(void) {
+    keypad_snapshot_t* snapshot = &keypad_snapshots[(keypad_snapshot_gen + 1) & 1];
+    const keypad_t* kp;
+    uint8_t i;
+
+    snapshot->stats = keypad_stats;
+    for (i = 0; i < KEYPAD_INSTANCE_COUNT; i++) {
+        kp = &keypads[i];
+        snapshot->state[i].keys_pressed = kp->keys_pressed;
+        snapshot->state[i].keys_held = kp->keys_held;
+        snapshot->state[i].keys_down = kp->keys_down;
+        snapshot->state[i].debounce_time = kp->debounce_time;
+        snapshot->state[i].present = kp->present;
+    }
+    portMEMORY_BARRIER();
+    keypad_snapshot_gen++;
+}
+
+#if KEYPAD_WATCHDOG
+/**
+ * @brief Publishes the heartbeat at the end of a cycle, read by keypad_watchdog_check.
+ *
+ * Only a few stores, the watchdog reads them without any kernel object. The next cycle is due once the delay
+ * has passed, so long delays between scans are not taken for stalls.
+ *
+ * @param delay Delay until the next cycle, in ticks.
+ */
+static void keypad_publish_heartbeat(TickType_t delay) {
+    keypad_heartbeat.tick_due = xTaskGetTickCount() + delay;
+    keypad_heartbeat.stage = KEYPAD_STAGE_SLEEP;
+    keypad_heartbeat.index = 0;
+    portMEMORY_BARRIER();
+    keypad_heartbeat.count++;
+}
+#endif
+
+/**
+ * @brief Task function dedicated to handling the keypad.
+ *
+ * This function `keypad_read` runs indefinitely as a task in the FreeRTOS environment,
+ * dedicated to monitoring and handling user interactions with the keypads of KEYPAD_LAYOUT.
+ * A single task services all of them, each keypad keeps its own debounce state, queue and event group.
+ *
+ * Its primary responsibilities involve:
+ * - Scanning the keypad for keypresses
+ * - Applying a software debouncing mechanism to filter unintended quick, repeated actuations
+ *   (selected with KEYPAD_DEBOUNCE_MODE, see keypad_debounce)
+ *
+ * In each iteration of the main task loop, the function first scans the entire keypad for
+ * any pressed keys. To address the problem of key 'bouncing', it makes use of a FreeRTOS
+ * timer which adds a delay before a keypress is registered. This debounce timer is reset
+ * whenever a keypress is detected.
+ *
+ * When no keys are pressed, the function the timer and resets the necessary tracking
+ * variables.
+ *
+ * The state of the keypad is communicated to other parts of the application through two means
+ * an event group and a queue. Both of these provide similar functionality and can be disabled
+ * based on the user's requirements and application scenario. They facilitate inter-task communication
+ * and synchronization.
+ *
+ * @note Even though the `param` parameter is included in the function signature, it is not
+ * currently utilized in this implementation. Its presence is required to comply with
+ * the FreeRTOS task function signature.
+ *
+ * @param param Unused parameter.
+ */
+void keypad_read(void* param) {
+    TickType_t delay;
+    uint32_t clock_scan;
+    keypad_t* kp;
+    uint8_t i, shard;
+
+    for (i = 0; i < KEYPAD_INSTANCE_COUNT; i++) {
+        kp = &keypads[i];
+
+        // A task restarted by the watchdog recovery keeps the kernel objects of the stalled one.
+        if (kp->timer_debounce != NULL) {
+            continue;
+        }
+
+        // Create a timer to handle debounce. The dummy_timer_callback function is used as the callback.
+        kp->timer_debounce = xTimerCreate("Debounce", kp->debounce_time, pdFALSE, (void*)0, dummy_timer_callback);
+
+        // Create the Event Groups to handle synchronization across tasks that depend on keypress events.
+        // Each group holds KEYPAD_EVENT_GROUP_BITS keys, keypads with more keys get a group per shard.
+        for (shard = 0; shard * KEYPAD_EVENT_GROUP_BITS < kp->row_count * kp->col_count * KEYPAD_SCAN_PASSES;
+             shard++) {
+            kp->pulse_groups[shard] = xEventGroupCreate();
+            kp->held_groups[shard] = xEventGroupCreate();
+
+            // All bits in the event groups are cleared at the start to avoid carrying over any previous state.
+            xEventGroupClearBits(kp->pulse_groups[shard], KEY_EVENT_BITMASK);
+            xEventGroupClearBits(kp->held_groups[shard], KEY_EVENT_BITMASK);
+        }
+        kp->event_group = kp->pulse_groups[0];
+
+        // Create the hold-off timer used by the eager debounce mode to ignore contact bounce after a press.
+#if (KEYPAD_DEBOUNCE_MODE == KEYPAD_DEBOUNCE_EAGER)
+        kp->timer_holdoff = xTimerCreate("Holdoff", KEYPAD_MS_TO_TICKS(KEYPAD_EAGER_HOLDOFF_MS), pdFALSE, (void*)0,
+                                         dummy_timer_callback);
+#endif
+    }
+
+    // The first keypad is also reachable through the global handles.
+    keypad_event_group = keypads[0].event_group;
+
+    // The main loop of the task.
+    for (;;) {
+#if KEYPAD_EDGE_TIMESTAMPS
+        // Stop recording edges and release the rows held low since the last scan.
+        keypad_edge_arm(0);
+#endif
+
+#if KEYPAD_FAULT_INJECTION
+        // Issue the timer resets the fault profile held back.
+        keypad_fault_timer_poll();
+#endif
+
+        // Serve the requests of the diagnostics API between two scans, when all rows are released.
+        KEYPAD_STAGE(KEYPAD_STAGE_REQUEST, 0);
+        if (keypad_request_timing) {
+            keypad_apply_timing();
+        }
+        if (keypad_selftest_state == 1) {
+            keypad_run_selftest();
+        }
+
+#if (KEYPAD_PRESENCE_DETECT != KEYPAD_PRESENCE_NONE)
+        // Stop scanning unplugged keypads and resume once they are back.
+        for (i = 0; i < KEYPAD_INSTANCE_COUNT; i++) {
+            KEYPAD_STAGE(KEYPAD_STAGE_PRESENCE, i);
+            keypad_update_presence(&keypads[i]);
+        }
+#endif
+
+        // Scan all keypads and store the results in their keys_pressed, timing the scan for the statistics.
+        KEYPAD_STAGE(KEYPAD_STAGE_SCAN, 0);
+        clock_scan = KEYPAD_SCAN_CLOCK();
+#if KEYPAD_BIDIRECTIONAL
+        keypad_scan_bidirectional();
+#else
+        keypad_scan();
+#endif
+        keypad_scan_record(KEYPAD_SCAN_CLOCK() - clock_scan);
+
+        // Run the scan results through the configured debounce strategy.
+        for (i = 0; i < KEYPAD_INSTANCE_COUNT; i++) {
+            KEYPAD_STAGE(KEYPAD_STAGE_DEBOUNCE, i);
+            keypad_debounce(&keypads[i]);
+        }
+
+        KEYPAD_STAGE(KEYPAD_STAGE_PUBLISH, 0);
+
+#if KEYPAD_LATENCY_TRACKING
+        // Report the consumers that handled events too late.
+        keypad_publish_latency();
+#endif
+
+        // Only run at the boosted priority while there is debouncing to do.
+        keypad_update_priority();
+
+        // Make the new state visible to the diagnostics readers.
+        keypad_publish_snapshot();
+
+#if KEYPAD_EDGE_TIMESTAMPS
+        // Hold the rows low until the next scan so the column interrupts see every edge.
+        keypad_edge_arm(1);
+#endif
+
+        // Yield the CPU to other tasks
+        delay = KEYPAD_CYCLE_DELAY(keypad_next_delay());
+#if KEYPAD_WATCHDOG
+        // After a timer fault the cycles no longer count as completed, the watchdog restarts the task
+        if (!keypad_timer_failed) {
+            keypad_publish_heartbeat(delay);
+        }
+#endif
+        vTaskDelay(delay);
+    }
+}
+
+#if KEYPAD_MPU
+// Parameters of the restricted keypad task, without portPRIVILEGE_BIT in its priority so it runs unprivileged.
+static const TaskParameters_t keypad_task_params = {
+    .pvTaskCode = keypad_read,
+    .pcName = "Keypad",
+    .usStackDepth = KEYPAD_TASK_STACK_SIZE,
+    .pvParameters = NULL,
+    .uxPriority = KEYPAD_TASK_PRIORITY,
+    .puxStackBuffer = keypad_task_stack,
+    .xRegions = {
+        {__keypad_mpu_private_start__, KEYPAD_MPU_PRIVATE_SIZE,
+         portMPU_REGION_READ_WRITE | portMPU_REGION_EXECUTE_NEVER},
+        {__keypad_mpu_shared_start__, KEYPAD_MPU_SHARED_SIZE, portMPU_REGION_READ_WRITE | portMPU_REGION_EXECUTE_NEVER},
+        {(void*)KEYPAD_MPU_GPIO_BASE, KEYPAD_MPU_GPIO_SIZE, portMPU_REGION_READ_WRITE | portMPU_REGION_EXECUTE_NEVER},
+    },
+};
+#endif
+
+/**
+ * @brief Sets up the key state and the GPIO pins of a keypad, for keypad_init and the watchdog recovery.
+ *
+ * @param kp The keypad.
+ */
+static void keypad_reset(keypad_t* kp) {
+#if KEYPAD_BIDIRECTIONAL
+    // keypad_gpio_init sets the lines up in the forward direction
+    keypad_reversed = 0;
+#endif
+#if KEYPAD_CHARLIEPLEX
+    keypad_charlie_drive[kp->index] = kp->row_count;
+#endif
+#if KEYPAD_MUX
+    keypad_mux_channel[kp->index] = 0;
+#endif
+
+    // Initialize key state
+    kp->keys_pressed = 0;   // Set all keys to not pressed (0) as the initial state.
+    kp->keys_down = 0;      // Set no keys as being pressed down (0) as the initial state.
+    kp->keys_last = 0;      // No previous scan result yet.
+    kp->keys_tentative = 0; // No speculative press announced yet.
+    kp->keys_confirmed = 0; // No speculative press confirmed yet.
+    kp->keys_held = 0;      // No key held as the initial state.
+    kp->tick_last_change = 0;
+
+    // Keypads are considered attached until a presence probe finds them missing.
+    kp->present = 1;
+    kp->presence_count = 0;
+    kp->tick_probe = 0;
 
     // Calls the function to initialize the GPIO pins for the keypad.
-    keypad_gpio_init();
-
-    // Create a FreeRTOS task for reading keypad
-    // The task is named "Keypad", and uses the minimal stack size for it.
-    // The priority of the task is set to 3 units higher than the idle priority.
-    // We are not passing any parameters to the task function, hence NULL.
-    // Also, we are not using the task handle, so we pass NULL for it too.
-    xTaskCreate(keypad_read, "Keypad", configMINIMAL_STACK_SIZE, NULL, (tskIDLE_PRIORITY + 3), NULL);
+    keypad_gpio_init(kp);
+}
+
+/**
+ * @brief Creates the keypad task, for keypad_init and the watchdog recovery.
+ *
+ * The task is named "Keypad", and uses KEYPAD_TASK_STACK_SIZE, the event callbacks run on this stack.
+ * It starts at the idle keypad priority, keypad_update_priority boosts it while keys are debounced.
+ * We are not passing any parameters to the task function, hence NULL.
+ */
+static void keypad_task_create(void) {
+#if KEYPAD_WATCHDOG
+    // The first cycle is due right away.
+    keypad_heartbeat.stage = KEYPAD_STAGE_START;
+    keypad_heartbeat.index = 0;
+    keypad_heartbeat.timer_wait = 0;
+    keypad_heartbeat.tick_due = xTaskGetTickCount();
+    keypad_timer_failed = 0;
+#endif
+
+#if KEYPAD_MPU
+    // Unprivileged, the task only reaches its stack, the keypad sections and the GPIO ports.
+    xTaskCreateRestricted(&keypad_task_params, &keypad_task);
+#else
+    xTaskCreate(keypad_read, "Keypad", KEYPAD_TASK_STACK_SIZE, NULL, KEYPAD_TASK_PRIORITY, &keypad_task);
+#endif
+}
+
+/**
+ * @brief Initializes the keypads.
+ *
+ * This function initializes every keypad of KEYPAD_LAYOUT by performing the following steps:
+ * - Takes the number of rows and columns from the keypad layout.
+ * - Sets the initial state of key-related variables.
+ * - Calls the keypad_gpio_init function to initialize GPIO, then KEYPAD_GPIO_FINISH once for all keypads.
+ * - Creates a FreeRTOS task for reading keypad input.
+ *
+ * @note This function should be called before using the keypad.
+ *       It sets up the necessary components and starts the keypad task for input scanning.
+ *
+ * @return pdPASS on success, pdFAIL if KEYPAD_GPIO_FINISH failed. The keypad task is not started then.
+ */
+BaseType_t keypad_init(void) {
+    const keypad_layout_t* layout;
+    keypad_t* kp;
+    uint8_t i, k;
+
+    keypad_row_max = 0;
+    keypad_col_max = 0;
+    keypad_reversed = 0;
+    keypad_scan_cycle = 0;
+    keypad_boosted = 0;
+    keypad_stats = (keypad_stats_t){0};
+    keypad_task_delay = KEYPAD_MS_TO_TICKS(KEYPAD_TASK_DELAY_MS);
+
+    // Prepare the busy-wait of the sub-tick delays.
+    KEYPAD_DELAY_INIT();
+
+    for (k = 0; k < KEYPAD_INSTANCE_COUNT; k++) {
+        kp = &keypads[k];
+        layout = &KEYPAD_LAYOUT[k];
+        kp->index = k;
+
+        // Take the number of rows and columns from the layout, KEYPAD_LAYOUT_ENTRY computed them from the size
+        // of the GPIO arrays. A keypad can have up to 32 keys, KEYPAD_BIDIRECTIONAL reads two per position.
+        kp->row_count = layout->row_count;
+        kp->col_count = layout->col_count;
+        configASSERT((kp->row_count * kp->col_count * KEYPAD_SCAN_PASSES) <= 32);
+        kp->upper_shift = KEYPAD_BIDIRECTIONAL ? kp->row_count * kp->col_count : KEYPAD_EVENT_GROUP_BITS;
+        if (kp->row_count > keypad_row_max) {
+            keypad_row_max = kp->row_count;
+        }
+        if (kp->col_count > keypad_col_max) {
+            keypad_col_max = kp->col_count;
+        }
+
+#if KEYPAD_EDGE_TIMESTAMPS
+        // Every column line needs an edge ring.
+        configASSERT(kp->col_count <= KEYPAD_EDGE_MAX_COLS);
+#endif
+
+        // Every row needs a scan rate class.
+        configASSERT(layout->divider_count == kp->row_count);
+
+        // Charlieplexed keypads need KEYPAD_CHARLIEPLEX. The key count limits them to 6 pins.
+        configASSERT(!layout->charlieplex || KEYPAD_CHARLIEPLEX);
+
+        // Multiplexed keypads need KEYPAD_MUX and have up to 8 columns.
+        configASSERT(!layout->mux || (KEYPAD_MUX && !layout->charlieplex));
+#if KEYPAD_MUX
+        configASSERT(!layout->mux || kp->col_count <= KEYPAD_MUX_CHANNELS);
+        keypad_mux_order_init(kp);
+#endif
+
+        for (i = 0; i < kp->row_count; i++) {
+            configASSERT(layout->row_divider[i] > 0);
+        }
+
+        // Stretch the debounce time if needed so that it spans two samples of every row.
+        kp->debounce_time = keypad_debounce_time(kp, KEYPAD_MS_TO_TICKS(KEYPAD_DEBOUNCE_MS));
+
+        // Set up the key state and the GPIO pins.
+        keypad_reset(kp);
+
+        // Create a queue to handle inter-task communication. The queue size is defined by KEYPAD_QUEUE_SIZE.
+        // It is created here rather than by the keypad task, so consumers can add it to a queue set while it is
+        // still empty, see keypad_queue_set_add.
+        kp->queue = xQueueCreate(KEYPAD_QUEUE_SIZE, sizeof(uint32_t));
+    }
+    keypad_queue = keypads[0].queue;
+
+    // The GPIO driver may claim the lines only once all keypads declared theirs.
+    if (KEYPAD_GPIO_FINISH() != 0) {
+        return pdFAIL;
+    }
+
+#if KEYPAD_EDGE_TIMESTAMPS
+    // Start the edge timestamp clock and convert the edge times to its counts.
+    KEYPAD_EDGE_CLOCK_INIT();
+    keypad_edge_settle = (KEYPAD_EDGE_CLOCK_HZ / 1000000UL) * KEYPAD_EDGE_SETTLE_US;
+    keypad_edge_guard = (KEYPAD_EDGE_CLOCK_HZ / 1000000UL) * KEYPAD_EDGE_GUARD_US;
+#endif
+
+#if KEYPAD_MPU
+    // The MPU regions of the keypad task must be aligned to their size.
+    configASSERT(((uint32_t)__keypad_mpu_private_start__ & (KEYPAD_MPU_PRIVATE_SIZE - 1)) == 0);
+    configASSERT(((uint32_t)__keypad_mpu_shared_start__ & (KEYPAD_MPU_SHARED_SIZE - 1)) == 0);
+#endif
+#if KEYPAD_WATCHDOG
+    keypad_recoveries = 0;
+#if (KEYPAD_WATCHDOG_RECOVER_MS > 0)
+    keypad_recover_backoff = 0;
+#endif
+#endif
+
+    keypad_task_create();
+    return pdPASS;
+}
+
+/**
+ * @brief Registers a function to be called for every published keypad event.
+ *
+ * Callbacks are an alternative to the event group and the queue for consumers that want to react
+ * to events directly, such as output backends. They run in the context of the keypad task, so they
+ * must return quickly and must not block.
+ *
+ * @param callback Function to call for every event.
+ * @param ctx Context pointer passed back to the callback.
+ *
+ * @return pdPASS if the callback was registered, pdFAIL if all KEYPAD_MAX_CALLBACKS slots are used.
+ */
+BaseType_t keypad_register_callback(keypad_callback_t callback, void* ctx) {
+    BaseType_t result = pdFAIL;
+    uint8_t i;
+
+    // The keypad task walks the table while publishing, so fill the slot atomically.
+    taskENTER_CRITICAL();
+    for (i = 0; i < KEYPAD_MAX_CALLBACKS; i++) {
+        if (keypad_callbacks[i].callback == NULL) {
+            keypad_callbacks[i].ctx = ctx;
+            keypad_callbacks[i].callback = callback;
+            result = pdPASS;
+            break;
+        }
+    }
+    taskEXIT_CRITICAL();
+
+    return result;
+}
+
+/**
+ * @brief Copies the current snapshot without locking.
+ *
+ * The keypad task never writes the buffer the generation points to, it writes the other one and then
+ * advances the generation. If the generation moved while copying, the buffer may have been rewritten in
+ * the meantime and the copy is repeated. A retry only happens when the keypad task ran during the copy,
+ * so readers of any priority complete and never delay the keypad task.
+ *
+ * @param snapshot Structure receiving the snapshot.
+ */
+static void keypad_read_snapshot(keypad_snapshot_t* snapshot) {
+    uint32_t gen;
+
+    do {
+        gen = keypad_snapshot_gen;
+        portMEMORY_BARRIER();
+        *snapshot = keypad_snapshots[gen & 1];
+        portMEMORY_BARRIER();
+    } while (gen != keypad_snapshot_gen);
+}
+
+/**
+ * @brief Reads the statistics of the keypad task.
+ *
+ * The statistics are read from the snapshot the keypad task publishes once per scan cycle.
+ *
+ * @param stats Structure receiving a consistent copy of the statistics.
+ */
+void keypad_get_stats(keypad_stats_t* stats) {
+    keypad_snapshot_t snapshot;
+
+    keypad_read_snapshot(&snapshot);
+    *stats = snapshot.stats;
+}
+
+/**
+ * @brief Reads the state of a keypad.
+ *
+ * The state is read from the snapshot the keypad task publishes once per scan cycle.
+ *
+ * @param index Index of the keypad in KEYPAD_LAYOUT.
+ * @param state Structure receiving a consistent copy of the state.
+ *
+ * @return pdPASS on success, pdFAIL if the index is out of range.
+ */
+BaseType_t keypad_get_state(uint8_t index, keypad_state_t* state) {
+    keypad_snapshot_t snapshot;
+
+    if (index >= KEYPAD_INSTANCE_COUNT) {
+        return pdFAIL;
+    }
+    keypad_read_snapshot(&snapshot);
+    *state = snapshot.state[index];
+    return pdPASS;
+}
+
+/**
+ * @brief Reads the most recent events from the trace ring, oldest first.
+ *
+ * The entries are copied without locking. Entries the keypad task overwrote while they were being
+ * copied, including one it may have been writing at that moment, are dropped from the oldest end.
+ *
+ * @param trace Array receiving the entries.
+ * @param max Number of entries the array can hold.
+ *
+ * @return Number of entries copied.
+ */
+uint8_t keypad_get_trace(keypad_trace_t* trace, uint8_t max) {
+    uint32_t start, end, count, invalid;
+    uint32_t i;
+
+    end = keypad_trace_count;
+    portMEMORY_BARRIER();
+    count = (end < KEYPAD_TRACE_SIZE) ? end : KEYPAD_TRACE_SIZE;
+    count = (count < max) ? count : max;
+    start = end - count;
+
+    for (i = 0; i < count; i++) {
+        trace[i] = keypad_trace[(start + i) % KEYPAD_TRACE_SIZE];
+    }
+
+    portMEMORY_BARRIER();
+    end = keypad_trace_count;
+    invalid = (end + 1 > start + KEYPAD_TRACE_SIZE) ? (end + 1 - start - KEYPAD_TRACE_SIZE) : 0;
+    if (invalid >= count) {
+        return 0;
+    }
+    for (i = 0; i < count - invalid; i++) {
+        trace[i] = trace[i + invalid];
+    }
+    return (uint8_t)(count - invalid);
+}
+
+/**
+ * @brief Changes the scan period and debounce time at run time.
+ *
+ * The values are handed to the keypad task, which applies them before its next scan. The debounce
+ * time is stretched per keypad when it would not span two samples of every row.
+ *
+ * @param scan_period New scan period in ticks, at least 1.
+ * @param debounce_time New debounce time in ticks, 0 keeps the current debounce time.
+ */
+void keypad_set_timing(TickType_t scan_period, TickType_t debounce_time) {
+    keypad_request_period = (scan_period > 0) ? scan_period : 1;
+    keypad_request_debounce = debounce_time;
+    portMEMORY_BARRIER();
+    keypad_request_timing = 1;
+}
+
+/**
+ * @brief Returns the current scan period, in ticks.
+ */
+TickType_t keypad_get_scan_period(void) {
+    return keypad_task_delay;
+}
+
+/**
+ * @brief Reads the build-time parameters of the keypad task.
+ *
+ * keypad_config.h can only be included by keypad.c, this makes its settings available to diagnostics.
+ *
+ * @param params Structure receiving the parameters.
+ */
+void keypad_get_params(keypad_params_t* params) {
+    params->debounce_mode = KEYPAD_DEBOUNCE_MODE;
+    params->speculative = KEYPAD_SPECULATIVE_EVENTS;
+    params->queue_size = KEYPAD_QUEUE_SIZE;
+    params->priority = KEYPAD_TASK_PRIORITY;
+    params->priority_max = KEYPAD_TASK_PRIORITY_BOOST;
+}
+
+/**
+ * @brief Runs the line self-test on a keypad.
+ *
+ * The test is run by the keypad task between two scans so it does not collide with scanning.
+ * Only one self-test can be requested at a time.
+ *
+ * @param index Index of the keypad in KEYPAD_LAYOUT.
+ * @param stuck_cols Receives a bitmask of the columns reading low with all rows released.
+ * @param timeout Maximum time to wait for the keypad task, in ticks.
+ *
+ * @return pdPASS if the test ran, pdFAIL on timeout or if the index is out of range.
+ */
+BaseType_t keypad_selftest(uint8_t index, uint32_t* stuck_cols, TickType_t timeout) {
+    if (index >= KEYPAD_INSTANCE_COUNT) {
+        return pdFAIL;
+    }
+
+    keypad_selftest_index = index;
+    portMEMORY_BARRIER();
+    keypad_selftest_state = 1;
+
+    // The keypad task picks the request up at the start of its next cycle
+    while (keypad_selftest_state != 2) {
+        if (timeout == 0) {
+            keypad_selftest_state = 0;
+            return pdFAIL;
+        }
+        vTaskDelay(1);
+        timeout--;
+    }
+
+    *stuck_cols = keypad_selftest_result;
+    keypad_selftest_state = 0;
+    return pdPASS;
+}
+
+#if KEYPAD_LATENCY_TRACKING
+/**
+ * @brief Records a latency in a histogram of a consumer and checks it against KEYPAD_LATENCY_SLO_MS.
+ *
+ * An event missing the SLO is counted once, even if both its receive and done latencies exceed it.
+ */
+static void keypad_latency_record(keypad_consumer_t* consumer, uint32_t* histogram, TickType_t latency) {
+    uint8_t bin = 0;
+
+    while (bin < (KEYPAD_LATENCY_HISTOGRAM_BINS - 1) && (latency >> bin) != 0) {
+        bin++;
+    }
+    histogram[bin]++;
+
+    if (latency > KEYPAD_MS_TO_TICKS(KEYPAD_LATENCY_SLO_MS) && !consumer->late) {
+        consumer->late = 1;
+        consumer->slo_misses++;
+        taskENTER_CRITICAL();
+        if (latency > keypad_latency_miss[consumer->index]) {
+            keypad_latency_miss[consumer->index] = latency;
+        }
+        taskEXIT_CRITICAL();
+    }
+}
+#endif
+
+/**
+ * @brief Sets up a queue consumer of a keypad.
+ *
+ * The consumer keeps the latency statistics of the task receiving through it. With KEYPAD_LATENCY_TRACKING
+ * enabled, the emit ticks only follow the queue of a keypad with a single consumer, so a keypad accepts one
+ * consumer. Setting up the same consumer again is allowed.
+ *
+ * @param consumer The consumer to set up.
+ * @param index Index of the keypad in KEYPAD_LAYOUT whose queue is consumed.
+ *
+ * @return pdPASS on success, pdFAIL if the index is out of range or, with latency tracking, the keypad already
+ *         has another consumer.
+ */
+BaseType_t keypad_consumer_init(keypad_consumer_t* consumer, uint8_t index) {
+    if (index >= KEYPAD_INSTANCE_COUNT) {
+        return pdFAIL;
+    }
+#if KEYPAD_LATENCY_TRACKING
+    taskENTER_CRITICAL();
+    if (keypad_emit_consumer[index] != NULL && keypad_emit_consumer[index] != consumer) {
+        taskEXIT_CRITICAL();
+        return pdFAIL;
+    }
+    keypad_emit_consumer[index] = consumer;
+    taskEXIT_CRITICAL();
+#endif
+    *consumer = (keypad_consumer_t){0};
+    consumer->index = index;
+    return pdPASS;
+}
+
+/**
+ * @brief Receives an event from the queue of a keypad.
+ *
+ * With KEYPAD_LATENCY_TRACKING enabled, the emit tick of the event is taken from the emit ring and the
+ * emit-to-receive latency is added to the histogram of the consumer. The ring follows the queue order, so
+ * the consumer set up for the keypad must be the only reader of its queue.
+ *
+ * @param consumer The consumer, set up with keypad_consumer_init.
+ * @param event Receives the event.
+ * @param timeout Maximum time to wait for an event, in ticks.
+ *
+ * @return pdPASS if an event was received, pdFAIL on timeout.
+ */
+BaseType_t keypad_event_receive(keypad_consumer_t* consumer, uint32_t* event, TickType_t timeout) {
+#if KEYPAD_LATENCY_TRACKING
+    uint8_t tail;
+#endif
+
+    if (xQueueReceive(keypads[consumer->index].queue, event, timeout) != pdPASS) {
+        return pdFAIL;
+    }
+
+#if KEYPAD_LATENCY_TRACKING
+    configASSERT(keypad_emit_consumer[consumer->index] == consumer);
+    tail = keypad_emit_tail[consumer->index];
+    consumer->tick_emit = keypad_emit_tick[consumer->index][tail];
+    keypad_emit_tail[consumer->index] = (tail + 1) % KEYPAD_EMIT_RING_SIZE;
+
+    consumer->late = 0;
+    keypad_latency_record(consumer, consumer->receive_histogram, xTaskGetTickCount() - consumer->tick_emit);
+#endif
+    return pdPASS;
+}
+
+/**
+ * @brief Acknowledges the handling of the last event received by a consumer.
+ *
+ * Calling it is optional. With KEYPAD_LATENCY_TRACKING enabled, the emit-to-done latency is added to the
+ * histogram of the consumer, this is the latency the user perceives.
+ *
+ * @param consumer The consumer that received the event.
+ */
+void keypad_event_done(keypad_consumer_t* consumer) {
+#if KEYPAD_LATENCY_TRACKING
+    keypad_latency_record(consumer, consumer->done_histogram, xTaskGetTickCount() - consumer->tick_emit);
+#endif
+}
+
+/**
+ * @brief Returns the number of events the keypad queues can hold together.
+ *
+ * A queue set must be long enough for every event of its members, add this to the lengths of the other
+ * members when creating the set with xQueueCreateSet.
+ */
+UBaseType_t keypad_queue_set_length(void) {
+    return KEYPAD_QUEUE_SIZE * KEYPAD_INSTANCE_COUNT;
+}
+
+/**
+ * @brief Adds the queues of all keypads to a queue set.
+ *
+ * A queue can only be added to a set while it is empty. The queues are created by keypad_init, so call this
+ * after it and before the keypad task publishes events, typically before the scheduler starts. The event groups
+ * can not be members of a queue set, the queue carries the same key events.
+ *
+ * @param set The queue set, created with xQueueCreateSet and keypad_queue_set_length.
+ *
+ * @return pdPASS if all queues were added, pdFAIL if a queue already held events or belongs to another set,
+ *         or configUSE_QUEUE_SETS is disabled.
+ */
+BaseType_t keypad_queue_set_add(QueueSetHandle_t set) {
+#if (configUSE_QUEUE_SETS == 1)
+    uint8_t i;
+
+    for (i = 0; i < KEYPAD_INSTANCE_COUNT; i++) {
+        if (keypads[i].queue == NULL || xQueueAddToSet(keypads[i].queue, set) != pdPASS) {
+            return pdFAIL;
+        }
+    }
+    return pdPASS;
+#else
+    return pdFAIL;
+#endif
+}
+
+/**
+ * @brief Receives and decodes the keypad event of a queue set member.
+ *
+ * Call it with every member returned by xQueueSelectFromSet. If the member is the queue of one of the
+ * consumers, the event is received through keypad_event_receive without blocking, so the latency statistics
+ * of the consumer are kept, and split into its keypad, kind and keys. Any other member is left for the caller.
+ *
+ * @param consumers The consumers of the keypads whose queues are in the set.
+ * @param count Number of consumers.
+ * @param member Member returned by xQueueSelectFromSet.
+ * @param event Receives the decoded event.
+ *
+ * @return pdPASS if an event was received, pdFAIL if the member is no keypad queue of the consumers.
+ */
+BaseType_t keypad_event_select(keypad_consumer_t* consumers, uint8_t count, QueueSetMemberHandle_t member,
+                               keypad_event_t* event) {
+    uint32_t raw;
+    uint8_t i;
+
+    for (i = 0; i < count; i++) {
+        if ((QueueSetMemberHandle_t)keypads[consumers[i].index].queue == member) {
+            if (keypad_event_receive(&consumers[i], &raw, 0) != pdPASS) {
+                return pdFAIL;
+            }
+            event->consumer = &consumers[i];
+            event->index = consumers[i].index;
+            event->kind = KEY_EVENT_KIND(raw);
+            event->keys = KEY_EVENT_KEYS(raw);
+            return pdPASS;
+        }
+    }
+    return pdFAIL;
+}
+
+/**
+ * @brief Reads the heartbeat of the keypad task.
+ *
+ * The copy is repeated if the keypad task completed a cycle meanwhile, so its fields belong together.
+ * Reads zeros unless KEYPAD_WATCHDOG is enabled.
+ *
+ * @param heartbeat Structure receiving the heartbeat.
+ */
+void keypad_get_heartbeat(keypad_heartbeat_t* heartbeat) {
+#if KEYPAD_WATCHDOG
+    uint32_t count;
+
+    do {
+        count = keypad_heartbeat.count;
+        portMEMORY_BARRIER();
+        *heartbeat = keypad_heartbeat;
+        portMEMORY_BARRIER();
+    } while (count != keypad_heartbeat.count);
+#else
+    *heartbeat = (keypad_heartbeat_t){0};
+#endif
+}
+
+#if (KEYPAD_WATCHDOG && (KEYPAD_WATCHDOG_RECOVER_MS > 0))
+/**
+ * @brief Restarts a stalled keypad task.
+ *
+ * The stalled task is deleted wherever it is blocked. Consumers hold the handles of its kernel objects, so
+ * they are kept: the timers are stopped without waiting, since a full timer command queue may be what stalled
+ * the task. Queued events stay queued. The held keys are released with a KEY_STATE event, so level-driven
+ * consumers do not keep them pressed, and tentative keys are cancelled. The event goes to the callbacks on the
+ * calling task, the stalled one is gone. The key state and the GPIO pins are set up again as by keypad_init
+ * before a new task is created.
+ */
+static void keypad_watchdog_recover(void) {
+    keypad_t* kp;
+    uint8_t k;
+
+    vTaskDelete(keypad_task);
+
+    for (k = 0; k < KEYPAD_INSTANCE_COUNT; k++) {
+        kp = &keypads[k];
+        if (kp->timer_debounce != NULL) {
+            xTimerStop(kp->timer_debounce, 0);
+        }
+#if (KEYPAD_DEBOUNCE_MODE == KEYPAD_DEBOUNCE_EAGER)
+        if (kp->timer_holdoff != NULL) {
+            xTimerStop(kp->timer_holdoff, 0);
+        }
+#endif
+#if (KEYPAD_SPECULATIVE_EVENTS)
+        if (kp->keys_tentative) {
+            keypad_publish(kp, KEY_CANCEL, kp->keys_tentative);
+        }
+#endif
+        keypad_update_held(kp, KEY_NONE);
+        keypad_reset(kp);
+    }
+
+    // The new task starts at the idle priority, the boost the stalled task was in ends here.
+    if (keypad_boosted) {
+        keypad_boosted = 0;
+        keypad_stats.boost_ticks += (TickType_t)(xTaskGetTickCount() - keypad_tick_boost);
+    }
+    keypad_task_create();
+}
+#endif
+
+/**
+ * @brief Checks whether the keypad task is alive, call it periodically from a watchdog task.
+ *
+ * The task is late once the tick count passed the time its next cycle was due. Late by more than
+ * KEYPAD_WATCHDOG_STALL_MS, it is reported as stalled, with the stage it is stuck in. Late by more than
+ * KEYPAD_WATCHDOG_RECOVER_MS, if that is not 0, it is restarted. The restart deletes the task even inside
+ * an event callback, and needs a privileged caller with KEYPAD_MPU. A task whose timer command timed out no
+ * longer completes cycles (see keypad_timer_check) and is restarted the same way. Each restart that is not
+ * followed by a completed cycle doubles the delay before the next one, so a timer command queue that stays
+ * full does not restart the task in a loop. Always passes unless KEYPAD_WATCHDOG is enabled.
+ *
+ * @param stall Receives the heartbeat, how late the task is and whether it was restarted.
+ *
+ * @return pdPASS if the task is alive, pdFAIL if it stalled.
+ */
+BaseType_t keypad_watchdog_check(keypad_stall_t* stall) {
+#if KEYPAD_WATCHDOG
+    keypad_get_heartbeat(&stall->heartbeat);
+    stall->overdue = xTaskGetTickCount() - stall->heartbeat.tick_due;
+    if (stall->overdue > (portMAX_DELAY >> 1)) {
+        // Not due yet, the task waits for its next cycle
+        stall->overdue = 0;
+    }
+    stall->recovered = 0;
+
+#if (KEYPAD_WATCHDOG_RECOVER_MS > 0)
+    // A completed cycle since the last restart ends the back-off
+    if (stall->heartbeat.count != keypad_recover_count) {
+        keypad_recover_backoff = 0;
+    }
+    if (stall->overdue > (KEYPAD_MS_TO_TICKS(KEYPAD_WATCHDOG_RECOVER_MS) << keypad_recover_backoff)) {
+        keypad_watchdog_recover();
+        keypad_recoveries++;
+        keypad_recover_count = stall->heartbeat.count;
+        if (keypad_recover_backoff < KEYPAD_WATCHDOG_BACKOFF_MAX) {
+            keypad_recover_backoff++;
+        }
+        stall->recovered = 1;
+    }
+#endif
+    stall->recoveries = keypad_recoveries;
+
+    return (stall->overdue > KEYPAD_MS_TO_TICKS(KEYPAD_WATCHDOG_STALL_MS)) ? pdFAIL : pdPASS;
+#else
+    *stall = (keypad_stall_t){0};
+    return pdPASS;
+#endif
+}
+
+/**
+ * @brief Describes the MPU region unprivileged consumers need to read the keypad state.
+ *
+ * The region covers the shared section: snapshots, trace, and the keypads with their queue and event group
+ * handles. It is read-only for unprivileged tasks, add it to the xRegions of their TaskParameters_t.
+ *
+ * @param region Receives the region.
+ *
+ * @return pdPASS on success, pdFAIL unless KEYPAD_MPU is enabled.
+ */
+BaseType_t keypad_mpu_region(MemoryRegion_t* region) {
+#if KEYPAD_MPU
+    region->pvBaseAddress = __keypad_mpu_shared_start__;
+    region->ulLengthInBytes = KEYPAD_MPU_SHARED_SIZE;
+    region->ulParameters = portMPU_REGION_PRIVILEGED_READ_WRITE_UNPRIV_READ_ONLY | portMPU_REGION_EXECUTE_NEVER;
+    return pdPASS;
+#else
+    return pdFAIL;
+#endif
+}
+
+/**
+ * @brief Sets the key sequences detected by the keypads.
+ *
+ * The keypad task picks the new automaton up with the next key event of every keypad, which then starts from
+ * the start state. Does nothing unless KEYPAD_SEQUENCE_DETECT is enabled.
+ *
+ * @param table The sequence automaton, NULL to stop the detection.
+ */
+void keypad_set_sequences(const keypad_sequence_table_t* table) {
+#if KEYPAD_SEQUENCE_DETECT
+    keypad_sequences = table;
+#endif
+}
+
+/**
+ * @brief Records an edge of a column line, call it from the interrupt handler of the line.
+ *
+ * Lock-free: every line has its own ring with this function as the only producer and the keypad task as
+ * the only consumer. Edges outside the window in which the rows are held low between scans are ignored,
+ * as are edges on a full ring, which the keypad task then treats as an edge seen when it drains the ring.
+ * Does nothing unless KEYPAD_EDGE_TIMESTAMPS is enabled.
+ *
+ * @param index Index of the keypad in KEYPAD_LAYOUT.
+ * @param col Column of the keypad whose line changed.
+ */
+void keypad_edge_isr(uint8_t index, uint8_t col) {
+#if KEYPAD_EDGE_TIMESTAMPS
+    uint32_t stamp = KEYPAD_EDGE_CLOCK();
+    keypad_edge_ring_t* ring;
+    uint8_t head;
+
+    if (!keypad_edge_armed || (int32_t)(stamp - keypad_edge_armed_at) < 0 || index >= KEYPAD_INSTANCE_COUNT ||
+        col >= KEYPAD_EDGE_MAX_COLS) {
+        return;
+    }
+
+    ring = &keypad_edge_rings[index][col];
+    head = ring->head;
+    if ((head + 1) % KEYPAD_EDGE_RING_SIZE == ring->tail) {
+        ring->overflow++;
+        return;
+    }
+    ring->stamp[head] = stamp;
+    portMEMORY_BARRIER();
+    ring->head = (head + 1) % KEYPAD_EDGE_RING_SIZE;
+#endif
+}
+
+/**
+ * @brief Returns the number of keypads serviced by the keypad task.
+ */
+uint8_t keypad_count(void) {
+    return KEYPAD_INSTANCE_COUNT;
+}
+
+/**
+ * @brief Returns the state of a keypad.
+ *
+ * Consumers use it to reach the queue and event group of the keypads other than the first one.
+ * The handles are valid once the keypad task has started.
+ *
+ * @param index Index of the keypad in KEYPAD_LAYOUT.
+ *
+ * @return The keypad, or NULL if the index is out of range.
+ */
+const keypad_t* keypad_get(uint8_t index) {
+    return (index < KEYPAD_INSTANCE_COUNT) ? &keypads[index] : NULL;
 }
@@ -7,32 +7,321 @@
 #include <event_groups.h>
 #include <queue.h>
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 // Bitmask for key events. Set to 0x00FFFFFFU to match FreeRTOS EventGroup's 24-bit limit.
 // Do not modify unless you have a specific requirement for a different number of key codes.
 #define KEY_EVENT_BITMASK 0x00FFFFFFU
 
+// Keys are spread over several event groups (shards) of KEYPAD_EVENT_GROUP_BITS keys each, enough for the
+// 32 keys of a keypad. Shard N holds keys N * KEYPAD_EVENT_GROUP_BITS and up, KEYPAD_EVENT_GROUP_KEYS gives
+// the bits of a set of keys in a shard, for example to wait on held_groups[1] for keys 24 to 31.
+#define KEYPAD_EVENT_GROUP_BITS              24
+#define KEYPAD_EVENT_GROUP_SHARDS            2
+#define KEYPAD_EVENT_GROUP_KEYS(KEYS, SHARD) (((KEYS) >> ((SHARD) * KEYPAD_EVENT_GROUP_BITS)) & KEY_EVENT_BITMASK)
+
+// Timing layer. The keypad timing is configured in milliseconds and microseconds and converted to ticks here,
+// so it does not depend on configTICK_RATE_HZ. Conversions to ticks round up, a wait is never shorter than asked.
+#define KEYPAD_MS_TO_TICKS(MS)    ((TickType_t)((((uint64_t)(MS) * configTICK_RATE_HZ) + 999U) / 1000U))
+#define KEYPAD_US_TO_TICKS(US)    ((TickType_t)((((uint64_t)(US) * configTICK_RATE_HZ) + 999999U) / 1000000U))
+#define KEYPAD_TICKS_TO_MS(TICKS) ((uint32_t)(((uint64_t)(TICKS) * 1000U) / configTICK_RATE_HZ))
+
+// Debounce strategies selectable through KEYPAD_DEBOUNCE_MODE in keypad_config.h.
+// - KEYPAD_DEBOUNCE_DEFERRED: a key is reported on release, once it has been stable for KEYPAD_DEBOUNCE_MS.
+// - KEYPAD_DEBOUNCE_EAGER: a key is reported on the first scan that sees it pressed, after which contact changes are
+//   ignored for KEYPAD_EAGER_HOLDOFF_MS. Releases are still debounced for KEYPAD_DEBOUNCE_MS.
+//   Only use this mode with switches that never produce false closures.
+#define KEYPAD_DEBOUNCE_DEFERRED 0
+#define KEYPAD_DEBOUNCE_EAGER    1
+
+// Keypad presence detection selectable through KEYPAD_PRESENCE_DETECT in keypad_config.h, for keypads that can be
+// unplugged while the device runs. A keypad found absent is not scanned, publishes KEY_REMOVED and is probed
+// every KEYPAD_PRESENCE_PROBE_MS until it is back, which publishes KEY_ATTACHED. A change of presence is only
+// taken after two probes in a row agree on it.
+// - KEYPAD_PRESENCE_NONE: keypads are always considered attached.
+// - KEYPAD_PRESENCE_PIN: the keypad grounds a detect pin (the detect field of its layout entry), read every scan
+//   cycle. Keypads without a detect pin are always considered attached.
+// - KEYPAD_PRESENCE_SIGNATURE: the keypad pulls its columns up on its side of the cable. The probe reads the
+//   columns with the rows released, like the self-test, but with the internal pull-downs, so an unplugged cable
+//   reads low. Probes every KEYPAD_PRESENCE_PROBE_MS, also while the keypad is attached. GD32 only.
+#define KEYPAD_PRESENCE_NONE      0
+#define KEYPAD_PRESENCE_PIN       1
+#define KEYPAD_PRESENCE_SIGNATURE 2
+
+// Event kinds carried in the upper byte of a keypad_queue item, above KEY_EVENT_BITMASK.
+// The lower bits hold the keys the event refers to. Plain key events have kind KEY_EVENT_KEY (0),
+// so consumers that compare queue items against key codes keep working unchanged.
+// Only plain key events are broadcast through keypad_event_group.
+#define KEY_EVENT_KIND_MASK   0xFF000000U
+#define KEY_EVENT_KIND(EVENT) ((EVENT) & KEY_EVENT_KIND_MASK)
+#define KEY_EVENT_KEYS(EVENT) ((EVENT) & KEY_EVENT_BITMASK)
+
+// Modifier of the kinds carrying keys, from KEY_EVENT_KEY to KEY_STATE. A set of keys reaching beyond the lower
+// keys of the keypad is published as two event words, the second one with this bit and the upper keys shifted down
+// by the upper_shift of the keypad. The upper keys are the keys read in the reverse pass of KEYPAD_BIDIRECTIONAL,
+// which land on the position of the key read in the forward pass, otherwise the keys from KEYPAD_EVENT_GROUP_BITS
+// up. Consumers comparing KEY_EVENT_KIND see the upper words as a kind of their own.
+#define KEY_EVENT_UPPER            0x80000000U
+#define KEY_EVENT_BASE_KIND(EVENT) (KEY_EVENT_KIND(EVENT) & ~KEY_EVENT_UPPER)
+#define KEY_EVENT_KEY         0x00000000U // Debounced key event
+#define KEY_TENTATIVE         0x01000000U // Raw press edge seen, debounce still running (KEYPAD_SPECULATIVE_EVENTS)
+#define KEY_CONFIRM           0x02000000U // Tentative keys survived the debounce time
+#define KEY_CANCEL            0x03000000U // Tentative keys were released before the debounce time passed
+#define KEY_STATE             0x04000000U // Debounced set of held keys changed, delivered to callbacks only
+#define KEY_LATENCY           0x05000000U // A consumer exceeded KEYPAD_LATENCY_SLO_MS, keys hold the latency in ticks
+#define KEY_REMOVED           0x06000000U // The keypad was unplugged, its held keys were released
+#define KEY_ATTACHED          0x07000000U // The keypad was plugged in again and is scanned again
+#define KEY_SEQUENCE          0x08000000U // A key sequence was completed, keys hold its ID (KEYPAD_SEQUENCE_DETECT)
+
+// Number of bins of the consumer latency histograms. Bin 0 counts latencies of 0 ticks, bin N latencies of
+// 2^(N-1) to 2^N - 1 ticks, the last bin collects longer latencies.
+#define KEYPAD_LATENCY_HISTOGRAM_BINS 8
+
+// Number of bins of the scan time histogram. Bin 0 counts scans shorter than KEYPAD_SCAN_HISTOGRAM_US, bin N scans
+// of KEYPAD_SCAN_HISTOGRAM_US * 2^(N-1) to KEYPAD_SCAN_HISTOGRAM_US * 2^N - 1 us, the last bin collects longer scans.
+#define KEYPAD_SCAN_HISTOGRAM_BINS 8
+#define KEYPAD_SCAN_HISTOGRAM_US   64
+
+// type define of structure holding the statistics of the keypad task.
+typedef struct {
+    uint32_t boost_count;                                // Number of raises to KEYPAD_TASK_PRIORITY_BOOST
+    uint32_t boost_ticks;                                // Ticks spent at the boosted priority, completed boosts only
+    uint32_t scan_count;                                 // Number of scan cycles
+    uint32_t scan_histogram[KEYPAD_SCAN_HISTOGRAM_BINS]; // Scan time histogram, see KEYPAD_SCAN_HISTOGRAM_US
+    uint32_t queue_drops;                                // Events dropped because a keypad queue was full
+    uint32_t timer_faults;                               // Timer commands that found the timer queue full too long
+} keypad_stats_t;
+
+// Stages of a keypad task cycle, see keypad_heartbeat_t.
+#define KEYPAD_STAGE_START    0 // Task created, first cycle not completed yet
+#define KEYPAD_STAGE_REQUEST  1 // Serving keypad_set_timing and keypad_selftest
+#define KEYPAD_STAGE_PRESENCE 2 // Probing the keypad presence
+#define KEYPAD_STAGE_SCAN     3 // Scanning the keypads
+#define KEYPAD_STAGE_DEBOUNCE 4 // Debouncing and publishing the events of a keypad, callbacks included
+#define KEYPAD_STAGE_PUBLISH  5 // Latency reports, priority and snapshot
+#define KEYPAD_STAGE_SLEEP    6 // Waiting for the next cycle
+
+// type define of structure holding the heartbeat of the keypad task, published when KEYPAD_WATCHDOG is enabled.
+typedef struct {
+    uint32_t count;      // Number of completed cycles
+    TickType_t tick_due; // Tick count at which the task is due to start its next cycle
+    uint8_t stage;       // Stage the task is in, KEYPAD_STAGE_*
+    uint8_t index;       // Keypad the stage is working on
+    uint8_t timer_wait;  // Whether the task waits to send a command to the timer service task, or one timed out
+} keypad_heartbeat_t;
+
+// type define of structure holding the result of keypad_watchdog_check.
+typedef struct {
+    keypad_heartbeat_t heartbeat; // Heartbeat at the time of the check, with the stage the task stalled in
+    TickType_t overdue;           // Ticks since the task was due to start its next cycle, 0 if not due yet
+    uint8_t recovered;            // Whether the check restarted the keypad task
+    uint32_t recoveries;          // Number of restarts since keypad_init
+} keypad_stall_t;
+
+// type define of structure holding a snapshot of the state of one keypad.
+typedef struct {
+    uint32_t keys_pressed;    // Raw result of the last scan
+    uint32_t keys_held;       // Debounced keys currently held down
+    uint32_t keys_down;       // Keys accumulated by the debounce strategy
+    TickType_t debounce_time; // Debounce time in ticks
+    uint8_t present;          // Whether the keypad is attached, see KEYPAD_PRESENCE_DETECT
+} keypad_state_t;
+
+// type define of structure holding the build-time parameters of the keypad task, for diagnostics.
+typedef struct {
+    uint8_t debounce_mode;    // KEYPAD_DEBOUNCE_MODE
+    uint8_t speculative;      // KEYPAD_SPECULATIVE_EVENTS
+    uint8_t queue_size;       // KEYPAD_QUEUE_SIZE
+    UBaseType_t priority;     // KEYPAD_TASK_PRIORITY
+    UBaseType_t priority_max; // KEYPAD_TASK_PRIORITY_BOOST
+} keypad_params_t;
+
+// type define of structure holding an entry of the event trace.
+typedef struct {
+    TickType_t tick; // Tick count at which the event was published
+    uint32_t event;  // The published event
+    uint8_t index;   // Index of the keypad that published it
+} keypad_trace_t;
+
 // type define of structure holding the state of the keypad.
 typedef struct {
-    uint8_t col_count;            // Number of columns in the keypad matrix
-    uint8_t row_count;            // Number of rows in the keypad matrix
-    uint32_t keys_pressed;        // Bitmask representing the currently pressed keys
-    uint32_t keys_down;           // Bitmask representing the keys that were just pressed
-    TimerHandle_t timer_debounce; // Timer handle for key debounce functionality
+    uint8_t index;                  // Index of the keypad in KEYPAD_LAYOUT
+    uint8_t col_count;              // Number of columns in the keypad matrix
+    uint8_t row_count;              // Number of rows in the keypad matrix
+    uint8_t upper_shift;            // Bit of the first key carried by the KEY_EVENT_UPPER event words
+    uint32_t keys_pressed;          // Bitmask representing the currently pressed keys
+    uint32_t keys_down;             // Bitmask representing the keys that were just pressed
+    uint32_t keys_last;             // Bitmask of the previous scan, used to debounce releases and the held state
+    uint32_t keys_held;             // Bitmask of the debounced keys currently held down
+    TickType_t tick_last_change;    // Tick count of the last change of the scan result
+    TickType_t debounce_time;       // Debounce time in ticks, stretched to cover two samples of the slowest row
+    uint32_t keys_tentative;        // Bitmask of the keys announced in speculative mode, waiting for their verdict
+    uint32_t keys_confirmed;        // Bitmask of the held keys already confirmed in speculative mode
+    uint8_t present;                // Whether the keypad is attached, only scanned while it is
+    uint8_t presence_count;         // Number of probes in a row that disagreed with present
+    TickType_t tick_probe;          // Tick count of the last presence probe
+    TimerHandle_t timer_debounce;   // Timer handle for key debounce functionality
+    TimerHandle_t timer_holdoff;    // Timer handle for the eager mode hold-off window
+    QueueHandle_t queue;            // Queue receiving the events of this keypad
+    EventGroupHandle_t event_group; // Event group receiving the key events, same as pulse_groups[0]
+    // Event groups of the keypad, one per shard: pulse bits are set when keys are reported,
+    // held bits follow the held keys.
+    EventGroupHandle_t pulse_groups[KEYPAD_EVENT_GROUP_SHARDS];
+    EventGroupHandle_t held_groups[KEYPAD_EVENT_GROUP_SHARDS];
 } keypad_t;
 
+// type define of structure holding the latency statistics of a queue consumer, see keypad_event_receive.
+typedef struct {
+    uint8_t index;                                             // Index of the keypad whose queue is consumed
+    uint8_t late;                                              // Whether the last received event missed the SLO
+    TickType_t tick_emit;                                      // Tick count at which the last received event was queued
+    uint32_t slo_misses;                                       // Events handled later than KEYPAD_LATENCY_SLO_MS
+    uint32_t receive_histogram[KEYPAD_LATENCY_HISTOGRAM_BINS]; // Emit-to-receive latency histogram
+    uint32_t done_histogram[KEYPAD_LATENCY_HISTOGRAM_BINS];    // Emit-to-done latency histogram
+} keypad_consumer_t;
+
+// type define of structure holding a queued event decoded by keypad_event_select.
+typedef struct {
+    keypad_consumer_t* consumer; // Consumer that received the event, for keypad_event_done
+    uint8_t index;               // Index of the keypad in KEYPAD_LAYOUT
+    uint32_t kind;               // Event kind, KEY_EVENT_KEY, KEY_TENTATIVE, ...
+    uint32_t keys;               // Keys of the event, the sequence ID of KEY_SEQUENCE
+} keypad_event_t;
+
+// Symbol of the keys that are not part of any sequence of a sequence automaton.
+#define KEYPAD_SEQUENCE_NO_SYMBOL 0xFFU
+
+// type define of structure holding a sequence automaton, an Aho-Corasick automaton with its failure links
+// resolved into the transitions. Build it at compile time with keypad::compile_sequences, see keypad_sequence.hpp.
+typedef struct {
+    const uint8_t* symbol; // Symbol of every key bit, KEYPAD_SEQUENCE_NO_SYMBOL for keys outside all sequences
+    const uint16_t* next;  // Next state for every state and symbol, at state * symbol_count + symbol
+    const uint16_t* match; // ID + 1 of the sequence completed on entering every state, 0 if none
+    uint8_t symbol_count;  // Number of symbols
+    uint16_t state_count;  // Number of states, state 0 is the start state
+} keypad_sequence_table_t;
+
+// Type of the functions called by the keypad task for every event it publishes.
+// The callback runs in the context of the keypad task and must not block.
+// - kp: State of the keypad that produced the event.
+// - event: The published event, in the same format as the keypad_queue items.
+// - ctx: The context pointer given to keypad_register_callback.
+typedef void (*keypad_callback_t)(const keypad_t* kp, uint32_t event, void* ctx);
+
 // External declaration of the keypad event group handle.
+// It belongs to the first keypad of KEYPAD_LAYOUT, use keypad_get to reach the event groups of the others.
 // This handle can be used to broadcast the result of reading the keypad to other tasks.
 // Other tasks can wait for specific key events by using this event group.
 extern EventGroupHandle_t keypad_event_group;
 
 // External declaration of the keypad queue handle.
+// It belongs to the first keypad of KEYPAD_LAYOUT, use keypad_get to reach the queues of the others.
 // This handle can be used to broadcast the result of reading the keypad to other tasks.
 // Other tasks can listen to the pressed keys by receiving messages from this queue.
 extern QueueHandle_t keypad_queue;
 
 // Function declaration for initializing the keypad.
-// This function should be called to initialize the keypad before using it.
+// This function should be called to initialize the keypads of KEYPAD_LAYOUT before using them.
 // It sets up the necessary configurations and prepares the keypad for key input.
-void keypad_init(void);
+// Returns pdFAIL without starting the keypad task if the GPIO driver could not claim the lines.
+BaseType_t keypad_init(void);
+
+// Function declaration for registering an event callback.
+// The callback is called for every event the keypad task publishes, in addition to the event group and the queue.
+// Up to KEYPAD_MAX_CALLBACKS callbacks can be registered. Returns pdPASS on success and pdFAIL when all slots are used.
+BaseType_t keypad_register_callback(keypad_callback_t callback, void* ctx);
+
+// Function declaration for reading the statistics of the keypad task.
+// Copies a consistent snapshot of the statistics into stats. Lock-free, does not disturb the keypad task.
+void keypad_get_stats(keypad_stats_t* stats);
+
+// Function declaration for reading the state of a keypad.
+// Copies a consistent snapshot into state. Lock-free. Returns pdFAIL if the index is out of range.
+BaseType_t keypad_get_state(uint8_t index, keypad_state_t* state);
+
+// Function declaration for reading the most recent events, oldest first.
+// Copies up to max entries into trace and returns the number copied. Lock-free.
+uint8_t keypad_get_trace(keypad_trace_t* trace, uint8_t max);
+
+// Function declaration for changing the scan period and debounce time at run time.
+// The keypad task applies the new values at the start of its next cycle. A debounce time of 0 keeps the current one.
+void keypad_set_timing(TickType_t scan_period, TickType_t debounce_time);
+
+// Function declaration for reading the current scan period, in ticks.
+TickType_t keypad_get_scan_period(void);
+
+// Function declaration for reading the build-time parameters of the keypad task.
+void keypad_get_params(keypad_params_t* params);
+
+// Function declaration for running the line self-test on a keypad.
+// With all rows released, every column must read high. Columns reading low are reported in stuck_cols as
+// stuck low or shorted. The test runs in the keypad task, the caller waits up to timeout ticks for it.
+// Returns pdPASS if the test ran, pdFAIL on timeout or invalid index.
+BaseType_t keypad_selftest(uint8_t index, uint32_t* stuck_cols, TickType_t timeout);
+
+// Function declaration for setting up a queue consumer of a keypad.
+// Returns pdFAIL if the index is out of range. With KEYPAD_LATENCY_TRACKING enabled, a keypad has a single
+// consumer and pdFAIL is also returned when another consumer was set up for it.
+BaseType_t keypad_consumer_init(keypad_consumer_t* consumer, uint8_t index);
+
+// Function declaration for receiving an event from the queue of the consumer's keypad.
+// Works like xQueueReceive and records the emit-to-receive latency when KEYPAD_LATENCY_TRACKING is enabled.
+// With latency tracking enabled, the consumer must be the only reader of the queue.
+BaseType_t keypad_event_receive(keypad_consumer_t* consumer, uint32_t* event, TickType_t timeout);
+
+// Function declaration for acknowledging the handling of the last received event.
+// Optional, records the emit-to-done latency when KEYPAD_LATENCY_TRACKING is enabled.
+void keypad_event_done(keypad_consumer_t* consumer);
+
+// Function declaration for reading the number of events the keypad queues hold together.
+// Size queue sets with it, see keypad_queue_set_add.
+UBaseType_t keypad_queue_set_length(void);
+
+// Function declaration for adding the queues of all keypads to a queue set, needs configUSE_QUEUE_SETS.
+// The queues must still be empty, call it after keypad_init before the keypad task publishes events.
+// Returns pdFAIL if a queue could not be added.
+BaseType_t keypad_queue_set_add(QueueSetHandle_t set);
+
+// Function declaration for receiving and decoding the event of a member selected from a queue set.
+// Returns pdPASS if the member is the queue of one of the consumers and an event was received, pdFAIL if the
+// member belongs to another source.
+BaseType_t keypad_event_select(keypad_consumer_t* consumers, uint8_t count, QueueSetMemberHandle_t member,
+                               keypad_event_t* event);
+
+// Function declaration for timestamping an edge of a column line when KEYPAD_EDGE_TIMESTAMPS is enabled.
+// Call it from the interrupt handler of the line, configured to trigger on both edges.
+void keypad_edge_isr(uint8_t index, uint8_t col);
+
+// Function declaration for setting the key sequences detected when KEYPAD_SEQUENCE_DETECT is enabled.
+// Every keypad publishes a KEY_SEQUENCE event when its key events complete a sequence of the table.
+// The table must stay valid while it is set, NULL stops the detection.
+void keypad_set_sequences(const keypad_sequence_table_t* table);
+
+// Function declaration for describing the read-only MPU region of the keypad state when KEYPAD_MPU is enabled.
+// Unprivileged consumer tasks need it among their regions to read the snapshots and the keypads.
+// Returns pdFAIL without KEYPAD_MPU.
+BaseType_t keypad_mpu_region(MemoryRegion_t* region);
+
+// Function declaration for reading the heartbeat of the keypad task when KEYPAD_WATCHDOG is enabled.
+// Reads memory only, no kernel object is involved.
+void keypad_get_heartbeat(keypad_heartbeat_t* heartbeat);
+
+// Function declaration for checking the keypad task from a watchdog task when KEYPAD_WATCHDOG is enabled.
+// Returns pdFAIL if the task is late by more than KEYPAD_WATCHDOG_STALL_MS, with the stalled stage in stall.
+// Restarts the task once it is late by more than KEYPAD_WATCHDOG_RECOVER_MS, if that is not 0.
+BaseType_t keypad_watchdog_check(keypad_stall_t* stall);
+
+// Function declaration for reading the number of keypads in KEYPAD_LAYOUT.
+uint8_t keypad_count(void);
+
+// Function declaration for accessing a keypad, for example to reach its queue and event group.
+// Returns NULL if the index is out of range.
+const keypad_t* keypad_get(uint8_t index);
+
+#ifdef __cplusplus
+}
+#endif
 
 #endif
@@ -0,0 +1,191 @@
+#ifndef MATRIX_KEYPAD_HPP
+#define MATRIX_KEYPAD_HPP
+
+#include <coroutine>
+#include <exception>
+#include <keypad.h>
+
+/**
+ * C++20 coroutine consumer API for the keypad.
+ *
+ * Instead of blocking a FreeRTOS task on keypad_queue, a coroutine waits for keys with
+ *
+ *     auto event = co_await keypad.next_event(KEY_ENTER | KEY_STAR);
+ *
+ * or for an event kind that carries no keys, like KEY_REMOVED or the ID of KEY_SEQUENCE, with
+ *
+ *     auto event = co_await keypad.next_kind(KEY_SEQUENCE);
+ *
+ * Both waits can be restricted to one keypad of KEYPAD_LAYOUT, by default any keypad wakes them.
+ *
+ * Suspended coroutines only cost their frame. They are resumed by the keypad task from its event callback,
+ * so many UI flows can wait on keys without a task stack each. Because the coroutines run on the keypad task
+ * stack until their next co_await, they must not block, and KEYPAD_TASK_STACK_SIZE must cover them.
+ */
+namespace keypad {
+
+/**
+ * Fire-and-forget coroutine type for keypad driven flows.
+ *
+ * The coroutine starts running immediately and its frame is released when it finishes.
+ * A flow that never finishes keeps its frame for the lifetime of the program.
+ */
+struct Flow {
+    struct promise_type {
+        Flow get_return_object() noexcept { return {}; }
+
+        std::suspend_never initial_suspend() noexcept { return {}; }
+
+        std::suspend_never final_suspend() noexcept { return {}; }
+
+        void return_void() noexcept {}
+
+        void unhandled_exception() noexcept { std::terminate(); }
+    };
+};
+
+/**
+ * Dispatches keypad events to suspended coroutines.
+ *
+ * There is normally a single instance, attached once after keypad_init.
+ * Waiting coroutines are resumed in the order they started waiting.
+ */
+class Keypad {
+public:
+    /**
+     * Awaitable returned by next_event.
+     *
+     * Lives in the frame of the waiting coroutine, which links it into the waiter list while it is suspended.
+     */
+    class EventAwaiter {
+    public:
+        EventAwaiter(Keypad& keypad, uint32_t mask, uint32_t kind, uint8_t index, bool keyed)
+            : keypad_(keypad), mask_(mask), kind_(kind), index_(index), keyed_(keyed) {}
+
+        bool await_ready() const noexcept { return false; }
+
+        void await_suspend(std::coroutine_handle<> handle) noexcept {
+            handle_ = handle;
+            keypad_.enqueue(this);
+        }
+
+        uint32_t await_resume() const noexcept { return event_; }
+
+    private:
+        friend class Keypad;
+
+        // Whether the awaiter is waiting for this event of the keypad at index.
+        bool matches(uint8_t index, uint32_t event) const noexcept {
+            return KEY_EVENT_KIND(event) == kind_ && (index_ == any_keypad || index_ == index)
+                   && (!keyed_ || (KEY_EVENT_KEYS(event) & mask_) != 0);
+        }
+
+        Keypad& keypad_;
+        uint32_t mask_;
+        uint32_t kind_;
+        uint8_t index_;
+        bool keyed_; // Whether the lower bits of the event are keys to match against the mask
+        uint32_t event_ = 0;
+        std::coroutine_handle<> handle_;
+        EventAwaiter* next_ = nullptr;
+    };
+
+    // Keypad index of the waits that any keypad wakes.
+    static constexpr uint8_t any_keypad = 0xFF;
+
+    Keypad() = default;
+    Keypad(const Keypad&) = delete;
+    Keypad& operator=(const Keypad&) = delete;
+
+    /**
+     * Registers the keypad callback resuming the waiting coroutines.
+     *
+     * @return pdPASS on success, pdFAIL if no keypad callback slot was free.
+     */
+    BaseType_t attach() { return keypad_register_callback(&Keypad::on_event, this); }
+
+    /**
+     * Waits for the next event of the given kind that involves at least one key of the mask.
+     *
+     * Only suits the kinds whose lower bits are keys: KEY_EVENT_KEY, KEY_TENTATIVE, KEY_CONFIRM and KEY_CANCEL.
+     * Wait for the other kinds with next_kind.
+     *
+     * @param mask Keys to wait for, any key by default.
+     * @param kind Event kind to wait for, plain key events by default (see KEY_EVENT_KIND_MASK).
+     * @param index Keypad to wait on, any_keypad by default.
+     *
+     * @return Awaitable producing the whole event word.
+     */
+    EventAwaiter next_event(uint32_t mask = KEY_EVENT_BITMASK, uint32_t kind = KEY_EVENT_KEY,
+                            uint8_t index = any_keypad) {
+        return EventAwaiter(*this, mask, kind, index, true);
+    }
+
+    /**
+     * Waits for the next event of the given kind, whatever its lower bits hold.
+     *
+     * For the kinds that carry no keys, such as KEY_REMOVED and KEY_ATTACHED, or a value, such as the ID of
+     * KEY_SEQUENCE, which is 0 for the first sequence.
+     *
+     * @param kind Event kind to wait for (see KEY_EVENT_KIND_MASK).
+     * @param index Keypad to wait on, any_keypad by default.
+     *
+     * @return Awaitable producing the whole event word.
+     */
+    EventAwaiter next_kind(uint32_t kind, uint8_t index = any_keypad) {
+        return EventAwaiter(*this, KEY_EVENT_BITMASK, kind, index, false);
+    }
+
+private:
+    // Appends a suspended awaiter to the waiter list. Called from the waiting coroutine's context.
+    void enqueue(EventAwaiter* awaiter) noexcept {
+        taskENTER_CRITICAL();
+        *tail_ = awaiter;
+        tail_ = &awaiter->next_;
+        taskEXIT_CRITICAL();
+    }
+
+    // Keypad callback, runs in the keypad task.
+    static void on_event(const keypad_t* kp, uint32_t event, void* ctx) {
+        static_cast<Keypad*>(ctx)->dispatch(kp->index, event);
+    }
+
+    // Resumes every awaiter waiting for the event of the keypad at index.
+    void dispatch(uint8_t index, uint32_t event) noexcept {
+        EventAwaiter* ready = nullptr;
+        EventAwaiter** ready_tail = &ready;
+        EventAwaiter** link;
+        EventAwaiter* awaiter;
+
+        // Unlink the matching awaiters first. Resumed coroutines may wait again right away,
+        // and their new awaiters must not be woken by the event they just received.
+        taskENTER_CRITICAL();
+        link = &waiters_;
+        while ((awaiter = *link) != nullptr) {
+            if (awaiter->matches(index, event)) {
+                *link = awaiter->next_;
+                awaiter->next_ = nullptr;
+                *ready_tail = awaiter;
+                ready_tail = &awaiter->next_;
+            } else {
+                link = &awaiter->next_;
+            }
+        }
+        tail_ = link;
+        taskEXIT_CRITICAL();
+
+        while ((awaiter = ready) != nullptr) {
+            // The awaiter is gone once its coroutine resumes, read the link first
+            ready = awaiter->next_;
+            awaiter->event_ = event;
+            awaiter->handle_.resume();
+        }
+    }
+
+    EventAwaiter* waiters_ = nullptr; // Suspended awaiters in the order they started waiting
+    EventAwaiter** tail_ = &waiters_; // Link to update when appending an awaiter
+};
+
+} // namespace keypad
+
+#endif
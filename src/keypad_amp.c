@@ -0,0 +1,156 @@
+#include <keypad_amp.h>
+
+#ifndef KEYPAD_AMP_HOST
+#include <keypad.h>
+#endif
+
+// Orders the accesses to the slots against the indexes as seen by the other core. A compiler barrier is not
+// enough between cores, the default emits a hardware memory barrier (DMB on ARM).
+#ifndef KEYPAD_AMP_BARRIER
+#define KEYPAD_AMP_BARRIER() __sync_synchronize()
+#endif
+
+// Cache maintenance of the shared RAM. Leave them empty when the shared section is not cacheable,
+// otherwise map them to the clean and invalidate operations of the data cache of the core.
+#ifndef KEYPAD_AMP_CACHE_CLEAN
+#define KEYPAD_AMP_CACHE_CLEAN(ADDR, SIZE)
+#endif
+#ifndef KEYPAD_AMP_CACHE_INVALIDATE
+#define KEYPAD_AMP_CACHE_INVALIDATE(ADDR, SIZE)
+#endif
+
+/**
+ * @brief Initializes the producer side and the shared channel.
+ *
+ * The indexes are reset before the magic is written, so a consumer that sees the magic sees an empty ring.
+ *
+ * @param tx The producer side.
+ * @param channel The shared channel.
+ * @param doorbell Function ringing the doorbell of the consumer core, NULL for a polling consumer.
+ * @param ctx Context pointer passed to the doorbell hook.
+ */
+void keypad_amp_tx_init(keypad_amp_tx_t* tx, keypad_amp_channel_t* channel, keypad_amp_doorbell_t doorbell, void* ctx) {
+    tx->channel = channel;
+    tx->doorbell = doorbell;
+    tx->ctx = ctx;
+    tx->index = 0;
+
+    channel->head = 0;
+    channel->dropped = 0;
+    channel->tail = 0;
+    KEYPAD_AMP_BARRIER();
+    channel->magic = KEYPAD_AMP_MAGIC;
+    KEYPAD_AMP_CACHE_CLEAN(channel, sizeof(*channel));
+}
+
+/**
+ * @brief Writes an event into the channel.
+ *
+ * The slot is written before the head is advanced, so the consumer never reads a slot that is not complete.
+ * The doorbell is rung when the consumer had read every event before this one: it may be waiting for it.
+ * While the ring holds older events the consumer is still draining and will find the new one without it.
+ *
+ * @param tx The producer side.
+ * @param event The event.
+ *
+ * @return 0 on success, -1 if the ring was full and the event was dropped.
+ */
+int keypad_amp_tx_push(keypad_amp_tx_t* tx, uint32_t event) {
+    keypad_amp_channel_t* channel = tx->channel;
+    uint32_t head = channel->head;
+
+    KEYPAD_AMP_CACHE_INVALIDATE(&channel->tail, sizeof(channel->tail));
+    if ((uint32_t)(head - channel->tail) >= KEYPAD_AMP_SLOTS) {
+        channel->dropped++;
+        KEYPAD_AMP_CACHE_CLEAN(channel, KEYPAD_AMP_CACHE_LINE);
+        return -1;
+    }
+
+    channel->events[head % KEYPAD_AMP_SLOTS] = event;
+    KEYPAD_AMP_CACHE_CLEAN(&channel->events[head % KEYPAD_AMP_SLOTS], sizeof(uint32_t));
+    KEYPAD_AMP_BARRIER();
+    channel->head = head + 1;
+    KEYPAD_AMP_CACHE_CLEAN(channel, KEYPAD_AMP_CACHE_LINE);
+    KEYPAD_AMP_BARRIER();
+
+    // Read the tail again after publishing the event, the consumer may have emptied the ring in the meantime
+    KEYPAD_AMP_CACHE_INVALIDATE(&channel->tail, sizeof(channel->tail));
+    if (channel->tail == head && tx->doorbell != NULL) {
+        tx->doorbell(tx->ctx);
+    }
+    return 0;
+}
+
+/**
+ * @brief Checks whether the producer has initialized the channel.
+ *
+ * The cores boot independently, the consumer must not read the channel before this returns 1.
+ */
+int keypad_amp_rx_ready(const keypad_amp_channel_t* channel) {
+    KEYPAD_AMP_CACHE_INVALIDATE(channel, KEYPAD_AMP_CACHE_LINE);
+    return channel->magic == KEYPAD_AMP_MAGIC;
+}
+
+/**
+ * @brief Reads the oldest event from the channel.
+ *
+ * Call it until it returns 0 after every doorbell, the producer only rings again once the ring was emptied.
+ *
+ * @param channel The shared channel.
+ * @param event Receives the event.
+ *
+ * @return 1 if an event was read, 0 if the ring is empty.
+ */
+int keypad_amp_rx_pop(keypad_amp_channel_t* channel, uint32_t* event) {
+    uint32_t tail = channel->tail;
+
+    KEYPAD_AMP_CACHE_INVALIDATE(channel, KEYPAD_AMP_CACHE_LINE);
+    if (channel->head == tail) {
+        return 0;
+    }
+    KEYPAD_AMP_BARRIER();
+
+    KEYPAD_AMP_CACHE_INVALIDATE(&channel->events[tail % KEYPAD_AMP_SLOTS], sizeof(uint32_t));
+    *event = channel->events[tail % KEYPAD_AMP_SLOTS];
+    KEYPAD_AMP_BARRIER();
+    channel->tail = tail + 1;
+    KEYPAD_AMP_CACHE_CLEAN(&channel->tail, sizeof(channel->tail));
+
+    // Make the tail visible before the next head read. Otherwise the producer could still see the old tail when
+    // the ring was just emptied and skip the doorbell while the consumer goes to wait for it.
+    KEYPAD_AMP_BARRIER();
+    return 1;
+}
+
+#ifndef KEYPAD_AMP_HOST
+/**
+ * @brief Keypad callback pushing events into the channel.
+ *
+ * Only the events of the keypad bound to the channel are pushed, the event words do not name their keypad.
+ * KEY_STATE and KEY_LATENCY events are not forwarded, like for the queue.
+ */
+static void keypad_amp_callback(const keypad_t* kp, uint32_t event, void* ctx) {
+    keypad_amp_tx_t* tx = (keypad_amp_tx_t*)ctx;
+
+    if (kp->index == tx->index && KEY_EVENT_BASE_KIND(event) != KEY_STATE
+        && KEY_EVENT_BASE_KIND(event) != KEY_LATENCY) {
+        keypad_amp_tx_push(tx, event);
+    }
+}
+
+/**
+ * @brief Forwards the events of a keypad to the consumer core.
+ *
+ * @param tx The producer side, initialized with keypad_amp_tx_init.
+ * @param index Index of the keypad in KEYPAD_LAYOUT.
+ *
+ * @return 0 on success, -1 if the index is out of range or no keypad callback slot was free.
+ */
+int keypad_amp_tx_attach(keypad_amp_tx_t* tx, uint8_t index) {
+    if (index >= keypad_count()) {
+        return -1;
+    }
+    tx->index = index;
+    return (keypad_register_callback(keypad_amp_callback, tx) == pdPASS) ? 0 : -1;
+}
+#endif
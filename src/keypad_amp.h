@@ -0,0 +1,96 @@
+#ifndef MATRIX_KEYPAD_AMP_H
+#define MATRIX_KEYPAD_AMP_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Shared-memory event channel between two cores running separate operating system instances (AMP).
+ *
+ * The core that runs the keypad task is the producer, the core that runs the application is the consumer.
+ * They share a keypad_amp_channel_t placed in RAM both of them can reach, typically with KEYPAD_AMP_CHANNEL
+ * in a section the linker scripts of both images map to the same address. The channel is a single-producer
+ * single-consumer ring of event words. The producer and consumer indexes live on separate cache lines, so
+ * the cores never write the same line.
+ *
+ * The producer rings a doorbell (mailbox interrupt, IPI) only when the ring goes from empty to non-empty.
+ * The consumer drains the ring until it is empty before waiting for the doorbell again, so no event is left
+ * behind and the interrupt rate stays at one per burst.
+ *
+ * The ring itself does not depend on FreeRTOS and builds on the host, for example to exercise it between
+ * two processes sharing an mmap region with an eventfd as doorbell. Define KEYPAD_AMP_HOST to leave out the
+ * glue that attaches the producer to the keypad task.
+ */
+
+// Number of event slots of a channel, a power of two.
+#ifndef KEYPAD_AMP_SLOTS
+#define KEYPAD_AMP_SLOTS 16
+#endif
+
+// Cache line size of the larger core, the producer and consumer indexes are kept on separate lines.
+#ifndef KEYPAD_AMP_CACHE_LINE
+#define KEYPAD_AMP_CACHE_LINE 32
+#endif
+
+// Linker section of the shared RAM, used by KEYPAD_AMP_CHANNEL.
+#ifndef KEYPAD_AMP_SECTION
+#define KEYPAD_AMP_SECTION ".keypad_shared"
+#endif
+
+#if (KEYPAD_AMP_SLOTS & (KEYPAD_AMP_SLOTS - 1)) != 0
+#error "KEYPAD_AMP_SLOTS must be a power of two"
+#endif
+
+// Defines a channel in the shared RAM section. Both images must define it at the same address.
+#define KEYPAD_AMP_CHANNEL(NAME) keypad_amp_channel_t NAME __attribute__((section(KEYPAD_AMP_SECTION)))
+
+// type define of structure holding a channel, shared by both cores. Only fixed-size fields, so both images
+// agree on its layout.
+typedef struct {
+    volatile uint32_t magic;   // KEYPAD_AMP_MAGIC once the producer has initialized the channel
+    volatile uint32_t head;    // Number of events written, written by the producer only
+    volatile uint32_t dropped; // Events dropped because the ring was full, written by the producer only
+    uint8_t producer_pad[KEYPAD_AMP_CACHE_LINE - 12];
+    volatile uint32_t tail; // Number of events read, written by the consumer only
+    uint8_t consumer_pad[KEYPAD_AMP_CACHE_LINE - 4];
+    volatile uint32_t events[KEYPAD_AMP_SLOTS]; // Event slots, slot N holds event N % KEYPAD_AMP_SLOTS
+} __attribute__((aligned(KEYPAD_AMP_CACHE_LINE))) keypad_amp_channel_t;
+
+// Value of the magic field of an initialized channel.
+#define KEYPAD_AMP_MAGIC 0x4B504144UL
+
+// Type of the function ringing the doorbell of the consumer core.
+typedef void (*keypad_amp_doorbell_t)(void* ctx);
+
+// type define of structure holding the producer side of a channel, private to the producer core.
+typedef struct {
+    keypad_amp_channel_t* channel;  // The shared channel
+    keypad_amp_doorbell_t doorbell; // Doorbell hook
+    void* ctx;                      // Context pointer passed to the doorbell hook
+    uint8_t index;                  // Index of the keypad forwarded to the channel, see keypad_amp_tx_attach
+} keypad_amp_tx_t;
+
+// Function declaration for initializing the producer side and the shared channel.
+// Call it on the producer core before the consumer core starts reading the channel.
+void keypad_amp_tx_init(keypad_amp_tx_t* tx, keypad_amp_channel_t* channel, keypad_amp_doorbell_t doorbell, void* ctx);
+
+// Function declaration for writing an event into the channel.
+// Rings the doorbell if the ring was empty. Returns 0 on success and -1 if the ring was full.
+int keypad_amp_tx_push(keypad_amp_tx_t* tx, uint32_t event);
+
+// Function declaration for checking on the consumer core whether the producer has initialized the channel.
+int keypad_amp_rx_ready(const keypad_amp_channel_t* channel);
+
+// Function declaration for reading the oldest event from the channel.
+// Returns 1 if an event was read into event, 0 if the ring is empty.
+int keypad_amp_rx_pop(keypad_amp_channel_t* channel, uint32_t* event);
+
+#ifndef KEYPAD_AMP_HOST
+// Function declaration for forwarding the events of a keypad to the consumer core.
+// Registers a keypad callback pushing every queued event kind of the keypad at index into the channel.
+// The event words do not name their keypad, use one channel per keypad. Returns -1 if the index is out of
+// range or no callback slot was free.
+int keypad_amp_tx_attach(keypad_amp_tx_t* tx, uint8_t index);
+#endif
+
+#endif
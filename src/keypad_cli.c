@@ -0,0 +1,183 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <FreeRTOS_CLI.h>
+#include <keypad_cli.h>
+
+// Time the selftest subcommand waits for the keypad task, in ticks.
+#define KEYPAD_CLI_SELFTEST_TIMEOUT KEYPAD_MS_TO_TICKS(100)
+
+// Number of trace entries the trace subcommand prints.
+#define KEYPAD_CLI_TRACE_SIZE 16
+
+// Type of the subcommand handlers.
+// Each call writes one line for the given step and returns pdTRUE while more lines follow.
+typedef BaseType_t (*keypad_cli_handler_t)(char* out, size_t size, const char* command, uint8_t step);
+
+/**
+ * @brief Prints the statistics: the counters first, then one line per histogram bin.
+ * The statistics are copied once on the first step, so all lines describe the same moment.
+ */
+static BaseType_t keypad_cli_stats(char* out, size_t size, const char* command, uint8_t step) {
+    static keypad_stats_t stats;
+    uint32_t low;
+
+    if (step == 0) {
+        keypad_get_stats(&stats);
+        snprintf(out, size, "scans %lu, queue drops %lu, boosts %lu (%lu ticks)\r\n", (unsigned long)stats.scan_count,
+                 (unsigned long)stats.queue_drops, (unsigned long)stats.boost_count, (unsigned long)stats.boost_ticks);
+    } else if (step == 1) {
+        snprintf(out, size, "scan <%u us: %lu\r\n", (unsigned)KEYPAD_SCAN_HISTOGRAM_US,
+                 (unsigned long)stats.scan_histogram[0]);
+    } else {
+        low = (uint32_t)KEYPAD_SCAN_HISTOGRAM_US << (step - 2);
+        if (step == KEYPAD_SCAN_HISTOGRAM_BINS) {
+            snprintf(out, size, "scan >=%lu us: %lu\r\n", (unsigned long)low,
+                     (unsigned long)stats.scan_histogram[step - 1]);
+        } else {
+            snprintf(out, size, "scan %lu-%lu us: %lu\r\n", (unsigned long)low, (unsigned long)(2 * low - 1),
+                     (unsigned long)stats.scan_histogram[step - 1]);
+        }
+    }
+    return (step < KEYPAD_SCAN_HISTOGRAM_BINS) ? pdTRUE : pdFALSE;
+}
+
+/**
+ * @brief Prints the state of one keypad per line.
+ */
+static BaseType_t keypad_cli_state(char* out, size_t size, const char* command, uint8_t step) {
+    keypad_state_t state;
+
+    if (keypad_get_state(step, &state) == pdPASS) {
+        snprintf(out, size, "keypad %u: raw %08lx held %08lx down %08lx\r\n", (unsigned)step,
+                 (unsigned long)state.keys_pressed, (unsigned long)state.keys_held, (unsigned long)state.keys_down);
+    }
+    return (step + 1 < keypad_count()) ? pdTRUE : pdFALSE;
+}
+
+/**
+ * @brief Prints the trace, one event per line. The trace is copied once on the first step.
+ */
+static BaseType_t keypad_cli_trace(char* out, size_t size, const char* command, uint8_t step) {
+    static keypad_trace_t trace[KEYPAD_CLI_TRACE_SIZE];
+    static uint8_t count;
+
+    if (step == 0) {
+        count = keypad_get_trace(trace, KEYPAD_CLI_TRACE_SIZE);
+        if (count == 0) {
+            snprintf(out, size, "no events\r\n");
+            return pdFALSE;
+        }
+    }
+    snprintf(out, size, "%10lu keypad %u event %08lx\r\n", (unsigned long)trace[step].tick, (unsigned)trace[step].index,
+             (unsigned long)trace[step].event);
+    return (step + 1 < count) ? pdTRUE : pdFALSE;
+}
+
+/**
+ * @brief Prints the parameters, or changes the scan period or debounce time when a value is given.
+ */
+static BaseType_t keypad_cli_params(char* out, size_t size, const char* command, uint8_t step) {
+    const char* name;
+    const char* value;
+    BaseType_t name_length, value_length;
+    keypad_params_t params;
+    keypad_state_t state;
+    TickType_t ticks;
+
+    name = FreeRTOS_CLIGetParameter(command, 2, &name_length);
+    value = FreeRTOS_CLIGetParameter(command, 3, &value_length);
+    if (name != NULL && value != NULL) {
+        ticks = KEYPAD_MS_TO_TICKS(strtoul(value, NULL, 10));
+        if (name_length == 6 && strncmp(name, "period", 6) == 0) {
+            keypad_set_timing(ticks, 0);
+        } else if (name_length == 8 && strncmp(name, "debounce", 8) == 0) {
+            keypad_set_timing(keypad_get_scan_period(), ticks);
+        } else {
+            snprintf(out, size, "unknown parameter, use period or debounce\r\n");
+            return pdFALSE;
+        }
+        snprintf(out, size, "applied on the next scan cycle\r\n");
+        return pdFALSE;
+    }
+
+    if (step == 0) {
+        keypad_get_params(&params);
+        snprintf(out, size, "period %lu ms, debounce mode %u, speculative %u, queue %u, priority %u/%u\r\n",
+                 (unsigned long)KEYPAD_TICKS_TO_MS(keypad_get_scan_period()), (unsigned)params.debounce_mode,
+                 (unsigned)params.speculative, (unsigned)params.queue_size, (unsigned)params.priority,
+                 (unsigned)params.priority_max);
+    } else if (keypad_get_state(step - 1, &state) == pdPASS) {
+        snprintf(out, size, "keypad %u: debounce %lu ms, %s\r\n", (unsigned)(step - 1),
+                 (unsigned long)KEYPAD_TICKS_TO_MS(state.debounce_time), state.present ? "attached" : "removed");
+    }
+    return (step < keypad_count()) ? pdTRUE : pdFALSE;
+}
+
+/**
+ * @brief Runs the line self-test on one keypad per line.
+ */
+static BaseType_t keypad_cli_selftest(char* out, size_t size, const char* command, uint8_t step) {
+    uint32_t stuck;
+
+    if (keypad_selftest(step, &stuck, KEYPAD_CLI_SELFTEST_TIMEOUT) != pdPASS) {
+        snprintf(out, size, "keypad %u: no answer from the keypad task\r\n", (unsigned)step);
+    } else if (stuck != 0) {
+        snprintf(out, size, "keypad %u: FAIL, columns stuck low %08lx\r\n", (unsigned)step, (unsigned long)stuck);
+    } else {
+        snprintf(out, size, "keypad %u: pass\r\n", (unsigned)step);
+    }
+    return (step + 1 < keypad_count()) ? pdTRUE : pdFALSE;
+}
+
+/**
+ * @brief FreeRTOS+CLI interpreter of the `keypad` command.
+ *
+ * FreeRTOS+CLI calls the interpreter again as long as it returns pdTRUE, so long outputs are produced
+ * one line per call. The step counter remembers the line to produce next.
+ */
+static BaseType_t keypad_cli_command(char* out, size_t size, const char* command) {
+    static const struct {
+        const char* name;
+        keypad_cli_handler_t handler;
+    } subcommands[] = {
+        {"stats", keypad_cli_stats},   {"state", keypad_cli_state},       {"trace", keypad_cli_trace},
+        {"params", keypad_cli_params}, {"selftest", keypad_cli_selftest},
+    };
+    static uint8_t step = 0;
+    const char* name;
+    BaseType_t length;
+    BaseType_t more;
+    uint8_t i;
+
+    out[0] = '\0';
+    name = FreeRTOS_CLIGetParameter(command, 1, &length);
+    for (i = 0; name != NULL && i < sizeof(subcommands) / sizeof(subcommands[0]); i++) {
+        if (strlen(subcommands[i].name) == (size_t)length && strncmp(name, subcommands[i].name, length) == 0) {
+            more = subcommands[i].handler(out, size, command, step);
+            step = more ? step + 1 : 0;
+            return more;
+        }
+    }
+
+    snprintf(out, size, "usage: keypad stats|state|trace|params [period|debounce ms]|selftest\r\n");
+    step = 0;
+    return pdFALSE;
+}
+
+// Definition of the `keypad` command, it takes a variable number of parameters.
+static const CLI_Command_Definition_t keypad_cli_definition = {
+    "keypad",
+    "\r\nkeypad stats|state|trace|params [period|debounce ms]|selftest:\r\n Keypad diagnostics\r\n",
+    keypad_cli_command,
+    -1,
+};
+
+/**
+ * @brief Registers the `keypad` diagnostics command with FreeRTOS+CLI.
+ *
+ * @return pdPASS if the command was registered.
+ */
+BaseType_t keypad_cli_register(void) {
+    return FreeRTOS_CLIRegisterCommand(&keypad_cli_definition);
+}
@@ -0,0 +1,15 @@
+#ifndef MATRIX_KEYPAD_CLI_H
+#define MATRIX_KEYPAD_CLI_H
+
+#include <keypad.h>
+
+// Function declaration for registering the `keypad` diagnostics command with FreeRTOS+CLI.
+//   keypad stats                        Scan counters, scan time histogram, drop and boost counters
+//   keypad state                        Raw frame, held and accumulated keys of every keypad
+//   keypad trace                        Most recent events, oldest first
+//   keypad params [period|debounce ms]  Current parameters, optionally changes the scan period or debounce time
+//   keypad selftest                     Line self-test of every keypad
+// All reads go through the lock-free snapshot API of keypad.h, so inspecting a running system does not disturb it.
+BaseType_t keypad_cli_register(void);
+
+#endif
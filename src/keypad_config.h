@@ -4,10 +4,40 @@
 #include "gd32f10x.h"
 
 // Configuration for the matrix keypad
-#define KEYPAD_GPIO_STABILIZATION_TIME    (1UL / portTICK_PERIOD_MS)  // Delay for GPIO pin stabilization
-#define KEYPAD_TASK_DELAY_TIME            (5UL / portTICK_PERIOD_MS)  // Delay for keypad tasks
-#define KEYPAD_DEBOUNCE_TIME              (50UL / portTICK_PERIOD_MS) // Time to stabilize key after being pressed
+#define KEYPAD_GPIO_STABILIZATION_US      50                          // Delay for GPIO pin stabilization, in us
+#define KEYPAD_TASK_DELAY_MS              5                           // Delay for keypad tasks, in ms
+#define KEYPAD_DEBOUNCE_MS                50                          // Time to stabilize a pressed key, in ms
 #define KEYPAD_QUEUE_SIZE                 10                          // Size of keypad queue
+#define KEYPAD_DEBOUNCE_MODE              KEYPAD_DEBOUNCE_DEFERRED    // Debounce strategy, see keypad.h
+#define KEYPAD_EAGER_HOLDOFF_MS           20                          // Eager mode hold-off after a press, in ms
+#define KEYPAD_SPECULATIVE_EVENTS         0                           // Emit tentative/confirm/cancel events
+#define KEYPAD_MAX_CALLBACKS              2                           // Number of event callback slots
+#define KEYPAD_TASK_PRIORITY              (tskIDLE_PRIORITY + 1)      // Keypad task priority while idle
+#define KEYPAD_TASK_PRIORITY_BOOST        (tskIDLE_PRIORITY + 3)      // Keypad task priority while debouncing
+#define KEYPAD_TASK_STACK_SIZE            configMINIMAL_STACK_SIZE    // Keypad task stack, callbacks run on it
+#define KEYPAD_TRACE_SIZE                 16                          // Number of recent events kept for diagnostics
+#define KEYPAD_LATENCY_TRACKING           0                           // Track latency of queued events to the consumers
+#define KEYPAD_LATENCY_SLO_MS             50                          // Consumer latency raising KEY_LATENCY, in ms
+#define KEYPAD_EDGE_TIMESTAMPS            0                           // Debounce from column edge timestamps
+#define KEYPAD_EDGE_SETTLE_US             5000                        // Quiet time after the last edge, in us
+#define KEYPAD_EDGE_GUARD_US              20                          // Edges ignored after driving the rows, in us
+#define KEYPAD_EDGE_RING_SIZE             8                           // Edge timestamps buffered per column line
+#define KEYPAD_EDGE_MAX_COLS              8                           // Largest column count in edge mode
+#define KEYPAD_GPIO_BITBAND               0                           // Access the pins through bit-band aliases
+#define KEYPAD_PRESENCE_DETECT            KEYPAD_PRESENCE_NONE        // Keypad presence detection, see keypad.h
+#define KEYPAD_PRESENCE_PROBE_MS          500                         // Presence probe interval, in ms
+#define KEYPAD_FAULT_INJECTION            0                           // Fault injection hooks, see keypad_fault.h
+#define KEYPAD_SEQUENCE_DETECT            0                           // Publish KEY_SEQUENCE for completed sequences
+#define KEYPAD_BIDIRECTIONAL              0                           // Scan diode pairs in both directions
+#define KEYPAD_CHARLIEPLEX                0                           // Support charlieplexed keypads
+#define KEYPAD_MUX                        0                           // Support multiplexed column sensing
+#define KEYPAD_MUX_SETTLE_US              1                           // Mux settle time after a select change, in us
+#define KEYPAD_MPU                        0                           // Run the keypad task unprivileged (MPU port)
+#define KEYPAD_MPU_PRIVATE_SIZE           2048                        // MPU region of the keypad task data, bytes
+#define KEYPAD_MPU_SHARED_SIZE            1024                        // MPU region read by the consumers, bytes
+#define KEYPAD_WATCHDOG                   0                           // Publish a heartbeat for a watchdog task
+#define KEYPAD_WATCHDOG_STALL_MS          100                         // Heartbeat delay reported as a stall, in ms
+#define KEYPAD_WATCHDOG_RECOVER_MS        0                           // Heartbeat delay restarting the task, 0 never
 
 // Keypad Key Definitions
 #define KEY_NONE                          0
@@ -29,6 +59,12 @@
 #define KEY_POUND                         0x4000
 #define KEY_ENTER                         0x8000
 
+// Keys read in the reverse pass of KEYPAD_BIDIRECTIONAL. Their event words carry KEY_EVENT_UPPER and the bit of
+// the key at the same position, so KEY_REVERSE gives the event word of a reverse key. In keys_held and the event
+// groups they sit rows * cols bits above that key, 16 on this 4x4 keypad, which KEY_REVERSE_HELD gives.
+#define KEY_REVERSE(KEY)                  (KEY_EVENT_UPPER | (KEY))
+#define KEY_REVERSE_HELD(KEY)             ((KEY) << 16)
+
 /**
  * GPIO function mappings for keypad library.
  *
@@ -41,21 +77,161 @@
  *
  * - KEYPAD_GPIO_MODE_OUT_OD: Defines the mode for setting GPIO pins as output with open-drain configuration.
  * - KEYPAD_GPIO_MODE_IPU: Defines the mode for setting GPIO pins as input with pull-up configuration.
+ * - KEYPAD_GPIO_MODE_IPD: Defines the mode for setting GPIO pins as input with pull-down configuration,
+ *   only used by the KEYPAD_PRESENCE_SIGNATURE probe.
+ * - KEYPAD_GPIO_MODE_OUT_PP: Defines the mode for setting GPIO pins as push-pull output, only used for the
+ *   select lines of KEYPAD_MUX.
  * - KEYPAD_GPIO_ENABLE_CLK(PORT): Enables the peripheral clock for the GPIO port associated with the given PORT.
  * - KEYPAD_GPIO_INIT(PORT, PIN, MODE): Initializes a GPIO pin with the specified PORT, PIN, and MODE.
  * - KEYPAD_GPIO_SET(PORT, PIN): Sets a GPIO pin to a logic high state.
  * - KEYPAD_GPIO_RESET(PORT, PIN): Resets a GPIO pin to a logic low state.
  * - KEYPAD_GPIO_GET(PORT, PIN): Reads the current logic level of a GPIO pin.
+ * - KEYPAD_GPIO_FINISH(): Called once by keypad_init after the pins of every keypad were initialized, for GPIO
+ *   drivers that claim the pins in one go. Evaluates to 0 on success, non-zero if the pins are not usable.
  *
  * Users should modify these mappings to match the GPIO functions of their target device.
  */
 #define KEYPAD_GPIO_MODE_OUT_OD           GPIO_MODE_OUT_OD
 #define KEYPAD_GPIO_MODE_IPU              GPIO_MODE_IPU
+#define KEYPAD_GPIO_MODE_IPD              GPIO_MODE_IPD
+#define KEYPAD_GPIO_MODE_OUT_PP           GPIO_MODE_OUT_PP
 #define KEYPAD_GPIO_ENABLE_CLK(PERIPH)    rcu_periph_clock_enable(PERIPH);
 #define KEYPAD_GPIO_INIT(PORT, PIN, MODE) gpio_init(PORT, MODE, GPIO_OSPEED_2MHZ, PIN)
 #define KEYPAD_GPIO_SET(PORT, PIN)        gpio_bit_set(PORT, PIN)
 #define KEYPAD_GPIO_RESET(PORT, PIN)      gpio_bit_reset(PORT, PIN)
 #define KEYPAD_GPIO_GET(PORT, PIN)        gpio_input_bit_get(PORT, PIN)
+#define KEYPAD_GPIO_FINISH()              0
+
+/**
+ * Bit-band access used with KEYPAD_GPIO_BITBAND.
+ *
+ * On Cortex-M3 devices every bit of the peripheral region has a word alias. With KEYPAD_GPIO_BITBAND enabled,
+ * keypad_gpio_init resolves the alias of every row output bit and column input bit once, and the scan then
+ * drives and reads the pins with single stores and loads instead of KEYPAD_GPIO_SET, RESET and GET.
+ * The rows are written through their output control register, so they keep their open-drain mode.
+ *
+ * - KEYPAD_GPIO_OUT_REG(PORT): Address of the output control register of the port (OCTL on the GD32).
+ * - KEYPAD_GPIO_IN_REG(PORT): Address of the input status register of the port (ISTAT on the GD32).
+ * - KEYPAD_BITBAND_ALIAS(REG, BIT): Alias word of a bit of a peripheral register.
+ */
+#define KEYPAD_GPIO_OUT_REG(PORT) ((PORT) + 0x0CUL)
+#define KEYPAD_GPIO_IN_REG(PORT)  ((PORT) + 0x08UL)
+#define KEYPAD_BITBAND_ALIAS(REG, BIT)                                                     \
+    ((volatile uint32_t*)(0x42000000UL + (((REG) - 0x40000000UL) * 32UL) + ((BIT) * 4UL)))
+
+/**
+ * Mode registers used by the charlieplexed keypads of KEYPAD_CHARLIEPLEX.
+ *
+ * Every pin of a charlieplexed keypad switches between driving and sensing twice per scan. keypad_gpio_init
+ * computes the mode bits of every pin once, and each switch is then a single read-modify-write of the mode
+ * register instead of a KEYPAD_GPIO_INIT. Leave KEYPAD_GPIO_MODE_REG undefined to switch through
+ * KEYPAD_GPIO_INIT. The mode registers are shared by all pins of a port, other code must not reconfigure
+ * pins of the same ports while the keypad task runs.
+ *
+ * - KEYPAD_GPIO_MODE_REG(PORT, BIT): Address of the mode register of a pin (CTL0 or CTL1 on the GD32).
+ * - KEYPAD_GPIO_MODE_SHIFT(BIT): Position of the mode bits of a pin in its mode register.
+ * - KEYPAD_GPIO_MODE_MASK: Mode bits of a pin.
+ * - KEYPAD_GPIO_MODE_BITS_OUT_OD, KEYPAD_GPIO_MODE_BITS_IPU: Mode bits of KEYPAD_GPIO_MODE_OUT_OD at 2 MHz and
+ *   of KEYPAD_GPIO_MODE_IPU. The output register selects the pull-up of the input, it is high while sensing.
+ */
+#define KEYPAD_GPIO_MODE_REG(PORT, BIT)   ((volatile uint32_t*)((PORT) + (((BIT) < 8) ? 0x00UL : 0x04UL)))
+#define KEYPAD_GPIO_MODE_SHIFT(BIT)       (((BIT) % 8) * 4)
+#define KEYPAD_GPIO_MODE_MASK             0xFUL
+#define KEYPAD_GPIO_MODE_BITS_OUT_OD      0x6UL
+#define KEYPAD_GPIO_MODE_BITS_IPU         0x8UL
+
+/**
+ * Edge timestamp clock used with KEYPAD_EDGE_TIMESTAMPS.
+ *
+ * With edge timestamps enabled, the rows are held low between scans and every column line needs an
+ * interrupt on both edges (EXTI on the GD32) whose handler calls keypad_edge_isr with the keypad index and
+ * column. The handler reads the clock below, a free-running 32-bit counter. The DWT cycle counter of the
+ * Cortex-M3 is used here, it wraps after about 40 seconds at 108 MHz, which the debounce logic tolerates.
+ *
+ * - KEYPAD_EDGE_CLOCK_INIT(): Starts the counter, called once by keypad_init.
+ * - KEYPAD_EDGE_CLOCK(): Reads the counter.
+ * - KEYPAD_EDGE_CLOCK_HZ: Counter frequency, at least 1 MHz.
+ */
+#define KEYPAD_EDGE_CLOCK_INIT()                        \
+    do {                                                \
+        CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk; \
+        DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;            \
+    } while (0)
+#define KEYPAD_EDGE_CLOCK()  (DWT->CYCCNT)
+#define KEYPAD_EDGE_CLOCK_HZ SystemCoreClock
+
+/**
+ * Busy-wait used for the waits shorter than a tick, such as KEYPAD_GPIO_STABILIZATION_US at usual tick rates.
+ * A vTaskDelay of zero ticks would only yield and return before the lines settled.
+ *
+ * - KEYPAD_DELAY_INIT(): Prepares the busy-wait, called once by keypad_init. The DWT cycle counter is used here.
+ * - KEYPAD_DELAY_US(US): Waits for US microseconds.
+ *
+ * With KEYPAD_MPU the keypad task runs unprivileged and cannot read the DWT, it counts loops instead. keypad_init
+ * sets keypad_delay_loops from the core clock, taking at least 4 cycles per loop so the wait is never shorter.
+ */
+#if KEYPAD_MPU
+#define KEYPAD_DELAY_INIT() (keypad_delay_loops = SystemCoreClock / 4000000UL)
+#define KEYPAD_DELAY_US(US)                                           \
+    do {                                                              \
+        volatile uint32_t keypad_delay_n = (US) * keypad_delay_loops; \
+        while (keypad_delay_n != 0) {                                 \
+            keypad_delay_n--;                                         \
+        }                                                             \
+    } while (0)
+#else
+#define KEYPAD_DELAY_INIT() KEYPAD_EDGE_CLOCK_INIT()
+#define KEYPAD_DELAY_US(US)                                                                 \
+    do {                                                                                    \
+        uint32_t keypad_delay_start = DWT->CYCCNT;                                          \
+        while ((DWT->CYCCNT - keypad_delay_start) < (US) * (SystemCoreClock / 1000000UL)) { \
+        }                                                                                   \
+    } while (0)
+#endif
+
+/**
+ * Clock timing the scans for the scan time histogram of keypad_get_stats, a free-running 32-bit counter.
+ * The DWT cycle counter started by KEYPAD_DELAY_INIT is used here. With KEYPAD_MPU the keypad task cannot read
+ * the DWT, the clock is left undefined and keypad.c times the scans with the tick count.
+ *
+ * - KEYPAD_SCAN_CLOCK(): Reads the counter.
+ * - KEYPAD_SCAN_CLOCK_HZ: Counter frequency.
+ */
+#if !KEYPAD_MPU
+#define KEYPAD_SCAN_CLOCK()  (DWT->CYCCNT)
+#define KEYPAD_SCAN_CLOCK_HZ SystemCoreClock
+#endif
+
+/**
+ * Memory protection used with KEYPAD_MPU, for the FreeRTOS MPU ports.
+ *
+ * The keypad task is created with xTaskCreateRestricted and runs unprivileged. It reaches three MPU regions:
+ * its own data, the data shared with the consumers and the GPIO ports below. keypad.c places its data in two
+ * linker sections of their own, .keypad_mpu_private and .keypad_mpu_shared:
+ *
+ *     .keypad_mpu_private (NOLOAD) : ALIGN(2048) {
+ *         __keypad_mpu_private_start__ = .; *(.keypad_mpu_private) . = ALIGN(2048);
+ *     } > RAM
+ *     .keypad_mpu_shared (NOLOAD) : ALIGN(1024) {
+ *         __keypad_mpu_shared_start__ = .; *(.keypad_mpu_shared) . = ALIGN(1024);
+ *     } > RAM
+ *
+ * An ARMv7-M MPU region is a power of two of 32 bytes or more and starts on a multiple of its size, so each
+ * section starts aligned to its region size, KEYPAD_MPU_PRIVATE_SIZE and KEYPAD_MPU_SHARED_SIZE, and is padded
+ * to it: nothing else may share the region. keypad_init checks the alignment of the start symbols. The sections
+ * must be zeroed at startup like .bss. They are not the .keypad_shared section of KEYPAD_AMP_SECTION, which
+ * sits at the same address in two images and follows the memory map of the other core. The shared section holds
+ * the snapshots, the trace, the requests to the keypad task and the keypads with their kernel object handles.
+ * Unprivileged consumers get it read-only with keypad_mpu_region, then keypad_get_state, keypad_get_stats,
+ * keypad_get_trace and keypad_event_receive need no system call besides the queue ones. Functions changing the
+ * keypad task settings (keypad_set_timing, keypad_selftest, keypad_register_callback, ...) need a privileged
+ * caller. Event callbacks run unprivileged on the keypad task, with access to these regions only.
+ *
+ * - KEYPAD_MPU_GPIO_BASE: Base of the GPIO region, aligned to its size.
+ * - KEYPAD_MPU_GPIO_SIZE: Size of the GPIO region, here AFIO, EXTI and GPIOA to GPIOG.
+ */
+#define KEYPAD_MPU_GPIO_BASE 0x40010000UL
+#define KEYPAD_MPU_GPIO_SIZE 0x2000UL
 
 /**
  * Structure defining the GPIO configuration for the keypad.
@@ -73,6 +249,58 @@ typedef struct {
     rcu_periph_enum periph; // Peripheral enumeration for the GPIO port
 } keypad_gpio_t;
 
+/**
+ * Structure describing one keypad serviced by the keypad task. Fill it with KEYPAD_LAYOUT_ENTRY.
+ *
+ * - rows, cols: GPIO tables of the keypad rows and columns.
+ * - row_divider: Scan rate class of every row, see KEYPAD_ROW_SCAN_DIVIDER.
+ * - row_count, col_count, divider_count: Number of entries in the tables.
+ * - detect: Presence detect pin used with KEYPAD_PRESENCE_PIN, NULL if the keypad has none.
+ *   Use KEYPAD_LAYOUT_ENTRY_DETECT to set it.
+ * - charlieplex: Whether the keypad is charlieplexed, see KEYPAD_LAYOUT_ENTRY_CHARLIEPLEX.
+ * - mux: Whether the columns are sensed through a multiplexer, see KEYPAD_LAYOUT_ENTRY_MUX.
+ */
+typedef struct {
+    const keypad_gpio_t* rows;  // GPIO table of the keypad rows
+    const keypad_gpio_t* cols;  // GPIO table of the keypad columns
+    const uint8_t* row_divider; // Scan rate class of every row
+    uint8_t row_count;          // Number of entries in rows
+    uint8_t col_count;          // Number of entries in cols
+    uint8_t divider_count;      // Number of entries in row_divider
+    // Presence detect pin, reads low while the keypad is attached
+    const keypad_gpio_t* detect;
+    uint8_t charlieplex; // Whether rows holds the pins of a charlieplexed keypad
+    uint8_t mux;         // Whether cols holds the select lines and input of a multiplexer
+} keypad_layout_t;
+
+#define KEYPAD_LAYOUT_ENTRY(ROWS, COLS, DIVIDERS) KEYPAD_LAYOUT_ENTRY_DETECT(ROWS, COLS, DIVIDERS, NULL)
+
+#define KEYPAD_LAYOUT_ENTRY_DETECT(ROWS, COLS, DIVIDERS, DETECT)                                                \
+    {(ROWS), (COLS), (DIVIDERS), sizeof(ROWS) / sizeof((ROWS)[0]), sizeof(COLS) / sizeof((COLS)[0]),            \
+     sizeof(DIVIDERS) / sizeof((DIVIDERS)[0]), (DETECT), 0, 0}
+
+/**
+ * Charlieplexed keypad on the N pins of PINS, with KEYPAD_CHARLIEPLEX enabled. The key between pins A and B
+ * conducts from B to A through its diode, so it reads low on pin B while pin A drives. Every pin drives in
+ * its own pass while all other pins sense with their pull-ups, N * (N - 1) keys in total, up to 6 pins.
+ * The keys of the pass of pin A are numbered A * (N - 1) and up, in the order of the sensing pins.
+ * DIVIDERS holds the scan rate class of every pass, one entry per pin.
+ */
+#define KEYPAD_LAYOUT_ENTRY_CHARLIEPLEX(PINS, DIVIDERS)                                                         \
+    {(PINS), (PINS), (DIVIDERS), sizeof(PINS) / sizeof((PINS)[0]), sizeof(PINS) / sizeof((PINS)[0]) - 1,        \
+     sizeof(DIVIDERS) / sizeof((DIVIDERS)[0]), NULL, 1, 0}
+
+/**
+ * Keypad whose columns are sensed through an 8:1 analog multiplexer (74HC4051), with KEYPAD_MUX enabled.
+ * MUX holds four pins: the select lines S0, S1 and S2, driven push-pull, and the input wired to the common
+ * pin of the multiplexer. Column N is wired to channel N, CHANNELS columns in total. The multiplexer only
+ * connects one column to the input at a time, so every column needs an external pull-up.
+ * The channels are read in Gray code order, one select line changes per step.
+ */
+#define KEYPAD_LAYOUT_ENTRY_MUX(ROWS, MUX, CHANNELS, DIVIDERS)                                                  \
+    {(ROWS), (MUX), (DIVIDERS), sizeof(ROWS) / sizeof((ROWS)[0]), (CHANNELS),                                   \
+     sizeof(DIVIDERS) / sizeof((DIVIDERS)[0]), NULL, 0, 1}
+
 /**
  * This section defines the GPIO configuration for the keypad, indicating how it is connected to the microcontroller.
  * Users should edit these configurations based on their specific board's GPIO mapping and naming conventions.
@@ -87,6 +315,14 @@ const keypad_gpio_t KEYPAD_ROW_GPIO[] = {
     {GPIOA, GPIO_PIN_8, RCU_GPIOA}  // Edit these values to match the keypad row GPIO connections on your board
 };
 
+/**
+ * Scan rate class of every row, one entry per KEYPAD_ROW_GPIO entry.
+ * A row is sampled on every Nth scan cycle, 1 samples it on every cycle. Give the rows holding critical keys
+ * (stop, cancel) a divider of 1 and lower KEYPAD_TASK_DELAY_MS, the other rows then only pay for the fast rate
+ * on every Nth cycle. The debounce time is stretched if needed so that it spans two samples of the slowest row.
+ */
+const uint8_t KEYPAD_ROW_SCAN_DIVIDER[] = {1, 1, 1, 1};
+
 const keypad_gpio_t KEYPAD_COL_GPIO[] = {
     {GPIOA, GPIO_PIN_9, RCU_GPIOA},  // Edit these values to match the keypad column GPIO connections on your board
     {GPIOA, GPIO_PIN_10, RCU_GPIOA}, // Edit these values to match the keypad column GPIO connections on your board
@@ -94,4 +330,16 @@ const keypad_gpio_t KEYPAD_COL_GPIO[] = {
     {GPIOA, GPIO_PIN_12, RCU_GPIOA}  // Edit these values to match the keypad column GPIO connections on your board
 };
 
+/**
+ * Keypads serviced by the keypad task, one KEYPAD_LAYOUT_ENTRY per keypad.
+ * The first entry is the keypad behind keypad_queue and keypad_event_group, keypad_get reaches all of them.
+ *
+ * All keypads are scanned by the single keypad task on a combined schedule: row N of every keypad is driven
+ * at the same time and they share one stabilization delay. Scan time grows with the largest row count
+ * rather than with the number of keypads. The keypads must therefore not share any row or column line.
+ */
+const keypad_layout_t KEYPAD_LAYOUT[] = {
+    KEYPAD_LAYOUT_ENTRY(KEYPAD_ROW_GPIO, KEYPAD_COL_GPIO, KEYPAD_ROW_SCAN_DIVIDER),
+};
+
 #endif
@@ -0,0 +1,193 @@
+#include <keypad_fault.h>
+
+// Profile in use, all rates 0 until keypad_fault_set is called.
+static keypad_fault_profile_t keypad_fault_profile;
+static keypad_fault_stats_t keypad_fault_stats;
+static uint32_t keypad_fault_state = 1; // State of the fault generator, never 0
+
+// Delayed timer resets, issued by keypad_fault_timer_poll once their tick has come.
+static struct {
+    TimerHandle_t timer; // Timer to reset, NULL if the slot is free
+    TickType_t tick;     // Tick count at which the reset was asked for
+} keypad_fault_timers[KEYPAD_FAULT_TIMER_SLOTS];
+
+/**
+ * @brief Returns the next number of the fault generator, a xorshift32 cheap enough to run on every column sample.
+ */
+static uint32_t keypad_fault_next(void) {
+    keypad_fault_state ^= keypad_fault_state << 13;
+    keypad_fault_state ^= keypad_fault_state >> 17;
+    keypad_fault_state ^= keypad_fault_state << 5;
+    return keypad_fault_state;
+}
+
+/**
+ * @brief Returns whether a fault with the given rate happens now.
+ *
+ * @param rate Rate of the fault, per 65536 draws.
+ */
+static uint8_t keypad_fault_draw(uint16_t rate) {
+    return rate != 0 && (keypad_fault_next() & 0xFFFFU) < rate;
+}
+
+/**
+ * @brief Sets the fault profile.
+ *
+ * Delayed timer resets of the previous profile are dropped, the statistics start again from 0.
+ *
+ * @param profile The fault profile, NULL injects no faults.
+ */
+void keypad_fault_set(const keypad_fault_profile_t* profile) {
+    uint8_t i;
+
+    taskENTER_CRITICAL();
+    if (profile != NULL) {
+        keypad_fault_profile = *profile;
+    } else {
+        keypad_fault_profile = (keypad_fault_profile_t){0};
+    }
+    if (keypad_fault_profile.seed != 0) {
+        keypad_fault_state = keypad_fault_profile.seed;
+    }
+    keypad_fault_stats = (keypad_fault_stats_t){0};
+    for (i = 0; i < KEYPAD_FAULT_TIMER_SLOTS; i++) {
+        keypad_fault_timers[i].timer = NULL;
+    }
+    taskEXIT_CRITICAL();
+}
+
+/**
+ * @brief Reads the number of faults injected since the profile was set.
+ */
+void keypad_fault_get_stats(keypad_fault_stats_t* stats) {
+    taskENTER_CRITICAL();
+    *stats = keypad_fault_stats;
+    taskEXIT_CRITICAL();
+}
+
+/**
+ * @brief Applies the stuck columns and glitches to a column sample.
+ *
+ * @param index Index of the keypad.
+ * @param col The column.
+ * @param level Level read from the column, 0 for low.
+ *
+ * @return The level seen by the keypad task.
+ */
+uint32_t keypad_fault_read(uint8_t index, uint8_t col, uint32_t level) {
+    if (index == keypad_fault_profile.index) {
+        if (keypad_fault_profile.stuck_low & (1UL << col)) {
+            return 0;
+        }
+        if (keypad_fault_profile.stuck_high & (1UL << col)) {
+            return 1;
+        }
+    }
+    if (keypad_fault_draw(keypad_fault_profile.glitch_rate)) {
+        keypad_fault_stats.glitches++;
+        return level == 0;
+    }
+    return level;
+}
+
+/**
+ * @brief Resets a timer, dropping or delaying the command according to the profile.
+ *
+ * A delayed reset leaves the timer in its previous state until keypad_fault_timer_poll issues it.
+ * When every delay slot is in use the reset is issued right away. Dropped and delayed resets pass, like
+ * a command lost or held up after it was queued.
+ *
+ * @param timer The timer.
+ * @param wait Longest wait for room in the timer command queue, in ticks.
+ *
+ * @return The result of xTimerReset, pdPASS for a dropped or delayed reset.
+ */
+BaseType_t keypad_fault_timer_reset(TimerHandle_t timer, TickType_t wait) {
+    uint8_t i;
+
+    if (keypad_fault_draw(keypad_fault_profile.timer_drop_rate)) {
+        keypad_fault_stats.timer_drops++;
+        return pdPASS;
+    }
+    if (keypad_fault_draw(keypad_fault_profile.timer_delay_rate)) {
+        for (i = 0; i < KEYPAD_FAULT_TIMER_SLOTS; i++) {
+            if (keypad_fault_timers[i].timer == NULL || keypad_fault_timers[i].timer == timer) {
+                keypad_fault_timers[i].timer = timer;
+                keypad_fault_timers[i].tick = xTaskGetTickCount();
+                keypad_fault_stats.timer_delays++;
+                return pdPASS;
+            }
+        }
+    }
+    return xTimerReset(timer, wait);
+}
+
+/**
+ * @brief Stops a timer.
+ *
+ * Commands reach the timer service task in order, so a delayed reset of the timer is dropped first.
+ *
+ * @param timer The timer.
+ * @param wait Longest wait for room in the timer command queue, in ticks.
+ *
+ * @return The result of xTimerStop.
+ */
+BaseType_t keypad_fault_timer_stop(TimerHandle_t timer, TickType_t wait) {
+    uint8_t i;
+
+    for (i = 0; i < KEYPAD_FAULT_TIMER_SLOTS; i++) {
+        if (keypad_fault_timers[i].timer == timer) {
+            keypad_fault_timers[i].timer = NULL;
+        }
+    }
+    return xTimerStop(timer, wait);
+}
+
+/**
+ * @brief Issues the delayed timer resets whose tick has come. Called once per keypad task cycle.
+ *
+ * The resets do not wait for room in the timer command queue, one that does not fit is lost like a dropped one.
+ */
+void keypad_fault_timer_poll(void) {
+    TickType_t now = xTaskGetTickCount();
+    uint8_t i;
+
+    for (i = 0; i < KEYPAD_FAULT_TIMER_SLOTS; i++) {
+        if (keypad_fault_timers[i].timer != NULL &&
+            (TickType_t)(now - keypad_fault_timers[i].tick) >= keypad_fault_profile.timer_delay) {
+            xTimerReset(keypad_fault_timers[i].timer, 0);
+            keypad_fault_timers[i].timer = NULL;
+        }
+    }
+}
+
+/**
+ * @brief Sends an event to a queue, failing as if the queue was full according to the profile.
+ *
+ * @return The result of xQueueSend, or errQUEUE_FULL for an injected fault.
+ */
+BaseType_t keypad_fault_queue_send(QueueHandle_t queue, const void* item) {
+    if (keypad_fault_draw(keypad_fault_profile.queue_full_rate)) {
+        keypad_fault_stats.queue_fulls++;
+        return errQUEUE_FULL;
+    }
+    return xQueueSend(queue, item, 0);
+}
+
+/**
+ * @brief Stretches the delay of a keypad task cycle by up to sched_delay_max ticks.
+ *
+ * @param delay Delay until the next scan, in ticks.
+ */
+TickType_t keypad_fault_delay(TickType_t delay) {
+    TickType_t extra;
+
+    if (keypad_fault_profile.sched_delay_max == 0) {
+        return delay;
+    }
+    extra = keypad_fault_next() % (keypad_fault_profile.sched_delay_max + 1);
+    if (extra != 0) {
+        keypad_fault_stats.sched_delays++;
+    }
+    return delay + extra;
+}
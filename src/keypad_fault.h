@@ -0,0 +1,65 @@
+#ifndef MATRIX_KEYPAD_FAULT_H
+#define MATRIX_KEYPAD_FAULT_H
+
+#include <keypad.h>
+
+/**
+ * Fault injection between the keypad task and the GPIO and kernel objects it uses, enabled with
+ * KEYPAD_FAULT_INJECTION in keypad_config.h. Meant for the Linux port and other test builds, to see how the
+ * scan and debounce modes degrade: a test harness sets a fault profile, drives key presses and compares the
+ * published events (keypad_get_trace, the queue, the latency statistics) with the expected ones.
+ *
+ * Faults of a profile:
+ * - Glitches: single column samples read inverted.
+ * - Stuck lines: columns of one keypad reading low or high whatever the keys do. In the reverse pass of
+ *   KEYPAD_BIDIRECTIONAL the rows sense, they are numbered after the columns.
+ * - Timer faults: debounce and hold-off timer resets dropped, or delayed as if the timer service task lagged.
+ * - Queue faults: events not queued as if the queue was full, counted in queue_drops like real ones.
+ * - Scheduling faults: the keypad task wakes up late.
+ *
+ * Random faults are drawn from a small generator seeded by the profile, so a failing run can be replayed.
+ * Rates are given per 65536 operations. Add keypad_fault.c to the build together with KEYPAD_FAULT_INJECTION,
+ * production builds leave both out.
+ */
+
+// Number of timer resets that can be delayed at the same time.
+#define KEYPAD_FAULT_TIMER_SLOTS 4
+
+// type define of structure holding a fault profile, see keypad_fault_set.
+typedef struct {
+    uint32_t seed;              // Seed of the fault generator, 0 keeps the current sequence
+    uint8_t index;              // Index of the keypad with the stuck columns
+    uint32_t stuck_low;         // Bitmask of the columns reading low
+    uint32_t stuck_high;        // Bitmask of the columns reading high
+    uint16_t glitch_rate;       // Column samples read inverted, per 65536 samples
+    uint16_t timer_drop_rate;   // Timer resets dropped, per 65536 resets
+    uint16_t timer_delay_rate;  // Timer resets delayed by timer_delay, per 65536 resets
+    TickType_t timer_delay;     // Delay of a delayed timer reset, in ticks
+    uint16_t queue_full_rate;   // Events refused by the queue, per 65536 events
+    TickType_t sched_delay_max; // Largest extra delay of a keypad task cycle, in ticks
+} keypad_fault_profile_t;
+
+// type define of structure holding the number of faults injected since the profile was set.
+typedef struct {
+    uint32_t glitches;     // Column samples inverted
+    uint32_t timer_drops;  // Timer resets dropped
+    uint32_t timer_delays; // Timer resets delayed
+    uint32_t queue_fulls;  // Events refused by the queue
+    uint32_t sched_delays; // Keypad task cycles delayed
+} keypad_fault_stats_t;
+
+// Function declaration for setting the fault profile, NULL injects no faults. Resets the statistics.
+void keypad_fault_set(const keypad_fault_profile_t* profile);
+
+// Function declaration for reading the number of faults injected since the profile was set.
+void keypad_fault_get_stats(keypad_fault_stats_t* stats);
+
+// Hooks called by the keypad task in place of the GPIO and kernel object accesses.
+uint32_t keypad_fault_read(uint8_t index, uint8_t col, uint32_t level);
+BaseType_t keypad_fault_timer_reset(TimerHandle_t timer, TickType_t wait);
+BaseType_t keypad_fault_timer_stop(TimerHandle_t timer, TickType_t wait);
+void keypad_fault_timer_poll(void);
+BaseType_t keypad_fault_queue_send(QueueHandle_t queue, const void* item);
+TickType_t keypad_fault_delay(TickType_t delay);
+
+#endif
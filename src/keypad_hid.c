@@ -0,0 +1,172 @@
+#include <string.h>
+#include <keypad_hid.h>
+
+// Marks a free entry of the rollover slots.
+#define KEYPAD_HID_SLOT_FREE 0xFF
+
+// Range of the keyboard usages that are reported as bits of the modifier byte (LeftControl to RightGUI).
+#define KEYPAD_HID_USAGE_MODIFIER_FIRST 0xE0
+#define KEYPAD_HID_USAGE_MODIFIER_LAST  0xE7
+
+/**
+ * @brief Builds the boot-keyboard report for the current rollover slots.
+ *
+ * Byte 0 holds the modifier bits, byte 1 is reserved and bytes 2 to 7 hold the usages of the held keys
+ * in press order. When more keys are held than the report can carry, all key bytes are set to
+ * ErrorRollOver as required by the HID specification, while the modifiers are still reported.
+ *
+ * @param hid The HID report generator.
+ * @param keys Bitmask of the held keys.
+ * @param overflow Non-zero if more keys are held than there are slots.
+ */
+static void keypad_hid_build(keypad_hid_t* hid, uint32_t keys, uint8_t overflow) {
+    uint8_t i;
+
+    memset(hid->report, 0, sizeof(hid->report));
+
+    // Modifier keys are reported as bits, they never take a slot
+    for (i = 0; i < hid->usage_count; i++) {
+        if ((keys & (1UL << i)) && hid->usages[i] >= KEYPAD_HID_USAGE_MODIFIER_FIRST
+            && hid->usages[i] <= KEYPAD_HID_USAGE_MODIFIER_LAST) {
+            hid->report[0] |= (uint8_t)(1U << (hid->usages[i] - KEYPAD_HID_USAGE_MODIFIER_FIRST));
+        }
+    }
+
+    for (i = 0; i < KEYPAD_HID_ROLLOVER; i++) {
+        if (overflow) {
+            hid->report[2 + i] = KEYPAD_HID_USAGE_ROLLOVER;
+        } else if (hid->slots[i] != KEYPAD_HID_SLOT_FREE) {
+            hid->report[2 + i] = hid->usages[hid->slots[i]];
+        }
+    }
+}
+
+/**
+ * @brief Initializes a HID report generator.
+ *
+ * @param hid The HID report generator to initialize.
+ * @param usages Keyboard usage ID for every key bit, 0 for unmapped keys. Must stay valid.
+ * @param usage_count Number of entries in usages, at most 32.
+ * @param interval Minimum time between two reports, in ticks.
+ */
+void keypad_hid_init(keypad_hid_t* hid, const uint8_t* usages, uint8_t usage_count, TickType_t interval) {
+    hid->usages = usages;
+    hid->usage_count = (usage_count > 32) ? 32 : usage_count;
+    hid->interval = interval;
+    hid->index = 0;
+    memset(hid->slots, KEYPAD_HID_SLOT_FREE, sizeof(hid->slots));
+    memset(hid->report, 0, sizeof(hid->report));
+    memset(hid->sent, 0, sizeof(hid->sent));
+
+    // Allow the first report to go out immediately
+    hid->tick_sent = (TickType_t)(0 - interval);
+}
+
+/**
+ * @brief Updates the rollover slots for a new set of held keys.
+ *
+ * Released keys leave their slot and the remaining keys move up, newly held keys are appended in
+ * bit order. Keeping the press order stable means the host sees only the keys that changed.
+ *
+ * @param hid The HID report generator.
+ * @param keys Bitmask of the held keys.
+ */
+void keypad_hid_update(keypad_hid_t* hid, uint32_t keys) {
+    uint8_t slots[KEYPAD_HID_ROLLOVER];
+    uint32_t keys_slotted = 0;
+    uint8_t overflow = 0;
+    uint8_t count = 0;
+    uint8_t i;
+
+    taskENTER_CRITICAL();
+
+    // Keep the keys that are still held, in their press order
+    for (i = 0; i < KEYPAD_HID_ROLLOVER; i++) {
+        if (hid->slots[i] != KEYPAD_HID_SLOT_FREE && (keys & (1UL << hid->slots[i]))) {
+            keys_slotted |= 1UL << hid->slots[i];
+            slots[count++] = hid->slots[i];
+        }
+    }
+
+    // Append the newly held keys that map to a non-modifier usage
+    for (i = 0; i < hid->usage_count; i++) {
+        if (!(keys & (1UL << i)) || (keys_slotted & (1UL << i)) || hid->usages[i] == 0
+            || hid->usages[i] >= KEYPAD_HID_USAGE_MODIFIER_FIRST) {
+            continue;
+        }
+        if (count < KEYPAD_HID_ROLLOVER) {
+            slots[count++] = i;
+        } else {
+            overflow = 1;
+        }
+    }
+
+    for (i = count; i < KEYPAD_HID_ROLLOVER; i++) {
+        slots[i] = KEYPAD_HID_SLOT_FREE;
+    }
+    memcpy(hid->slots, slots, sizeof(hid->slots));
+
+    keypad_hid_build(hid, keys, overflow);
+
+    taskEXIT_CRITICAL();
+}
+
+/**
+ * @brief Returns the next report to send, if any.
+ *
+ * A report is produced only when it differs from the last one handed to the transport and at least
+ * one interval has passed since then. Changes that happen within one interval are coalesced into a
+ * single report carrying the latest state.
+ *
+ * @param hid The HID report generator.
+ * @param now Current tick count.
+ * @param report Buffer receiving the report.
+ *
+ * @return pdTRUE if a report was copied to the buffer, pdFALSE otherwise.
+ */
+BaseType_t keypad_hid_poll(keypad_hid_t* hid, TickType_t now, uint8_t report[KEYPAD_HID_REPORT_SIZE]) {
+    BaseType_t result = pdFALSE;
+
+    taskENTER_CRITICAL();
+    if ((TickType_t)(now - hid->tick_sent) >= hid->interval && memcmp(hid->report, hid->sent, sizeof(hid->sent))) {
+        memcpy(hid->sent, hid->report, sizeof(hid->sent));
+        memcpy(report, hid->report, KEYPAD_HID_REPORT_SIZE);
+        hid->tick_sent = now;
+        result = pdTRUE;
+    }
+    taskEXIT_CRITICAL();
+
+    return result;
+}
+
+/**
+ * @brief Keypad callback feeding held state changes into a HID report generator.
+ *
+ * The held keys are taken from the keypad, the event word only has room for the keys in KEY_EVENT_BITMASK.
+ * The key bits of every keypad start at 0, so the events of the other keypads are ignored.
+ */
+static void keypad_hid_callback(const keypad_t* kp, uint32_t event, void* ctx) {
+    keypad_hid_t* hid = (keypad_hid_t*)ctx;
+
+    if (kp->index == hid->index && KEY_EVENT_KIND(event) == KEY_STATE) {
+        keypad_hid_update(hid, kp->keys_held);
+    }
+}
+
+/**
+ * @brief Feeds a HID report generator from the keypad task.
+ *
+ * Each generator follows a single keypad, attach one generator per keypad for a report per keypad.
+ *
+ * @param hid The HID report generator, initialized with keypad_hid_init.
+ * @param index Index of the keypad in KEYPAD_LAYOUT.
+ *
+ * @return pdPASS if the callback was registered, pdFAIL if the index is out of range or no callback slot was free.
+ */
+BaseType_t keypad_hid_attach(keypad_hid_t* hid, uint8_t index) {
+    if (index >= keypad_count()) {
+        return pdFAIL;
+    }
+    hid->index = index;
+    return keypad_register_callback(keypad_hid_callback, hid);
+}
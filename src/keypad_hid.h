@@ -0,0 +1,45 @@
+#ifndef MATRIX_KEYPAD_HID_H
+#define MATRIX_KEYPAD_HID_H
+
+#include <keypad.h>
+
+// Size of a USB HID boot-keyboard input report: modifiers, reserved byte and six key usages.
+#define KEYPAD_HID_REPORT_SIZE 8
+
+// Number of key usages a boot-keyboard report can carry at once (6-key rollover).
+#define KEYPAD_HID_ROLLOVER 6
+
+// Usage reported in every key slot when more than KEYPAD_HID_ROLLOVER keys are held (ErrorRollOver).
+#define KEYPAD_HID_USAGE_ROLLOVER 0x01
+
+// type define of structure holding the state of a HID report generator.
+typedef struct {
+    const uint8_t* usages;                  // HID usage ID for every key bit, 0 leaves the key unmapped
+    uint8_t usage_count;                    // Number of entries in usages
+    TickType_t interval;                    // Minimum time between two reports (endpoint polling interval)
+    uint8_t index;                          // Index of the keypad feeding the generator, see keypad_hid_attach
+    uint8_t slots[KEYPAD_HID_ROLLOVER];     // Held key bits in press order, 0xFF marks a free slot
+    uint8_t report[KEYPAD_HID_REPORT_SIZE]; // Report matching the current keys
+    uint8_t sent[KEYPAD_HID_REPORT_SIZE];   // Last report handed to the transport
+    TickType_t tick_sent;                   // Tick count of the last report handed to the transport
+} keypad_hid_t;
+
+// Function declaration for initializing a HID report generator.
+// usages maps every key bit to a keyboard usage ID (0x04-0xE7), usages 0xE0-0xE7 are reported as modifiers.
+// interval is the minimum time between reports, normally the bInterval of the interrupt endpoint.
+void keypad_hid_init(keypad_hid_t* hid, const uint8_t* usages, uint8_t usage_count, TickType_t interval);
+
+// Function declaration for feeding the generator from the keypad task.
+// Registers a keypad callback that passes the KEY_STATE events of the keypad at index to keypad_hid_update.
+// Returns pdFAIL if the index is out of range or no callback slot was free.
+BaseType_t keypad_hid_attach(keypad_hid_t* hid, uint8_t index);
+
+// Function declaration for updating the set of held keys.
+void keypad_hid_update(keypad_hid_t* hid, uint32_t keys);
+
+// Function declaration for fetching the next report to send.
+// Copies the report and returns pdTRUE when it differs from the last one sent and the interval has passed,
+// otherwise returns pdFALSE. Call it whenever the transport can accept a report.
+BaseType_t keypad_hid_poll(keypad_hid_t* hid, TickType_t now, uint8_t report[KEYPAD_HID_REPORT_SIZE]);
+
+#endif
@@ -0,0 +1,299 @@
+#include <string.h>
+#include <keypad_link.h>
+
+#ifndef KEYPAD_LINK_HOST
+#include <keypad.h>
+
+// The keypad task pushes events while the serial task flushes them.
+#define KEYPAD_LINK_LOCK()   taskENTER_CRITICAL()
+#define KEYPAD_LINK_UNLOCK() taskEXIT_CRITICAL()
+#elif !defined(KEYPAD_LINK_LOCK)
+// Host builds have no keypad task, define both to guard a transmitter shared between threads.
+#define KEYPAD_LINK_LOCK()
+#define KEYPAD_LINK_UNLOCK()
+#endif
+
+/**
+ * @brief Computes the CRC-16/CCITT-FALSE of a buffer.
+ *
+ * Bitwise implementation, a frame is at most a few dozen bytes so a lookup table is not worth its flash.
+ */
+static uint16_t keypad_link_crc16(const uint8_t* data, size_t length) {
+    uint16_t crc = 0xFFFF;
+    uint8_t bit;
+
+    while (length--) {
+        crc ^= (uint16_t)(*data++) << 8;
+        for (bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+/**
+ * @brief COBS encodes a buffer and appends the 0x00 frame delimiter.
+ *
+ * @return Length of the encoded frame, delimiter included.
+ */
+static size_t keypad_link_cobs_encode(const uint8_t* data, size_t length, uint8_t* out) {
+    size_t code_index = 0;
+    size_t out_index = 1;
+    uint8_t code = 1;
+    size_t i;
+
+    for (i = 0; i < length; i++) {
+        if (data[i] != 0) {
+            out[out_index++] = data[i];
+            code++;
+        }
+        // Close the block on a zero byte or when it reached the maximum block length
+        if (data[i] == 0 || code == 0xFF) {
+            out[code_index] = code;
+            code_index = out_index++;
+            code = 1;
+        }
+    }
+    out[code_index] = code;
+    out[out_index++] = 0x00;
+
+    return out_index;
+}
+
+/**
+ * @brief Decodes a COBS block sequence, without the delimiter.
+ *
+ * @return Length of the decoded data, or 0 if the input is malformed.
+ */
+static size_t keypad_link_cobs_decode(const uint8_t* data, size_t length, uint8_t* out, size_t out_size) {
+    size_t in_index = 0;
+    size_t out_index = 0;
+    uint8_t code;
+    uint8_t i;
+
+    while (in_index < length) {
+        code = data[in_index++];
+        if (code == 0 || in_index + code - 1 > length) {
+            return 0;
+        }
+        for (i = 1; i < code; i++) {
+            if (out_index >= out_size) {
+                return 0;
+            }
+            out[out_index++] = data[in_index++];
+        }
+        // A block shorter than the maximum stands for a zero byte, except at the very end
+        if (code != 0xFF && in_index < length) {
+            if (out_index >= out_size) {
+                return 0;
+            }
+            out[out_index++] = 0;
+        }
+    }
+
+    return out_index;
+}
+
+/**
+ * @brief Initializes a transmitter.
+ *
+ * @param tx The transmitter to initialize.
+ * @param keypad Index of the keypad in KEYPAD_LAYOUT whose events the frames carry.
+ * @param send Transport hook receiving every encoded frame.
+ * @param ctx Context pointer passed to the transport hook.
+ */
+void keypad_link_tx_init(keypad_link_tx_t* tx, uint8_t keypad, keypad_link_send_t send, void* ctx) {
+    memset(tx, 0, sizeof(*tx));
+    tx->keypad = keypad;
+    tx->send = send;
+    tx->ctx = ctx;
+}
+
+/**
+ * @brief Adds an event to the next frame.
+ *
+ * The event only waits in the batch, the serial task sends it with its next flush. Sending from here would
+ * call the transport from the keypad task as well, and could reuse a frame buffer still being transferred.
+ * When the serial task falls behind and the batch is full, the event is dropped and counted.
+ *
+ * @return 0 on success, -1 if the event was dropped.
+ */
+int keypad_link_tx_push(keypad_link_tx_t* tx, uint32_t event) {
+    int result = -1;
+
+    KEYPAD_LINK_LOCK();
+    if (tx->count < KEYPAD_LINK_MAX_BATCH) {
+        tx->events[tx->count++] = event;
+        result = 0;
+    } else {
+        tx->dropped++;
+    }
+    KEYPAD_LINK_UNLOCK();
+
+    return result;
+}
+
+/**
+ * @brief Returns the number of events waiting for the next frame.
+ *
+ * Lets the serial task skip waking up the transport when there is nothing to send.
+ */
+uint8_t keypad_link_tx_pending(const keypad_link_tx_t* tx) {
+    return tx->count;
+}
+
+/**
+ * @brief Encodes the waiting events into one frame and hands it to the transport.
+ *
+ * The frame is built in one contiguous buffer so the transport can send it with a single DMA transfer.
+ * Two frame buffers are used alternately, a frame stays valid until the flush after the next one. That only
+ * holds while a single task flushes, the serial task.
+ *
+ * @return Length of the frame handed to the transport, 0 if no event was waiting.
+ */
+size_t keypad_link_tx_flush(keypad_link_tx_t* tx) {
+    uint8_t payload[KEYPAD_LINK_PAYLOAD_SIZE];
+    size_t length = 0;
+    uint8_t* frame;
+    uint16_t crc;
+    uint8_t i;
+
+    // Take the waiting events, the keypad task can keep pushing while the frame is encoded
+    KEYPAD_LINK_LOCK();
+    if (tx->count == 0) {
+        KEYPAD_LINK_UNLOCK();
+        return 0;
+    }
+    payload[length++] = tx->sequence++;
+    payload[length++] = tx->keypad;
+    payload[length++] = tx->count;
+    for (i = 0; i < tx->count; i++) {
+        payload[length++] = (uint8_t)(tx->events[i]);
+        payload[length++] = (uint8_t)(tx->events[i] >> 8);
+        payload[length++] = (uint8_t)(tx->events[i] >> 16);
+        payload[length++] = (uint8_t)(tx->events[i] >> 24);
+    }
+    tx->count = 0;
+    frame = tx->frame[tx->frame_index];
+    tx->frame_index ^= 1;
+    KEYPAD_LINK_UNLOCK();
+
+    crc = keypad_link_crc16(payload, length);
+    payload[length++] = (uint8_t)(crc);
+    payload[length++] = (uint8_t)(crc >> 8);
+
+    length = keypad_link_cobs_encode(payload, length, frame);
+    if (tx->send != NULL) {
+        tx->send(frame, length, tx->ctx);
+    }
+
+    return length;
+}
+
+/**
+ * @brief Initializes a receiver.
+ *
+ * @param rx The receiver to initialize.
+ * @param callback Event hook receiving every decoded event.
+ * @param ctx Context pointer passed to the event hook.
+ */
+void keypad_link_rx_init(keypad_link_rx_t* rx, keypad_link_event_t callback, void* ctx) {
+    memset(rx, 0, sizeof(*rx));
+    rx->callback = callback;
+    rx->ctx = ctx;
+}
+
+/**
+ * @brief Validates a complete encoded frame and delivers its events.
+ */
+static void keypad_link_rx_frame(keypad_link_rx_t* rx) {
+    uint8_t payload[KEYPAD_LINK_PAYLOAD_SIZE];
+    size_t length;
+    uint32_t event;
+    const uint8_t* p;
+    uint8_t count;
+
+    length = keypad_link_cobs_decode(rx->buffer, rx->length, payload, sizeof(payload));
+    count = (length >= 5) ? payload[2] : 0;
+    if (length < 5 || count > KEYPAD_LINK_MAX_BATCH || length != (size_t)(3 + (4 * count) + 2)
+        || keypad_link_crc16(payload, length - 2) != (uint16_t)(payload[length - 2] | (payload[length - 1] << 8))) {
+        rx->errors++;
+        return;
+    }
+
+    // Frames skipped by the sequence number were lost on the line
+    if (rx->synced) {
+        rx->lost += (uint8_t)(payload[0] - rx->sequence);
+    }
+    rx->sequence = (uint8_t)(payload[0] + 1);
+    rx->synced = 1;
+    rx->frames++;
+
+    for (p = &payload[3]; count--; p += 4) {
+        event = (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+        if (rx->callback != NULL) {
+            rx->callback(payload[1], event, rx->ctx);
+        }
+    }
+}
+
+/**
+ * @brief Feeds received bytes to a receiver.
+ *
+ * Bytes are collected up to the next 0x00 delimiter and the collected frame is then decoded.
+ * Frames that overflow the buffer are discarded up to the next delimiter.
+ *
+ * @param rx The receiver.
+ * @param data Received bytes.
+ * @param length Number of received bytes.
+ */
+void keypad_link_rx_feed(keypad_link_rx_t* rx, const uint8_t* data, size_t length) {
+    size_t i;
+
+    for (i = 0; i < length; i++) {
+        if (data[i] == 0x00) {
+            if (rx->length > 0 && rx->length <= sizeof(rx->buffer)) {
+                keypad_link_rx_frame(rx);
+            } else if (rx->length > sizeof(rx->buffer)) {
+                rx->errors++;
+            }
+            rx->length = 0;
+        } else if (rx->length < sizeof(rx->buffer)) {
+            rx->buffer[rx->length++] = data[i];
+        } else {
+            // Too long for a valid frame, count it once the delimiter shows up
+            rx->length = sizeof(rx->buffer) + 1;
+        }
+    }
+}
+
+#ifndef KEYPAD_LINK_HOST
+/**
+ * @brief Keypad callback pushing events into a transmitter.
+ *
+ * Only the events of the keypad of the transmitter are pushed, its frames name a single keypad.
+ * KEY_STATE and KEY_LATENCY events are not forwarded, like for the queue.
+ */
+static void keypad_link_callback(const keypad_t* kp, uint32_t event, void* ctx) {
+    keypad_link_tx_t* tx = (keypad_link_tx_t*)ctx;
+
+    if (kp->index == tx->keypad && KEY_EVENT_BASE_KIND(event) != KEY_STATE
+        && KEY_EVENT_BASE_KIND(event) != KEY_LATENCY) {
+        keypad_link_tx_push(tx, event);
+    }
+}
+
+/**
+ * @brief Forwards the events of the keypad of a transmitter to it.
+ *
+ * @param tx The transmitter, initialized with keypad_link_tx_init.
+ *
+ * @return 0 on success, -1 if the keypad index is out of range or no keypad callback slot was free.
+ */
+int keypad_link_tx_attach(keypad_link_tx_t* tx) {
+    if (tx->keypad >= keypad_count()) {
+        return -1;
+    }
+    return (keypad_register_callback(keypad_link_callback, tx) == pdPASS) ? 0 : -1;
+}
+#endif
@@ -0,0 +1,99 @@
+#ifndef MATRIX_KEYPAD_LINK_H
+#define MATRIX_KEYPAD_LINK_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Framed serial protocol carrying keypad events to a remote host over UART/RS-485.
+ *
+ * Events are batched into frames. Before encoding, a frame is laid out as:
+ *   [sequence:1][keypad:1][count:1][event:4 little-endian] x count [crc16:2 little-endian]
+ * The keypad byte is the index of the keypad in KEYPAD_LAYOUT that produced the events, every transmitter
+ * carries the events of one keypad. The CRC is CRC-16/CCITT-FALSE over all bytes before it. The frame is COBS
+ * encoded and terminated with a single 0x00 byte, so a receiver can resynchronize on the next delimiter after
+ * any line error.
+ *
+ * The codec does not depend on FreeRTOS and builds on the host. Define KEYPAD_LINK_HOST to leave out the
+ * glue that attaches the transmitter to the keypad task.
+ *
+ * The keypad task only adds events to the batch of a transmitter, the serial task alone encodes and sends
+ * frames with keypad_link_tx_flush. The transport hook is therefore only called from the serial task.
+ */
+
+// Maximum number of events carried by a single frame.
+#ifndef KEYPAD_LINK_MAX_BATCH
+#define KEYPAD_LINK_MAX_BATCH 8
+#endif
+
+// Size of a decoded frame with a full batch: sequence, keypad, count, events and CRC.
+#define KEYPAD_LINK_PAYLOAD_SIZE (3 + (4 * KEYPAD_LINK_MAX_BATCH) + 2)
+
+// Size of an encoded frame with a full batch: COBS overhead and the 0x00 delimiter included.
+#define KEYPAD_LINK_FRAME_SIZE (KEYPAD_LINK_PAYLOAD_SIZE + (KEYPAD_LINK_PAYLOAD_SIZE / 254) + 2)
+
+// Type of the function handing an encoded frame to the transport, typically by starting a DMA transfer.
+// The frame buffer stays untouched until the flush after the next one, so the transfer may outlive the call.
+typedef void (*keypad_link_send_t)(const uint8_t* frame, size_t length, void* ctx);
+
+// Type of the function receiving every event decoded from a valid frame, with the index of its keypad.
+typedef void (*keypad_link_event_t)(uint8_t keypad, uint32_t event, void* ctx);
+
+// type define of structure holding the state of a frame transmitter.
+typedef struct {
+    uint32_t events[KEYPAD_LINK_MAX_BATCH];   // Events waiting for the next frame
+    uint8_t count;                            // Number of events waiting
+    uint8_t sequence;                         // Sequence number of the next frame
+    uint8_t keypad;                           // Index of the keypad whose events the frames carry
+    uint8_t frame[2][KEYPAD_LINK_FRAME_SIZE]; // Encoded frames, used alternately
+    uint8_t frame_index;                      // Frame buffer used by the next flush
+    uint32_t dropped;                         // Events dropped because the batch was full
+    keypad_link_send_t send;                  // Transport hook
+    void* ctx;                                // Context pointer passed to the transport hook
+} keypad_link_tx_t;
+
+// type define of structure holding the state of a frame receiver.
+typedef struct {
+    uint8_t buffer[KEYPAD_LINK_FRAME_SIZE]; // Encoded bytes of the frame being received
+    size_t length;                          // Number of bytes in buffer
+    uint8_t sequence;                       // Sequence number expected next
+    uint8_t synced;                         // Whether a valid frame has been seen yet
+    uint32_t frames;                        // Valid frames received
+    uint32_t errors;                        // Frames rejected for framing, length or CRC errors
+    uint32_t lost;                          // Frames missing according to the sequence numbers
+    keypad_link_event_t callback;           // Event hook
+    void* ctx;                              // Context pointer passed to the event hook
+} keypad_link_rx_t;
+
+// Function declaration for initializing a transmitter carrying the events of the keypad at index keypad.
+void keypad_link_tx_init(keypad_link_tx_t* tx, uint8_t keypad, keypad_link_send_t send, void* ctx);
+
+// Function declaration for adding an event to the next frame.
+// Never sends, the event waits for the next keypad_link_tx_flush. Returns 0 on success and -1 if the batch was
+// full and the event had to be dropped.
+int keypad_link_tx_push(keypad_link_tx_t* tx, uint32_t event);
+
+// Function declaration for reading the number of events waiting for the next frame.
+uint8_t keypad_link_tx_pending(const keypad_link_tx_t* tx);
+
+// Function declaration for encoding the waiting events into a frame and handing it to the transport.
+// Call it from a single task only. Does nothing when no event is waiting. Returns the length of the frame
+// sent, 0 if none was sent.
+size_t keypad_link_tx_flush(keypad_link_tx_t* tx);
+
+// Function declaration for initializing a receiver.
+void keypad_link_rx_init(keypad_link_rx_t* rx, keypad_link_event_t callback, void* ctx);
+
+// Function declaration for feeding received bytes to a receiver.
+// Events of every valid frame are passed to the event hook in order.
+void keypad_link_rx_feed(keypad_link_rx_t* rx, const uint8_t* data, size_t length);
+
+#ifndef KEYPAD_LINK_HOST
+// Function declaration for forwarding keypad events to a transmitter.
+// Registers a keypad callback pushing every queued event kind of the keypad of the transmitter into the batch.
+// The application flushes the batch from its serial task, at the pace the link allows. Returns -1 if the
+// keypad index is out of range or no callback slot was free.
+int keypad_link_tx_attach(keypad_link_tx_t* tx);
+#endif
+
+#endif
@@ -0,0 +1,157 @@
+#ifndef MATRIX_KEYPAD_SEQUENCE_HPP
+#define MATRIX_KEYPAD_SEQUENCE_HPP
+
+#include <cstddef>
+#include <initializer_list>
+#include <keypad.h>
+
+/**
+ * Compile-time builder of the sequence automatons detected with KEYPAD_SEQUENCE_DETECT.
+ *
+ * The sequences, service codes like *#06#, are compiled into an Aho-Corasick automaton whose failure links are
+ * resolved into the transition table, so the keypad task advances it with one table lookup per key event
+ * whatever the number and length of the sequences. The automaton is built by the compiler and stays in flash:
+ *
+ *     static constexpr auto service = keypad::compile_sequences<12, 4>({
+ *         {KEY_STAR, KEY_POUND, KEY_0, KEY_6, KEY_POUND}, // ID 0
+ *         {KEY_STAR, KEY_POUND, KEY_0, KEY_0, KEY_POUND}, // ID 1
+ *     });
+ *     static constexpr keypad_sequence_table_t service_table = service.table();
+ *
+ *     keypad_set_sequences(&service_table);
+ *
+ * The first template argument is the number of states, at least 1 + the number of distinct prefixes of the
+ * sequences, the second one is the number of distinct keys used by the sequences. Sequences are identified by
+ * their position in the list. The automaton starts over after every completed sequence, so a sequence containing
+ * another one could never be completed: it stops the compilation, like too small template arguments do.
+ */
+namespace keypad {
+
+namespace detail {
+
+// Not constexpr, calling them stops the compilation with their name in the diagnostic.
+void sequence_empty();
+void sequence_key_not_single();
+void sequence_too_many_symbols();
+void sequence_too_many_states();
+void sequence_contains_another();
+
+} // namespace detail
+
+/**
+ * Sequence automaton built by compile_sequences.
+ *
+ * Declare it static constexpr so it is placed in flash, and hand its table view to keypad_set_sequences.
+ */
+template <std::size_t States, std::size_t Symbols>
+struct SequenceTable {
+    static_assert(States >= 1 && States <= 0xFFFF, "state numbers are 16 bits");
+    static_assert(Symbols >= 1 && Symbols < KEYPAD_SEQUENCE_NO_SYMBOL, "symbol numbers are 8 bits");
+
+    uint8_t symbol[32];
+    uint16_t next[States * Symbols];
+    uint16_t match[States];
+    uint16_t state_count;
+
+    // Table view of the automaton, valid as long as the automaton.
+    constexpr keypad_sequence_table_t table() const {
+        return {symbol, next, match, static_cast<uint8_t>(Symbols), state_count};
+    }
+};
+
+/**
+ * Builds the automaton detecting the given key sequences.
+ *
+ * @param sequences The sequences, lists of single keys. The ID of a sequence is its position in the list.
+ */
+template <std::size_t States, std::size_t Symbols>
+consteval SequenceTable<States, Symbols> compile_sequences(
+    std::initializer_list<std::initializer_list<uint32_t>> sequences) {
+    SequenceTable<States, Symbols> automaton{};
+    uint16_t child[States * Symbols]{}; // Trie edges, 0 for none since the start state is no child
+    uint16_t fail[States]{};
+    uint16_t queue[States]{};
+    std::size_t symbol_count = 0;
+    std::size_t state_count = 1;
+    std::size_t head = 0;
+    std::size_t tail = 0;
+    uint16_t id = 0;
+
+    for (uint8_t& symbol : automaton.symbol) {
+        symbol = KEYPAD_SEQUENCE_NO_SYMBOL;
+    }
+
+    // Trie of the sequences, the key bits become symbols in the order they first appear
+    for (const auto& sequence : sequences) {
+        std::size_t state = 0;
+
+        id++;
+        if (sequence.size() == 0) {
+            detail::sequence_empty();
+        }
+        for (uint32_t key : sequence) {
+            std::size_t bit = 0;
+
+            if (key == 0 || (key & (key - 1)) != 0) {
+                detail::sequence_key_not_single();
+            }
+            while ((key >> bit) > 1) {
+                bit++;
+            }
+            if (automaton.symbol[bit] == KEYPAD_SEQUENCE_NO_SYMBOL) {
+                if (symbol_count == Symbols) {
+                    detail::sequence_too_many_symbols();
+                }
+                automaton.symbol[bit] = static_cast<uint8_t>(symbol_count++);
+            }
+            uint16_t& edge = child[state * Symbols + automaton.symbol[bit]];
+            if (edge == 0) {
+                if (state_count == States) {
+                    detail::sequence_too_many_states();
+                }
+                edge = static_cast<uint16_t>(state_count++);
+            }
+            state = edge;
+        }
+        if (automaton.match[state] == 0) {
+            automaton.match[state] = id;
+        }
+    }
+
+    // Failure links in breadth-first order, resolved into the transitions. A state inherits the sequence
+    // completed by its failure state, the longest suffix of the keys leading to it that is a prefix as well.
+    for (std::size_t s = 0; s < Symbols; s++) {
+        automaton.next[s] = child[s];
+        if (child[s] != 0) {
+            queue[tail++] = child[s];
+        }
+    }
+    while (head < tail) {
+        std::size_t state = queue[head++];
+
+        if (automaton.match[state] == 0) {
+            automaton.match[state] = automaton.match[fail[state]];
+        }
+        for (std::size_t s = 0; s < Symbols; s++) {
+            uint16_t edge = child[state * Symbols + s];
+
+            if (edge == 0) {
+                automaton.next[state * Symbols + s] = automaton.next[fail[state] * Symbols + s];
+                continue;
+            }
+            if (automaton.match[state] != 0) {
+                detail::sequence_contains_another();
+            }
+            fail[edge] = automaton.next[fail[state] * Symbols + s];
+            automaton.next[state * Symbols + s] = edge;
+            queue[tail++] = edge;
+        }
+    }
+
+    automaton.state_count = static_cast<uint16_t>(state_count);
+    return automaton;
+}
+
+} // namespace keypad
+
+#endif
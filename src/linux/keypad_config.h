@@ -0,0 +1,201 @@
+#ifndef MATRIX_KEYPAD_CONFIG_H
+#define MATRIX_KEYPAD_CONFIG_H
+
+/**
+ * Keypad configuration for embedded Linux targets.
+ *
+ * This file replaces src/keypad_config.h when keypad.c is built on Linux with the FreeRTOS POSIX port.
+ * Put src/linux ahead of src in the include path so that `#include <keypad_config.h>` resolves here,
+ * and link keypad_gpio_linux.c (and keypad_uinput.c for the evdev output) together with keypad.c and libgpiod.
+ * The scan, debounce and event pipeline of keypad.c is used unchanged.
+ */
+
+#include <unistd.h>
+#include "keypad_gpio_linux.h"
+
+// Configuration for the matrix keypad
+#define KEYPAD_GPIO_STABILIZATION_US      50                          // Delay for GPIO pin stabilization, in us
+#define KEYPAD_TASK_DELAY_MS              5                           // Delay for keypad tasks, in ms
+#define KEYPAD_DEBOUNCE_MS                50                          // Time to stabilize a pressed key, in ms
+#define KEYPAD_QUEUE_SIZE                 10                          // Size of keypad queue
+#define KEYPAD_DEBOUNCE_MODE              KEYPAD_DEBOUNCE_DEFERRED    // Debounce strategy, see keypad.h
+#define KEYPAD_EAGER_HOLDOFF_MS           20                          // Eager mode hold-off after a press, in ms
+#define KEYPAD_SPECULATIVE_EVENTS         0                           // Emit tentative/confirm/cancel events
+#define KEYPAD_MAX_CALLBACKS              2                           // Number of event callback slots
+#define KEYPAD_TASK_PRIORITY              (tskIDLE_PRIORITY + 1)      // Keypad task priority while idle
+#define KEYPAD_TASK_PRIORITY_BOOST        (tskIDLE_PRIORITY + 3)      // Keypad task priority while debouncing
+#define KEYPAD_TASK_STACK_SIZE            configMINIMAL_STACK_SIZE    // Keypad task stack, callbacks run on it
+#define KEYPAD_TRACE_SIZE                 16                          // Number of recent events kept for diagnostics
+#define KEYPAD_LATENCY_TRACKING           0                           // Track latency of queued events to the consumers
+#define KEYPAD_LATENCY_SLO_MS             50                          // Consumer latency raising KEY_LATENCY, in ms
+#define KEYPAD_EDGE_TIMESTAMPS            0                           // Column edge interrupts, GD32 only
+#define KEYPAD_GPIO_BITBAND               0                           // Cortex-M3 bit-band access, GD32 only
+#define KEYPAD_PRESENCE_DETECT            KEYPAD_PRESENCE_NONE        // Keypad presence detection, see keypad.h
+#define KEYPAD_PRESENCE_PROBE_MS          500                         // Presence probe interval, in ms
+#define KEYPAD_FAULT_INJECTION            0                           // Fault injection hooks, see keypad_fault.h
+#define KEYPAD_SEQUENCE_DETECT            0                           // Publish KEY_SEQUENCE for completed sequences
+#define KEYPAD_BIDIRECTIONAL              0                           // Bidirectional diode scan, GD32 only
+#define KEYPAD_CHARLIEPLEX                0                           // Charlieplexed keypads, GD32 only
+#define KEYPAD_MUX                        0                           // Multiplexed column sensing, GD32 only
+#define KEYPAD_MPU                        0                           // Unprivileged keypad task, GD32 only
+#define KEYPAD_MPU_PRIVATE_SIZE           2048                        // MPU region of the keypad task data, bytes
+#define KEYPAD_MPU_SHARED_SIZE            1024                        // MPU region read by the consumers, bytes
+#define KEYPAD_WATCHDOG                   0                           // Publish a heartbeat for a watchdog task
+#define KEYPAD_WATCHDOG_STALL_MS          100                         // Heartbeat delay reported as a stall, in ms
+#define KEYPAD_WATCHDOG_RECOVER_MS        0                           // Heartbeat delay restarting the task, 0 never
+
+// Busy-wait used for the waits shorter than a tick, see src/keypad_config.h.
+#define KEYPAD_DELAY_INIT()
+#define KEYPAD_DELAY_US(US) usleep(US)
+
+// Clock timing the scans for the scan time histogram, see src/keypad_config.h.
+#define KEYPAD_SCAN_CLOCK()  keypad_linux_clock_us()
+#define KEYPAD_SCAN_CLOCK_HZ 1000000UL
+
+// Keypad Key Definitions
+#define KEY_NONE                          0
+#define KEY_LONG                          0x10000
+#define KEY_1                             0x0001
+#define KEY_2                             0x0002
+#define KEY_3                             0x0004
+#define KEY_MEM                           0x0008
+#define KEY_4                             0x0010
+#define KEY_5                             0x0020
+#define KEY_6                             0x0040
+#define KEY_CHECK                         0x0080
+#define KEY_7                             0x0100
+#define KEY_8                             0x0200
+#define KEY_9                             0x0400
+#define KEY_MESSAGE                       0x0800
+#define KEY_STAR                          0x1000
+#define KEY_0                             0x2000
+#define KEY_POUND                         0x4000
+#define KEY_ENTER                         0x8000
+
+// Keys read in the reverse pass of KEYPAD_BIDIRECTIONAL. Their event words carry KEY_EVENT_UPPER and the bit of
+// the key at the same position, so KEY_REVERSE gives the event word of a reverse key. In keys_held and the event
+// groups they sit rows * cols bits above that key, 16 on this 4x4 keypad, which KEY_REVERSE_HELD gives.
+#define KEY_REVERSE(KEY)                  (KEY_EVENT_UPPER | (KEY))
+#define KEY_REVERSE_HELD(KEY)             ((KEY) << 16)
+
+/**
+ * GPIO function mappings for keypad library, routed to the libgpiod backend in keypad_gpio_linux.c.
+ *
+ * All lines live on KEYPAD_LINUX_GPIO_CHIP (see keypad_gpio_linux.h),
+ * so the port is ignored and the pin is the line offset.
+ * The lines are declared by KEYPAD_GPIO_INIT and requested together by KEYPAD_GPIO_FINISH once keypad_init
+ * declared all of them, and all columns are read with a single bulk read per driven row.
+ */
+#define KEYPAD_GPIO_MODE_OUT_OD           KEYPAD_LINUX_MODE_OUT_OD
+#define KEYPAD_GPIO_MODE_IPU              KEYPAD_LINUX_MODE_IPU
+#define KEYPAD_GPIO_ENABLE_CLK(PERIPH)    (void)(PERIPH);
+#define KEYPAD_GPIO_INIT(PORT, PIN, MODE) keypad_linux_gpio_init(PIN, MODE)
+#define KEYPAD_GPIO_SET(PORT, PIN)        keypad_linux_gpio_write(PIN, 1)
+#define KEYPAD_GPIO_RESET(PORT, PIN)      keypad_linux_gpio_write(PIN, 0)
+#define KEYPAD_GPIO_GET(PORT, PIN)        keypad_linux_gpio_read(PIN)
+#define KEYPAD_GPIO_FINISH()              keypad_linux_gpio_request()
+
+/**
+ * Structure defining the GPIO configuration for the keypad.
+ *
+ * - uint32_t port: Unused on Linux, all lines are on KEYPAD_LINUX_GPIO_CHIP.
+ * - uint32_t pin: Line offset on the GPIO chip.
+ * - uint32_t periph: Unused on Linux, there are no peripheral clocks to enable.
+ */
+typedef struct {
+    uint32_t port;   // Unused on Linux
+    uint32_t pin;    // Line offset on the GPIO chip
+    uint32_t periph; // Unused on Linux
+} keypad_gpio_t;
+
+/**
+ * Structure describing one keypad serviced by the keypad task. Fill it with KEYPAD_LAYOUT_ENTRY.
+ *
+ * - rows, cols: GPIO tables of the keypad rows and columns.
+ * - row_divider: Scan rate class of every row, see KEYPAD_ROW_SCAN_DIVIDER.
+ * - row_count, col_count, divider_count: Number of entries in the tables.
+ * - detect: Presence detect pin used with KEYPAD_PRESENCE_PIN, NULL if the keypad has none.
+ *   Use KEYPAD_LAYOUT_ENTRY_DETECT to set it.
+ * - charlieplex: Whether the keypad is charlieplexed, see KEYPAD_LAYOUT_ENTRY_CHARLIEPLEX.
+ * - mux: Whether the columns are sensed through a multiplexer, see KEYPAD_LAYOUT_ENTRY_MUX.
+ */
+typedef struct {
+    const keypad_gpio_t* rows;  // GPIO table of the keypad rows
+    const keypad_gpio_t* cols;  // GPIO table of the keypad columns
+    const uint8_t* row_divider; // Scan rate class of every row
+    uint8_t row_count;          // Number of entries in rows
+    uint8_t col_count;          // Number of entries in cols
+    uint8_t divider_count;      // Number of entries in row_divider
+    // Presence detect pin, reads low while the keypad is attached
+    const keypad_gpio_t* detect;
+    uint8_t charlieplex; // Whether rows holds the pins of a charlieplexed keypad
+    uint8_t mux;         // Whether cols holds the select lines and input of a multiplexer
+} keypad_layout_t;
+
+#define KEYPAD_LAYOUT_ENTRY(ROWS, COLS, DIVIDERS) KEYPAD_LAYOUT_ENTRY_DETECT(ROWS, COLS, DIVIDERS, NULL)
+
+#define KEYPAD_LAYOUT_ENTRY_DETECT(ROWS, COLS, DIVIDERS, DETECT)                                                \
+    {(ROWS), (COLS), (DIVIDERS), sizeof(ROWS) / sizeof((ROWS)[0]), sizeof(COLS) / sizeof((COLS)[0]),            \
+     sizeof(DIVIDERS) / sizeof((DIVIDERS)[0]), (DETECT), 0, 0}
+
+/**
+ * Charlieplexed keypad on the N pins of PINS, with KEYPAD_CHARLIEPLEX enabled. The key between pins A and B
+ * conducts from B to A through its diode, so it reads low on pin B while pin A drives. Every pin drives in
+ * its own pass while all other pins sense with their pull-ups, N * (N - 1) keys in total, up to 6 pins.
+ * The keys of the pass of pin A are numbered A * (N - 1) and up, in the order of the sensing pins.
+ * DIVIDERS holds the scan rate class of every pass, one entry per pin.
+ */
+#define KEYPAD_LAYOUT_ENTRY_CHARLIEPLEX(PINS, DIVIDERS)                                                         \
+    {(PINS), (PINS), (DIVIDERS), sizeof(PINS) / sizeof((PINS)[0]), sizeof(PINS) / sizeof((PINS)[0]) - 1,        \
+     sizeof(DIVIDERS) / sizeof((DIVIDERS)[0]), NULL, 1, 0}
+
+/**
+ * Keypad whose columns are sensed through an 8:1 analog multiplexer (74HC4051), with KEYPAD_MUX enabled.
+ * MUX holds four pins: the select lines S0, S1 and S2, driven push-pull, and the input wired to the common
+ * pin of the multiplexer. Column N is wired to channel N, CHANNELS columns in total. The multiplexer only
+ * connects one column to the input at a time, so every column needs an external pull-up.
+ * The channels are read in Gray code order, one select line changes per step.
+ */
+#define KEYPAD_LAYOUT_ENTRY_MUX(ROWS, MUX, CHANNELS, DIVIDERS)                                                  \
+    {(ROWS), (MUX), (DIVIDERS), sizeof(ROWS) / sizeof((ROWS)[0]), (CHANNELS),                                   \
+     sizeof(DIVIDERS) / sizeof((DIVIDERS)[0]), NULL, 0, 1}
+
+/**
+ * This section defines the line offsets of the keypad on KEYPAD_LINUX_GPIO_CHIP.
+ * Users should edit these configurations based on their specific board, `gpioinfo` lists the available lines.
+ */
+const keypad_gpio_t KEYPAD_ROW_GPIO[] = {
+    {0, 0, 0}, // Edit these values to match the keypad row line offsets on your board
+    {0, 1, 0}, // Edit these values to match the keypad row line offsets on your board
+    {0, 2, 0}, // Edit these values to match the keypad row line offsets on your board
+    {0, 3, 0}  // Edit these values to match the keypad row line offsets on your board
+};
+
+/**
+ * Scan rate class of every row, one entry per KEYPAD_ROW_GPIO entry.
+ * A row is sampled on every Nth scan cycle, 1 samples it on every cycle. Give the rows holding critical keys
+ * (stop, cancel) a divider of 1 and lower KEYPAD_TASK_DELAY_MS, the other rows then only pay for the fast rate
+ * on every Nth cycle. The debounce time is stretched if needed so that it spans two samples of the slowest row.
+ */
+const uint8_t KEYPAD_ROW_SCAN_DIVIDER[] = {1, 1, 1, 1};
+
+const keypad_gpio_t KEYPAD_COL_GPIO[] = {
+    {0, 4, 0}, // Edit these values to match the keypad column line offsets on your board
+    {0, 5, 0}, // Edit these values to match the keypad column line offsets on your board
+    {0, 6, 0}, // Edit these values to match the keypad column line offsets on your board
+    {0, 7, 0}  // Edit these values to match the keypad column line offsets on your board
+};
+
+/**
+ * Keypads serviced by the keypad task, one KEYPAD_LAYOUT_ENTRY per keypad.
+ * The first entry is the keypad behind keypad_queue and keypad_event_group, keypad_get reaches all of them.
+ *
+ * All keypads are scanned by the single keypad task on a combined schedule: row N of every keypad is driven
+ * at the same time and they share one stabilization delay. Scan time grows with the largest row count
+ * rather than with the number of keypads. The keypads must therefore not share any row or column line.
+ */
+const keypad_layout_t KEYPAD_LAYOUT[] = {
+    KEYPAD_LAYOUT_ENTRY(KEYPAD_ROW_GPIO, KEYPAD_COL_GPIO, KEYPAD_ROW_SCAN_DIVIDER),
+};
+
+#endif
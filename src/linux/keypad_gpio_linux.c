@@ -0,0 +1,188 @@
+#include <stdio.h>
+#include <time.h>
+#include <gpiod.h>
+#include "keypad_gpio_linux.h"
+
+/**
+ * libgpiod backend for the keypad GPIO mappings.
+ *
+ * keypad_gpio_init declares every row and column line through KEYPAD_GPIO_INIT. Once the lines of all keypads
+ * are declared, keypad_init calls KEYPAD_GPIO_FINISH, which requests them at once: one open-drain output bulk
+ * for the rows and one pull-up input bulk for the columns, a libgpiod bulk request having a single direction.
+ * Until then, and for good if the request failed, row writes are ignored and every column reads released.
+ *
+ * keypad_scan reads the columns one by one after driving a row. The first read after a row change fetches
+ * all columns with a single bulk read, and the following reads are served from that snapshot until the
+ * next row change. A full scan therefore costs one ioctl per row write and one per row read.
+ */
+
+// Line set declared for one role (rows or columns).
+typedef struct {
+    unsigned int offsets[GPIOD_LINE_BULK_MAX_LINES]; // Line offsets in declaration order
+    unsigned int count;                              // Number of declared lines
+    struct gpiod_line_bulk bulk;                     // Requested lines, valid once requested
+} keypad_linux_lines_t;
+
+static struct gpiod_chip* keypad_linux_chip = NULL;            // Chip holding the keypad lines
+static keypad_linux_lines_t keypad_linux_rows;                 // Row lines, driven open-drain
+static keypad_linux_lines_t keypad_linux_cols;                 // Column lines, read with pull-up
+static int keypad_linux_col_values[GPIOD_LINE_BULK_MAX_LINES]; // Snapshot of the column levels
+static int keypad_linux_col_valid = 0;                         // Whether the snapshot matches the driven row
+static int keypad_linux_state = 0;                             // 0: not requested, 1: requested, -1: failed
+static int keypad_linux_overflow = 0;                          // Whether more lines were declared than fit a bulk
+
+/**
+ * @brief Returns the index of a line offset within a line set.
+ *
+ * @return Index of the line, or -1 if the offset was not declared.
+ */
+static int keypad_linux_index(const keypad_linux_lines_t* lines, uint32_t offset) {
+    unsigned int i;
+
+    for (i = 0; i < lines->count; i++) {
+        if (lines->offsets[i] == offset) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Declares a keypad line.
+ *
+ * @param offset Line offset on KEYPAD_LINUX_GPIO_CHIP.
+ * @param mode KEYPAD_LINUX_MODE_OUT_OD for rows, KEYPAD_LINUX_MODE_IPU for columns.
+ */
+void keypad_linux_gpio_init(uint32_t offset, int mode) {
+    keypad_linux_lines_t* lines = (mode == KEYPAD_LINUX_MODE_OUT_OD) ? &keypad_linux_rows : &keypad_linux_cols;
+
+    if (keypad_linux_index(lines, offset) >= 0) {
+        return;
+    }
+    if (lines->count < GPIOD_LINE_BULK_MAX_LINES) {
+        lines->offsets[lines->count++] = offset;
+    } else {
+        keypad_linux_overflow = 1;
+    }
+}
+
+/**
+ * @brief Requests the declared row and column lines from the GPIO chip.
+ *
+ * Rows are requested as open-drain outputs released high, columns as inputs with pull-up bias. Both requests
+ * are made together once all lines are declared. If either fails, the lines already requested are released
+ * again and the error is returned. Once the lines are requested, further calls return 0 without a request.
+ *
+ * @return 0 on success, -1 on failure.
+ */
+int keypad_linux_gpio_request(void) {
+    int released[GPIOD_LINE_BULK_MAX_LINES];
+    unsigned int i;
+
+    if (keypad_linux_state > 0) {
+        return 0;
+    }
+    keypad_linux_state = -1;
+
+    if (keypad_linux_rows.count == 0 || keypad_linux_cols.count == 0 || keypad_linux_overflow) {
+        fprintf(stderr, "keypad: %u rows and %u columns declared, at most %u each\n", keypad_linux_rows.count,
+                keypad_linux_cols.count, (unsigned int)GPIOD_LINE_BULK_MAX_LINES);
+        return -1;
+    }
+
+    // All rows start released, the scan drives them low one at a time.
+    for (i = 0; i < keypad_linux_rows.count; i++) {
+        released[i] = 1;
+    }
+
+    keypad_linux_chip = gpiod_chip_open_lookup(KEYPAD_LINUX_GPIO_CHIP);
+    if (keypad_linux_chip == NULL) {
+        perror("keypad: " KEYPAD_LINUX_GPIO_CHIP);
+        return -1;
+    }
+
+    if (gpiod_chip_get_lines(keypad_linux_chip, keypad_linux_rows.offsets, keypad_linux_rows.count,
+                             &keypad_linux_rows.bulk) < 0
+        || gpiod_chip_get_lines(keypad_linux_chip, keypad_linux_cols.offsets, keypad_linux_cols.count,
+                                &keypad_linux_cols.bulk) < 0) {
+        perror("keypad: get lines");
+        gpiod_chip_close(keypad_linux_chip);
+        keypad_linux_chip = NULL;
+        return -1;
+    }
+
+    if (gpiod_line_request_bulk_output_flags(&keypad_linux_rows.bulk, KEYPAD_LINUX_GPIO_CONSUMER,
+                                             GPIOD_LINE_REQUEST_FLAG_OPEN_DRAIN, released) < 0) {
+        perror("keypad: request rows");
+        gpiod_chip_close(keypad_linux_chip);
+        keypad_linux_chip = NULL;
+        return -1;
+    }
+    if (gpiod_line_request_bulk_input_flags(&keypad_linux_cols.bulk, KEYPAD_LINUX_GPIO_CONSUMER,
+                                            GPIOD_LINE_REQUEST_FLAG_BIAS_PULL_UP) < 0) {
+        perror("keypad: request columns");
+        gpiod_line_release_bulk(&keypad_linux_rows.bulk);
+        gpiod_chip_close(keypad_linux_chip);
+        keypad_linux_chip = NULL;
+        return -1;
+    }
+
+    keypad_linux_col_valid = 0;
+    keypad_linux_state = 1;
+    return 0;
+}
+
+/**
+ * @brief Drives a row line and invalidates the column snapshot.
+ *
+ * Ignored until keypad_linux_gpio_request succeeded.
+ *
+ * @param offset Line offset of the row.
+ * @param value 0 to drive the line low, 1 to release it.
+ */
+void keypad_linux_gpio_write(uint32_t offset, int value) {
+    int index = keypad_linux_index(&keypad_linux_rows, offset);
+
+    if (index < 0 || keypad_linux_state <= 0) {
+        return;
+    }
+
+    gpiod_line_set_value(gpiod_line_bulk_get_line(&keypad_linux_rows.bulk, (unsigned int)index), value);
+
+    // The columns have to be sampled again for the newly driven row
+    keypad_linux_col_valid = 0;
+}
+
+/**
+ * @brief Reads a column line from the current snapshot, taking a new bulk snapshot if needed.
+ *
+ * @param offset Line offset of the column.
+ *
+ * @return The line level, or 1 (released) on error or before keypad_linux_gpio_request succeeded.
+ */
+int keypad_linux_gpio_read(uint32_t offset) {
+    int index = keypad_linux_index(&keypad_linux_cols, offset);
+
+    if (index < 0 || keypad_linux_state <= 0) {
+        return 1;
+    }
+
+    if (!keypad_linux_col_valid) {
+        if (gpiod_line_get_value_bulk(&keypad_linux_cols.bulk, keypad_linux_col_values) < 0) {
+            return 1;
+        }
+        keypad_linux_col_valid = 1;
+    }
+
+    return keypad_linux_col_values[index];
+}
+
+/**
+ * @brief Reads the monotonic clock, in microseconds.
+ */
+uint32_t keypad_linux_clock_us(void) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint32_t)((uint64_t)now.tv_sec * 1000000U + (uint64_t)now.tv_nsec / 1000U);
+}
@@ -0,0 +1,42 @@
+#ifndef MATRIX_KEYPAD_GPIO_LINUX_H
+#define MATRIX_KEYPAD_GPIO_LINUX_H
+
+#include <stdint.h>
+
+// GPIO chip holding all keypad lines, as accepted by gpiod_chip_open_lookup.
+// Define it on the compiler command line to override the default.
+#ifndef KEYPAD_LINUX_GPIO_CHIP
+#define KEYPAD_LINUX_GPIO_CHIP "gpiochip0"
+#endif
+
+// Consumer label of the requested lines, shown by gpioinfo.
+#ifndef KEYPAD_LINUX_GPIO_CONSUMER
+#define KEYPAD_LINUX_GPIO_CONSUMER "keypad"
+#endif
+
+// Line modes accepted by keypad_linux_gpio_init.
+#define KEYPAD_LINUX_MODE_OUT_OD 0 // Open-drain output, used for the rows
+#define KEYPAD_LINUX_MODE_IPU    1 // Input with pull-up bias, used for the columns
+
+// Function declaration for declaring a keypad line.
+// Called through KEYPAD_GPIO_INIT while keypad_gpio_init runs. The lines are requested by keypad_linux_gpio_request.
+void keypad_linux_gpio_init(uint32_t offset, int mode);
+
+// Function declaration for requesting all declared lines from the GPIO chip.
+// Called through KEYPAD_GPIO_FINISH once keypad_init declared the lines of every keypad.
+// Returns 0 on success and -1 if the lines could not be requested, the error is printed to stderr.
+int keypad_linux_gpio_request(void);
+
+// Function declaration for driving a row line. Value 0 drives the line low, 1 releases it.
+// Ignored until the lines are requested.
+void keypad_linux_gpio_write(uint32_t offset, int value);
+
+// Function declaration for reading a column line.
+// Returns the line level, or 1 (released) while the lines are not requested.
+int keypad_linux_gpio_read(uint32_t offset);
+
+// Function declaration for reading the monotonic clock, in microseconds. Wraps after about 71 minutes.
+// Used through KEYPAD_SCAN_CLOCK to time the scans.
+uint32_t keypad_linux_clock_us(void);
+
+#endif
@@ -0,0 +1,133 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <keypad.h>
+#include "keypad_uinput.h"
+
+// linux/input-event-codes.h has its own KEY_CANCEL, the keypad event kind is not used in this file.
+#undef KEY_CANCEL
+#include <linux/uinput.h>
+
+/**
+ * uinput output backend.
+ *
+ * Registers a virtual keyboard with the kernel and reports the held keys of the keypad on it,
+ * so any evdev consumer (libinput, Qt, a console) can read the keypad like a regular keyboard.
+ *
+ * Keys go down and up as the debounced held state does, followed from the KEY_STATE events, so the
+ * consumer sees how long a key is held and the kernel can generate its autorepeat.
+ */
+
+static int keypad_uinput_fd = -1;              // File descriptor of the uinput device
+static const uint16_t* keypad_uinput_keycodes; // Linux key code for every key bit
+static uint8_t keypad_uinput_count;            // Number of entries in keypad_uinput_keycodes
+static uint8_t keypad_uinput_index;            // Index of the keypad reported by the device
+static uint32_t keypad_uinput_keys;            // Keys reported down on the device
+
+/**
+ * @brief Writes a single input event to the uinput device.
+ */
+static void keypad_uinput_emit(uint16_t type, uint16_t code, int32_t value) {
+    struct input_event ev;
+
+    memset(&ev, 0, sizeof(ev));
+    ev.type = type;
+    ev.code = code;
+    ev.value = value;
+    if (write(keypad_uinput_fd, &ev, sizeof(ev)) != (ssize_t)sizeof(ev)) {
+        perror("keypad: uinput write");
+    }
+}
+
+/**
+ * @brief Keypad callback forwarding the held keys to the uinput device.
+ *
+ * Every KEY_STATE event reports the keys that changed in keys_held since the last report, pressed
+ * keys with value 1 and released ones with value 0, in one report so chords arrive at the consumer
+ * as chords. A change carried by both the lower and the KEY_EVENT_UPPER word is reported on the
+ * first of them. The key bits of every keypad start at 0, so only the events of the keypad of the
+ * device are reported.
+ */
+static void keypad_uinput_callback(const keypad_t* kp, uint32_t event, void* ctx) {
+    uint32_t changed;
+    uint8_t i;
+
+    if (kp->index != keypad_uinput_index || KEY_EVENT_BASE_KIND(event) != KEY_STATE) {
+        return;
+    }
+
+    changed = kp->keys_held ^ keypad_uinput_keys;
+    keypad_uinput_keys = kp->keys_held;
+    if (changed == 0) {
+        return;
+    }
+
+    for (i = 0; i < keypad_uinput_count; i++) {
+        if ((changed & (1UL << i)) && keypad_uinput_keycodes[i] != 0) {
+            keypad_uinput_emit(EV_KEY, keypad_uinput_keycodes[i], (keypad_uinput_keys >> i) & 1U);
+        }
+    }
+    keypad_uinput_emit(EV_SYN, SYN_REPORT, 0);
+}
+
+/**
+ * @brief Creates the uinput device and registers it as a keypad event callback.
+ *
+ * @param keycodes Linux KEY_* code for every key bit, 0 for unmapped keys. Must stay valid.
+ * @param count Number of entries in keycodes, at most 32.
+ * @param index Index of the keypad in KEYPAD_LAYOUT.
+ *
+ * @return 0 on success, -1 if the index is out of range, the device could not be created or no callback slot
+ *         was free.
+ */
+int keypad_uinput_init(const uint16_t* keycodes, uint8_t count, uint8_t index) {
+    struct uinput_setup setup;
+    uint8_t i;
+
+    if (index >= keypad_count()) {
+        return -1;
+    }
+    keypad_uinput_index = index;
+    if (count > 32) {
+        count = 32;
+    }
+    keypad_uinput_keycodes = keycodes;
+    keypad_uinput_count = count;
+    keypad_uinput_keys = 0;
+
+    keypad_uinput_fd = open("/dev/uinput", O_WRONLY | O_NONBLOCK);
+    if (keypad_uinput_fd < 0) {
+        perror("keypad: /dev/uinput");
+        return -1;
+    }
+
+    // Announce every key code the keypad can produce
+    ioctl(keypad_uinput_fd, UI_SET_EVBIT, EV_KEY);
+    for (i = 0; i < count; i++) {
+        if (keycodes[i] != 0) {
+            ioctl(keypad_uinput_fd, UI_SET_KEYBIT, keycodes[i]);
+        }
+    }
+
+    memset(&setup, 0, sizeof(setup));
+    setup.id.bustype = BUS_VIRTUAL;
+    strncpy(setup.name, KEYPAD_UINPUT_NAME, UINPUT_MAX_NAME_SIZE - 1);
+
+    if (ioctl(keypad_uinput_fd, UI_DEV_SETUP, &setup) < 0 || ioctl(keypad_uinput_fd, UI_DEV_CREATE) < 0) {
+        perror("keypad: uinput setup");
+        close(keypad_uinput_fd);
+        keypad_uinput_fd = -1;
+        return -1;
+    }
+
+    if (keypad_register_callback(keypad_uinput_callback, NULL) != pdPASS) {
+        ioctl(keypad_uinput_fd, UI_DEV_DESTROY);
+        close(keypad_uinput_fd);
+        keypad_uinput_fd = -1;
+        return -1;
+    }
+
+    return 0;
+}
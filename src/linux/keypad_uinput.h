@@ -0,0 +1,18 @@
+#ifndef MATRIX_KEYPAD_UINPUT_H
+#define MATRIX_KEYPAD_UINPUT_H
+
+#include <stdint.h>
+
+// Name of the evdev device created by keypad_uinput_init, shown by evtest and in /proc/bus/input/devices.
+#ifndef KEYPAD_UINPUT_NAME
+#define KEYPAD_UINPUT_NAME "Matrix Keypad"
+#endif
+
+// Function declaration for publishing the events of a keypad as an evdev input device.
+// Creates a uinput device and registers a keypad callback that presses and releases its keys as the keypad at
+// index holds them.
+// keycodes[i] is the Linux KEY_* code reported for key bit i, 0 leaves the key unmapped.
+// Must be called after keypad_init. Returns 0 on success and -1 on failure.
+int keypad_uinput_init(const uint16_t* keycodes, uint8_t count, uint8_t index);
+
+#endif
@@ -0,0 +1,400 @@
+#ifndef MATRIX_KEYPAD_CONFIG_H
+#define MATRIX_KEYPAD_CONFIG_H
+
+/**
+ * Keypad configuration of the host tests that build keypad.c itself.
+ *
+ * Put test/config ahead of src in the include path so that `#include <keypad_config.h>` resolves here, and link
+ * freertos_fake.c for the kernel. The GPIO lines are simulated: keypad K drives its rows on lines 16 * K + 0..3
+ * and reads its columns on lines 16 * K + 4..7. A column reads low while a row driven low connects to it through
+ * a key set in keypad_sim_keys[K], a row reads low while a column driven low connects to it through a reverse key
+ * set there. With KEYPAD_CHARLIEPLEX keypad 0 is charlieplexed on lines 0..4 instead, with KEYPAD_MUX its columns
+ * are the channels of a multiplexer with select lines 4..6 and input 7. Only open-drain outputs
+ * drive the keys, so the lines follow the pin modes written by keypad.c, also through the mode registers.
+ * Keypad K grounds its presence detect pin, line 16 * K + 15, and pulls its columns up on its side of the cable
+ * until it is unplugged with keypad_sim_unplugged[K]. Unplugged, its lines only follow the pulls of the GPIO pins.
+ * KEYPAD_TEST_KEYPADS sets the number of keypads, a power of two up to 32. KEYPAD_TEST_COLUMNS sets the columns of
+ * every keypad, 4 or 8 on lines 16 * K + 4..11 for a keypad of 32 keys, which needs both event group shards.
+ * KEYPAD_TEST_ROW_DIVIDER sets the scan rate class of the last row of every keypad.
+ */
+
+#include <time.h>
+
+#ifndef KEYPAD_TEST_KEYPADS
+#define KEYPAD_TEST_KEYPADS 1
+#endif
+#if (KEYPAD_TEST_KEYPADS < 1) || (KEYPAD_TEST_KEYPADS > 32) || (KEYPAD_TEST_KEYPADS & (KEYPAD_TEST_KEYPADS - 1))
+#error "KEYPAD_TEST_KEYPADS must be a power of two up to 32"
+#endif
+#ifndef KEYPAD_TEST_COLUMNS
+#define KEYPAD_TEST_COLUMNS 4
+#endif
+#ifndef KEYPAD_TEST_ROW_DIVIDER
+#define KEYPAD_TEST_ROW_DIVIDER 1
+#endif
+
+// Configuration for the matrix keypad
+#define KEYPAD_GPIO_STABILIZATION_US      50                          // Delay for GPIO pin stabilization, in us
+#define KEYPAD_TASK_DELAY_MS              5                           // Delay for keypad tasks, in ms
+#define KEYPAD_DEBOUNCE_MS                50                          // Time to stabilize a pressed key, in ms
+#define KEYPAD_QUEUE_SIZE                 10                          // Size of keypad queue
+#define KEYPAD_EAGER_HOLDOFF_MS           20                          // Eager mode hold-off after a press, in ms
+#define KEYPAD_MAX_CALLBACKS              2                           // Number of event callback slots
+#define KEYPAD_TASK_PRIORITY              (tskIDLE_PRIORITY + 1)      // Keypad task priority while idle
+#define KEYPAD_TASK_PRIORITY_BOOST        (tskIDLE_PRIORITY + 3)      // Keypad task priority while debouncing
+#define KEYPAD_TASK_STACK_SIZE            configMINIMAL_STACK_SIZE    // Keypad task stack, callbacks run on it
+#define KEYPAD_TRACE_SIZE                 16                          // Number of recent events kept for diagnostics
+#define KEYPAD_LATENCY_SLO_MS             50                          // Consumer latency raising KEY_LATENCY, in ms
+#define KEYPAD_EDGE_SETTLE_US             20000                       // Quiet time after the last edge, in us
+#define KEYPAD_EDGE_GUARD_US              20                          // Edges ignored after driving the rows, in us
+#define KEYPAD_EDGE_RING_SIZE             8                           // Edge timestamps buffered per column line
+#define KEYPAD_EDGE_MAX_COLS              8                           // Largest column count in edge mode
+#define KEYPAD_GPIO_BITBAND               0                           // Cortex-M3 bit-band access, GD32 only
+#define KEYPAD_PRESENCE_PROBE_MS          500                         // Presence probe interval, in ms
+#define KEYPAD_MUX_SETTLE_US              1                           // Mux settle time after a select change, in us
+#define KEYPAD_MPU                        0                           // Unprivileged keypad task, GD32 only
+#define KEYPAD_MPU_PRIVATE_SIZE           2048                        // MPU region of the keypad task data, bytes
+#define KEYPAD_MPU_SHARED_SIZE            1024                        // MPU region read by the consumers, bytes
+#define KEYPAD_WATCHDOG_STALL_MS          100                         // Heartbeat delay reported as a stall, in ms
+
+// Options varied by the builds of test/Makefile.
+#ifndef KEYPAD_DEBOUNCE_MODE
+#define KEYPAD_DEBOUNCE_MODE KEYPAD_DEBOUNCE_DEFERRED // Debounce strategy, see keypad.h
+#endif
+#ifndef KEYPAD_SPECULATIVE_EVENTS
+#define KEYPAD_SPECULATIVE_EVENTS 0 // Emit tentative/confirm/cancel events
+#endif
+#ifndef KEYPAD_LATENCY_TRACKING
+#define KEYPAD_LATENCY_TRACKING 0 // Track latency of queued events to the consumers
+#endif
+#ifndef KEYPAD_FAULT_INJECTION
+#define KEYPAD_FAULT_INJECTION 0 // Fault injection hooks, see keypad_fault.h
+#endif
+#ifndef KEYPAD_CHARLIEPLEX
+#define KEYPAD_CHARLIEPLEX 0 // Support charlieplexed keypads, keypad 0 is one
+#endif
+#ifndef KEYPAD_MUX
+#define KEYPAD_MUX 0 // Support multiplexed column sensing, keypad 0 is sensed through one
+#endif
+#ifndef KEYPAD_BIDIRECTIONAL
+#define KEYPAD_BIDIRECTIONAL 0 // Scan diode pairs in both directions
+#endif
+#ifndef KEYPAD_EDGE_TIMESTAMPS
+#define KEYPAD_EDGE_TIMESTAMPS 0 // Debounce from column edge timestamps, the test calls keypad_edge_isr
+#endif
+#ifndef KEYPAD_PRESENCE_DETECT
+#define KEYPAD_PRESENCE_DETECT KEYPAD_PRESENCE_NONE // Keypad presence detection, see keypad.h
+#endif
+#ifndef KEYPAD_SEQUENCE_DETECT
+#define KEYPAD_SEQUENCE_DETECT 0 // Publish KEY_SEQUENCE for completed sequences
+#endif
+#ifndef KEYPAD_WATCHDOG
+#define KEYPAD_WATCHDOG 0 // Publish a heartbeat for a watchdog task
+#endif
+#ifndef KEYPAD_WATCHDOG_RECOVER_MS
+#define KEYPAD_WATCHDOG_RECOVER_MS 0 // Heartbeat delay restarting the task, 0 never
+#endif
+
+// Reverse keys, the charlieplexed and the multiplexed keypad are wired for 4 columns.
+#if (KEYPAD_TEST_COLUMNS != 4) &&                                                                               \
+    ((KEYPAD_TEST_COLUMNS != 8) || KEYPAD_CHARLIEPLEX || KEYPAD_MUX || KEYPAD_BIDIRECTIONAL)
+#error "KEYPAD_TEST_COLUMNS must be 4, or 8 without KEYPAD_CHARLIEPLEX, KEYPAD_MUX and KEYPAD_BIDIRECTIONAL"
+#endif
+
+// Busy-wait on the monotonic clock, so the benchmarks see the stabilization delays of the target.
+#define KEYPAD_DELAY_INIT()
+#define KEYPAD_DELAY_US(US) keypad_sim_delay(US)
+
+// Clock timing the scans for the scan time histogram, the monotonic clock in microseconds.
+#define KEYPAD_SCAN_CLOCK()  keypad_sim_clock_us()
+#define KEYPAD_SCAN_CLOCK_HZ 1000000UL
+
+// Edge timestamp clock, the tick count in microseconds so the timestamps follow the fake kernel.
+#define KEYPAD_EDGE_CLOCK_INIT()
+#define KEYPAD_EDGE_CLOCK()  ((uint32_t)xTaskGetTickCount() * (1000000UL / configTICK_RATE_HZ))
+#define KEYPAD_EDGE_CLOCK_HZ 1000000UL
+
+// Keypad Key Definitions
+#define KEY_NONE                          0
+#define KEY_LONG                          0x10000
+#define KEY_1                             0x0001
+#define KEY_2                             0x0002
+#define KEY_3                             0x0004
+#define KEY_MEM                           0x0008
+#define KEY_4                             0x0010
+#define KEY_5                             0x0020
+#define KEY_6                             0x0040
+#define KEY_CHECK                         0x0080
+#define KEY_7                             0x0100
+#define KEY_8                             0x0200
+#define KEY_9                             0x0400
+#define KEY_MESSAGE                       0x0800
+#define KEY_STAR                          0x1000
+#define KEY_0                             0x2000
+#define KEY_POUND                         0x4000
+#define KEY_ENTER                         0x8000
+
+// Keys read in the reverse pass of KEYPAD_BIDIRECTIONAL, see src/keypad_config.h.
+#define KEY_REVERSE(KEY)                  (KEY_EVENT_UPPER | (KEY))
+#define KEY_REVERSE_HELD(KEY)             ((KEY) << 16)
+
+// Number of simulated lines, 16 per keypad.
+#define KEYPAD_SIM_LINES                  (16 * KEYPAD_TEST_KEYPADS)
+
+/**
+ * GPIO function mappings for keypad library, routed to the simulated lines. Like on the GD32, the port is the
+ * keypad and the pin a mask of one of its 16 lines, each with 4 mode bits in the two mode registers of its port.
+ */
+#define KEYPAD_GPIO_MODE_OUT_OD           0x6
+#define KEYPAD_GPIO_MODE_IPU              0x8
+#define KEYPAD_GPIO_MODE_OUT_PP           0x2
+#define KEYPAD_GPIO_MODE_IPD              0xC
+#define KEYPAD_GPIO_ENABLE_CLK(PERIPH)    (void)(PERIPH);
+#define KEYPAD_GPIO_INIT(PORT, PIN, MODE) keypad_sim_init(KEYPAD_SIM_LINE(PORT, PIN), MODE)
+#define KEYPAD_GPIO_SET(PORT, PIN)        keypad_sim_write(KEYPAD_SIM_LINE(PORT, PIN), 1)
+#define KEYPAD_GPIO_RESET(PORT, PIN)      keypad_sim_write(KEYPAD_SIM_LINE(PORT, PIN), 0)
+#define KEYPAD_GPIO_GET(PORT, PIN)        keypad_sim_read(KEYPAD_SIM_LINE(PORT, PIN))
+#define KEYPAD_SIM_LINE(PORT, PIN)        (16 * (PORT) + (uint32_t)__builtin_ctz(PIN))
+
+// Mode registers of the simulated ports, see src/keypad_config.h.
+#define KEYPAD_GPIO_MODE_REG(PORT, BIT)   ((volatile uint32_t*)&keypad_sim_mode[PORT][(BIT) / 8])
+#define KEYPAD_GPIO_MODE_SHIFT(BIT)       (((BIT) % 8) * 4)
+#define KEYPAD_GPIO_MODE_MASK             0xFUL
+#define KEYPAD_GPIO_MODE_BITS_OUT_OD      KEYPAD_GPIO_MODE_OUT_OD
+#define KEYPAD_GPIO_MODE_BITS_IPU         KEYPAD_GPIO_MODE_IPU
+
+// Charlieplexed keypad 0 of the KEYPAD_CHARLIEPLEX build, on lines 0 to KEYPAD_SIM_CHARLIE_PINS - 1.
+#define KEYPAD_SIM_CHARLIE_PINS           5
+
+// Multiplexer channels of keypad 0 of the KEYPAD_MUX build, fewer than 8 so the Gray order skips some.
+#define KEYPAD_SIM_MUX_CHANNELS           6
+
+// Levels driven on the simulated lines, 1 while released, and the mode registers of their ports.
+static uint8_t keypad_sim_level[KEYPAD_SIM_LINES];
+static uint32_t keypad_sim_mode[KEYPAD_TEST_KEYPADS][2];
+
+// Keys held down on every keypad, one bit per key like keys_pressed.
+static uint32_t keypad_sim_keys[KEYPAD_TEST_KEYPADS];
+
+// Keypads unplugged from their lines, and the number of column reads of every keypad.
+static uint8_t keypad_sim_unplugged[KEYPAD_TEST_KEYPADS];
+static uint32_t keypad_sim_col_reads[KEYPAD_TEST_KEYPADS];
+
+#if KEYPAD_MUX
+// Channels of keypad 0 read through the multiplexer input, in order, and the select line changes.
+static uint8_t keypad_sim_mux_reads[64];
+static uint32_t keypad_sim_mux_read_count;
+static uint32_t keypad_sim_mux_changes;
+#endif
+
+static uint32_t keypad_sim_line_mode(uint32_t line) {
+    return (keypad_sim_mode[line / 16][line % 16 / 8] >> KEYPAD_GPIO_MODE_SHIFT(line % 16)) & KEYPAD_GPIO_MODE_MASK;
+}
+
+static void keypad_sim_init(uint32_t line, uint32_t mode) {
+    uint32_t* reg = &keypad_sim_mode[line / 16][line % 16 / 8];
+
+    *reg = (*reg & ~(KEYPAD_GPIO_MODE_MASK << KEYPAD_GPIO_MODE_SHIFT(line % 16)))
+           | (mode << KEYPAD_GPIO_MODE_SHIFT(line % 16));
+    keypad_sim_level[line] = 1;
+}
+
+static void keypad_sim_write(uint32_t line, uint8_t level) {
+#if KEYPAD_MUX
+    if (line >= 4 && line < 7 && keypad_sim_level[line] != level) {
+        keypad_sim_mux_changes++;
+    }
+#endif
+    keypad_sim_level[line] = level;
+}
+
+// Returns the bit of the key connecting a driving line to a sensing line of keypad K, -1 if there is none.
+static int32_t keypad_sim_key(uint32_t k, uint32_t drive, uint32_t sense) {
+#if KEYPAD_MUX
+    uint32_t channel;
+#endif
+
+#if KEYPAD_CHARLIEPLEX
+    // The key between pins A and B reads on pin B while pin A drives.
+    if (k == 0) {
+        if (drive == sense || drive >= KEYPAD_SIM_CHARLIE_PINS || sense >= KEYPAD_SIM_CHARLIE_PINS) {
+            return -1;
+        }
+        return drive * (KEYPAD_SIM_CHARLIE_PINS - 1) + sense - (sense > drive);
+    }
+#endif
+#if KEYPAD_MUX
+    // The input reads the key of the driving row on the selected channel.
+    if (k == 0) {
+        channel = keypad_sim_level[4] | (keypad_sim_level[5] << 1) | (keypad_sim_level[6] << 2);
+        if (drive >= 4 || sense != 7 || channel >= KEYPAD_SIM_MUX_CHANNELS) {
+            return -1;
+        }
+        return drive * KEYPAD_SIM_MUX_CHANNELS + channel;
+    }
+#endif
+    if (drive < 4 && sense >= 4 && sense < 4 + KEYPAD_TEST_COLUMNS) {
+        return drive * KEYPAD_TEST_COLUMNS + sense - 4;
+    }
+    // Reverse keys read on the rows while the columns drive
+    if (drive >= 4 && drive < 8 && sense < 4) {
+        return 16 + sense * 4 + drive - 4;
+    }
+    return -1;
+}
+
+// A sensing line reads low through a key to a line driving low, or through its pull-down while its output is low.
+// The detect pin reads low while the keypad is plugged in, and a column with a pull-down only once it is unplugged.
+static uint8_t keypad_sim_read(uint32_t line) {
+    uint32_t base = line - line % 16;
+    uint32_t drive;
+    int32_t key;
+
+    if (line % 16 >= 4 && line % 16 < 4 + KEYPAD_TEST_COLUMNS) {
+        keypad_sim_col_reads[line / 16]++;
+    }
+    if (line % 16 == 15) {
+        return keypad_sim_unplugged[line / 16];
+    }
+    if (keypad_sim_line_mode(line) == KEYPAD_GPIO_MODE_IPU && keypad_sim_level[line] == 0) {
+        return 0;
+    }
+    if (keypad_sim_line_mode(line) == KEYPAD_GPIO_MODE_IPD) {
+        return !keypad_sim_unplugged[line / 16];
+    }
+    if (keypad_sim_unplugged[line / 16]) {
+        return 1;
+    }
+#if KEYPAD_MUX
+    if (line == 7) {
+        keypad_sim_mux_reads[keypad_sim_mux_read_count++ % 64] =
+            keypad_sim_level[4] | (keypad_sim_level[5] << 1) | (keypad_sim_level[6] << 2);
+    }
+#endif
+    for (drive = base; drive < base + 16; drive++) {
+        if (keypad_sim_line_mode(drive) != KEYPAD_GPIO_MODE_OUT_OD || keypad_sim_level[drive] != 0) {
+            continue;
+        }
+        key = keypad_sim_key(line / 16, drive % 16, line % 16);
+        if (key >= 0 && (keypad_sim_keys[line / 16] & (1UL << key))) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static uint32_t keypad_sim_clock_us(void) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint32_t)((uint64_t)now.tv_sec * 1000000U + (uint64_t)now.tv_nsec / 1000U);
+}
+
+static void keypad_sim_delay(uint32_t us) {
+    uint32_t start = keypad_sim_clock_us();
+
+    while (keypad_sim_clock_us() - start < us) {
+    }
+}
+
+/**
+ * Structure defining the GPIO configuration for the keypad.
+ *
+ * - uint32_t port: Keypad of the simulated line.
+ * - uint32_t pin: Mask of the simulated line among the 16 lines of its keypad.
+ * - uint32_t periph: Unused, there are no peripheral clocks to enable.
+ */
+typedef struct {
+    uint32_t port;   // Keypad of the simulated line
+    uint32_t pin;    // Mask of the simulated line in its keypad
+    uint32_t periph; // Unused
+} keypad_gpio_t;
+
+// Structure describing one keypad serviced by the keypad task, see src/keypad_config.h.
+typedef struct {
+    const keypad_gpio_t* rows;  // GPIO table of the keypad rows
+    const keypad_gpio_t* cols;  // GPIO table of the keypad columns
+    const uint8_t* row_divider; // Scan rate class of every row
+    uint8_t row_count;          // Number of entries in rows
+    uint8_t col_count;          // Number of entries in cols
+    uint8_t divider_count;      // Number of entries in row_divider
+    // Presence detect pin, reads low while the keypad is attached
+    const keypad_gpio_t* detect;
+    uint8_t charlieplex; // Whether rows holds the pins of a charlieplexed keypad
+    uint8_t mux;         // Whether cols holds the select lines and input of a multiplexer
+} keypad_layout_t;
+
+#define KEYPAD_LAYOUT_ENTRY(ROWS, COLS, DIVIDERS) KEYPAD_LAYOUT_ENTRY_DETECT(ROWS, COLS, DIVIDERS, NULL)
+
+#define KEYPAD_LAYOUT_ENTRY_DETECT(ROWS, COLS, DIVIDERS, DETECT)                                                \
+    {(ROWS), (COLS), (DIVIDERS), sizeof(ROWS) / sizeof((ROWS)[0]), sizeof(COLS) / sizeof((COLS)[0]),            \
+     sizeof(DIVIDERS) / sizeof((DIVIDERS)[0]), (DETECT), 0, 0}
+
+#define KEYPAD_LAYOUT_ENTRY_CHARLIEPLEX(PINS, DIVIDERS)                                                         \
+    {(PINS), (PINS), (DIVIDERS), sizeof(PINS) / sizeof((PINS)[0]), sizeof(PINS) / sizeof((PINS)[0]) - 1,        \
+     sizeof(DIVIDERS) / sizeof((DIVIDERS)[0]), NULL, 1, 0}
+
+// Row and column lines of keypad K.
+#define KEYPAD_SIM_ROWS(K) {{K, 1U << 0, 0}, {K, 1U << 1, 0}, {K, 1U << 2, 0}, {K, 1U << 3, 0}}
+#if (KEYPAD_TEST_COLUMNS == 8)
+#define KEYPAD_SIM_COLS(K)                                                                                      \
+    {{K, 1U << 4, 0}, {K, 1U << 5, 0}, {K, 1U << 6, 0}, {K, 1U << 7, 0},                                        \
+     {K, 1U << 8, 0}, {K, 1U << 9, 0}, {K, 1U << 10, 0}, {K, 1U << 11, 0}}
+#else
+#define KEYPAD_SIM_COLS(K) {{K, 1U << 4, 0}, {K, 1U << 5, 0}, {K, 1U << 6, 0}, {K, 1U << 7, 0}}
+#endif
+
+// Expands M(K) for N keypads from K on, and KEYPAD_SIM_TAIL(M) for keypads 1 to KEYPAD_TEST_KEYPADS - 1, each
+// followed by a comma.
+#define KEYPAD_SIM_1(M, K)                M(K),
+#define KEYPAD_SIM_2(M, K)                KEYPAD_SIM_1(M, K) KEYPAD_SIM_1(M, (K) + 1)
+#define KEYPAD_SIM_4(M, K)                KEYPAD_SIM_2(M, K) KEYPAD_SIM_2(M, (K) + 2)
+#define KEYPAD_SIM_8(M, K)                KEYPAD_SIM_4(M, K) KEYPAD_SIM_4(M, (K) + 4)
+#define KEYPAD_SIM_16(M, K)               KEYPAD_SIM_8(M, K) KEYPAD_SIM_8(M, (K) + 8)
+#define KEYPAD_SIM_TAIL_1(M)
+#define KEYPAD_SIM_TAIL_2(M)              KEYPAD_SIM_1(M, 1)
+#define KEYPAD_SIM_TAIL_4(M)              KEYPAD_SIM_TAIL_2(M) KEYPAD_SIM_2(M, 2)
+#define KEYPAD_SIM_TAIL_8(M)              KEYPAD_SIM_TAIL_4(M) KEYPAD_SIM_4(M, 4)
+#define KEYPAD_SIM_TAIL_16(M)             KEYPAD_SIM_TAIL_8(M) KEYPAD_SIM_8(M, 8)
+#define KEYPAD_SIM_TAIL_32(M)             KEYPAD_SIM_TAIL_16(M) KEYPAD_SIM_16(M, 16)
+#define KEYPAD_SIM_TAIL_N(N, M)           KEYPAD_SIM_TAIL_##N(M)
+#define KEYPAD_SIM_TAIL_EXPAND(N, M)      KEYPAD_SIM_TAIL_N(N, M)
+#define KEYPAD_SIM_TAIL(M)                KEYPAD_SIM_TAIL_EXPAND(KEYPAD_TEST_KEYPADS, M)
+
+const keypad_gpio_t KEYPAD_ROW_GPIO[KEYPAD_TEST_KEYPADS][4] = {KEYPAD_SIM_ROWS(0), KEYPAD_SIM_TAIL(KEYPAD_SIM_ROWS)};
+const keypad_gpio_t KEYPAD_COL_GPIO[KEYPAD_TEST_KEYPADS][KEYPAD_TEST_COLUMNS] = {KEYPAD_SIM_COLS(0),
+                                                                                KEYPAD_SIM_TAIL(KEYPAD_SIM_COLS)};
+const uint8_t KEYPAD_ROW_SCAN_DIVIDER[] = {1, 1, 1, KEYPAD_TEST_ROW_DIVIDER};
+
+#define KEYPAD_LAYOUT_ENTRY_MUX(ROWS, MUX, CHANNELS, DIVIDERS)                                                  \
+    {(ROWS), (MUX), (DIVIDERS), sizeof(ROWS) / sizeof((ROWS)[0]), (CHANNELS),                                   \
+     sizeof(DIVIDERS) / sizeof((DIVIDERS)[0]), NULL, 0, 1}
+
+// Presence detect pins of the keypads, only read with KEYPAD_PRESENCE_PIN.
+#define KEYPAD_SIM_DETECT(K) {K, 1U << 15, 0}
+const keypad_gpio_t KEYPAD_DETECT_GPIO[KEYPAD_TEST_KEYPADS] = {KEYPAD_SIM_DETECT(0),
+                                                               KEYPAD_SIM_TAIL(KEYPAD_SIM_DETECT)};
+
+// Layout entry of keypad K on its own row and column lines, with its detect pin.
+#define KEYPAD_SIM_LAYOUT_ENTRY(K)                                                                              \
+    KEYPAD_LAYOUT_ENTRY_DETECT(KEYPAD_ROW_GPIO[K], KEYPAD_COL_GPIO[K], KEYPAD_ROW_SCAN_DIVIDER,                 \
+                               &KEYPAD_DETECT_GPIO[K])
+
+#if KEYPAD_CHARLIEPLEX
+const keypad_gpio_t KEYPAD_CHARLIE_GPIO[KEYPAD_SIM_CHARLIE_PINS] = {
+    {0, 1U << 0, 0}, {0, 1U << 1, 0}, {0, 1U << 2, 0}, {0, 1U << 3, 0}, {0, 1U << 4, 0}};
+const uint8_t KEYPAD_CHARLIE_SCAN_DIVIDER[KEYPAD_SIM_CHARLIE_PINS] = {1, 1, 1, 1, 1};
+#endif
+
+const keypad_layout_t KEYPAD_LAYOUT[] = {
+#if KEYPAD_CHARLIEPLEX
+    KEYPAD_LAYOUT_ENTRY_CHARLIEPLEX(KEYPAD_CHARLIE_GPIO, KEYPAD_CHARLIE_SCAN_DIVIDER),
+#elif KEYPAD_MUX
+    KEYPAD_LAYOUT_ENTRY_MUX(KEYPAD_ROW_GPIO[0], KEYPAD_COL_GPIO[0], KEYPAD_SIM_MUX_CHANNELS, KEYPAD_ROW_SCAN_DIVIDER),
+#else
+    KEYPAD_SIM_LAYOUT_ENTRY(0),
+#endif
+    KEYPAD_SIM_TAIL(KEYPAD_SIM_LAYOUT_ENTRY)
+};
+
+#endif
@@ -0,0 +1,230 @@
+#include <setjmp.h>
+#include <stdlib.h>
+#include <string.h>
+#include <task.h>
+#include <timers.h>
+#include <event_groups.h>
+#include <queue.h>
+#include "freertos_fake.h"
+
+// type define of structure fake_timer_t, a one-shot or auto-reload software timer
+typedef struct {
+    TickType_t period;
+    TickType_t expiry;
+    UBaseType_t reload;
+    uint8_t active;
+    TimerCallbackFunction_t callback;
+} fake_timer_t;
+
+// type define of structure fake_queue_t, a ring buffer of fixed size items
+typedef struct {
+    uint8_t* items;
+    UBaseType_t length;
+    UBaseType_t item_size;
+    UBaseType_t head;
+    UBaseType_t count;
+    void* set; // Queue set notified of every item sent, a queue of member handles
+} fake_queue_t;
+
+static TickType_t fake_tick;
+static jmp_buf fake_task_exit;    // Return point of fake_task_run
+static uint32_t fake_task_cycles; // Delays left before the running task function is left
+static uint8_t fake_task_running; // Whether fake_task_run is running a task function
+uint32_t fake_tasks_created;
+uint32_t fake_tasks_deleted;
+uint8_t fake_timer_queue_full;
+UBaseType_t fake_task_priority;
+
+void fake_tick_advance(TickType_t ticks) {
+    fake_tick += ticks;
+}
+
+void fake_task_run(TaskFunction_t code, void* param, uint32_t cycles) {
+    fake_task_cycles = cycles;
+    fake_task_running = 1;
+    if (cycles != 0 && setjmp(fake_task_exit) == 0) {
+        code(param);
+    }
+    fake_task_running = 0;
+}
+
+TickType_t xTaskGetTickCount(void) {
+    return fake_tick;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t code, const char* name, uint32_t depth, void* param, UBaseType_t priority,
+                       TaskHandle_t* handle) {
+    static uint8_t task;
+
+    fake_tasks_created++;
+    fake_task_priority = priority;
+    if (handle != NULL) {
+        *handle = &task;
+    }
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t task) {
+    fake_tasks_deleted++;
+}
+
+void vTaskDelay(TickType_t ticks) {
+    fake_tick += ticks;
+    if (fake_task_running && --fake_task_cycles == 0) {
+        longjmp(fake_task_exit, 1);
+    }
+}
+
+void vTaskPrioritySet(TaskHandle_t task, UBaseType_t priority) {
+    fake_task_priority = priority;
+}
+
+TimerHandle_t xTimerCreate(const char* name, TickType_t period, UBaseType_t reload, void* id,
+                           TimerCallbackFunction_t callback) {
+    fake_timer_t* timer = calloc(1, sizeof(fake_timer_t));
+
+    timer->period = period;
+    timer->reload = reload;
+    timer->callback = callback;
+    return timer;
+}
+
+// A timer command waits for room in the full command queue until it times out, a wait without timeout never ends.
+static BaseType_t fake_timer_command(TickType_t wait) {
+    if (!fake_timer_queue_full) {
+        return pdPASS;
+    }
+    if (wait == portMAX_DELAY) {
+        abort();
+    }
+    fake_tick += wait;
+    return pdFAIL;
+}
+
+BaseType_t xTimerReset(TimerHandle_t handle, TickType_t wait) {
+    fake_timer_t* timer = handle;
+
+    if (fake_timer_command(wait) != pdPASS) {
+        return pdFAIL;
+    }
+    timer->active = 1;
+    timer->expiry = fake_tick + timer->period;
+    return pdPASS;
+}
+
+BaseType_t xTimerStop(TimerHandle_t handle, TickType_t wait) {
+    if (fake_timer_command(wait) != pdPASS) {
+        return pdFAIL;
+    }
+    ((fake_timer_t*)handle)->active = 0;
+    return pdPASS;
+}
+
+BaseType_t xTimerChangePeriod(TimerHandle_t handle, TickType_t period, TickType_t wait) {
+    // Like the kernel, changing the period starts the timer.
+    if (fake_timer_command(wait) != pdPASS) {
+        return pdFAIL;
+    }
+    ((fake_timer_t*)handle)->period = period;
+    return xTimerReset(handle, wait);
+}
+
+BaseType_t xTimerIsTimerActive(TimerHandle_t handle) {
+    fake_timer_t* timer = handle;
+
+    // Expire the timer lazily, when it is looked at.
+    while (timer->active && (TickType_t)(fake_tick - timer->expiry) < (TickType_t)0x80000000UL) {
+        timer->active = timer->reload ? 1 : 0;
+        timer->expiry += timer->period;
+        if (timer->callback != NULL) {
+            timer->callback(handle);
+        }
+    }
+    return timer->active ? pdTRUE : pdFALSE;
+}
+
+EventGroupHandle_t xEventGroupCreate(void) {
+    return calloc(1, sizeof(EventBits_t));
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits) {
+    return *(EventBits_t*)group |= bits;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits) {
+    EventBits_t previous = *(EventBits_t*)group;
+
+    *(EventBits_t*)group &= ~bits;
+    return previous;
+}
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t group) {
+    return *(EventBits_t*)group;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size) {
+    fake_queue_t* queue = calloc(1, sizeof(fake_queue_t));
+
+    queue->items = calloc(length, item_size);
+    queue->length = length;
+    queue->item_size = item_size;
+    return queue;
+}
+
+BaseType_t xQueueSend(QueueHandle_t handle, const void* item, TickType_t wait) {
+    fake_queue_t* queue = handle;
+
+    if (queue->count == queue->length) {
+        return errQUEUE_FULL;
+    }
+    memcpy(queue->items + ((queue->head + queue->count) % queue->length) * queue->item_size, item,
+           queue->item_size);
+    queue->count++;
+#if (configUSE_QUEUE_SETS == 1)
+    if (queue->set != NULL) {
+        xQueueSend(queue->set, &handle, 0);
+    }
+#endif
+    return pdPASS;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t handle, void* item, TickType_t wait) {
+    fake_queue_t* queue = handle;
+
+    if (queue->count == 0) {
+        return pdFALSE;
+    }
+    memcpy(item, queue->items + queue->head * queue->item_size, queue->item_size);
+    queue->head = (queue->head + 1) % queue->length;
+    queue->count--;
+    return pdTRUE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t handle) {
+    return ((fake_queue_t*)handle)->count;
+}
+
+#if (configUSE_QUEUE_SETS == 1)
+// A queue set is a queue of the members that received an item, one entry per item like in FreeRTOS.
+QueueSetHandle_t xQueueCreateSet(UBaseType_t length) {
+    return xQueueCreate(length, sizeof(QueueSetMemberHandle_t));
+}
+
+// A member must be empty and can belong to a single set.
+BaseType_t xQueueAddToSet(QueueSetMemberHandle_t member, QueueSetHandle_t set) {
+    fake_queue_t* queue = member;
+
+    if (queue->set != NULL || queue->count != 0) {
+        return pdFAIL;
+    }
+    queue->set = set;
+    return pdPASS;
+}
+
+// Nothing else runs while the test waits, an empty set returns NULL right away.
+QueueSetMemberHandle_t xQueueSelectFromSet(QueueSetHandle_t set, TickType_t wait) {
+    QueueSetMemberHandle_t member;
+
+    return xQueueReceive(set, &member, 0) == pdTRUE ? member : NULL;
+}
+#endif
@@ -0,0 +1,33 @@
+#ifndef MATRIX_KEYPAD_TEST_FREERTOS_FAKE_H
+#define MATRIX_KEYPAD_TEST_FREERTOS_FAKE_H
+
+#include <FreeRTOS.h>
+#include <task.h>
+
+/**
+ * Single threaded stand-in of the FreeRTOS kernel objects used by keypad.c.
+ *
+ * Nothing runs on its own: tasks are recorded but never started, the test runs the keypad task with fake_task_run
+ * or calls its functions. Time only moves with fake_tick_advance and vTaskDelay, timers expire once the tick count
+ * reaches their expiry, queues are plain ring buffers and event groups plain bit sets. With configUSE_QUEUE_SETS,
+ * a queue set is a queue of the members that received an item.
+ */
+
+// Advances the tick count returned by xTaskGetTickCount.
+void fake_tick_advance(TickType_t ticks);
+
+// Runs a task function until it called vTaskDelay CYCLES times, then returns to the caller. The task function is
+// left where it waits, calling fake_task_run again starts it over.
+void fake_task_run(TaskFunction_t code, void* param, uint32_t cycles);
+
+// Number of tasks created by xTaskCreate and deleted by vTaskDelete.
+extern uint32_t fake_tasks_created;
+extern uint32_t fake_tasks_deleted;
+
+// Priority of the last task created, changed by vTaskPrioritySet.
+extern UBaseType_t fake_task_priority;
+
+// Whether the timer command queue is full: timer commands then wait for their whole timeout and fail.
+extern uint8_t fake_timer_queue_full;
+
+#endif
@@ -0,0 +1,93 @@
+/**
+ * Test of the AMP event channel between two processes: the parent produces, a forked child consumes from the
+ * same MAP_SHARED mapping and waits on an eventfd as doorbell. A doorbell skipped while the consumer waits for it
+ * shows up as a poll timeout, an event lost or reordered as a wrong value.
+ */
+#include <poll.h>
+#include <stdint.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <keypad_amp.h>
+#include "keypad_test.h"
+
+#define EVENTS 200000
+
+// Time the consumer waits for a doorbell before it reports a lost one, in ms.
+#define DOORBELL_TIMEOUT_MS 2000
+
+static int doorbell_fd;
+
+// Doorbell hook of the producer, one eventfd write per ring.
+static void doorbell(void* ctx) {
+    uint64_t value = 1;
+
+    (void)ctx;
+    if (write(doorbell_fd, &value, sizeof(value)) != sizeof(value)) {
+        perror("doorbell");
+    }
+}
+
+// Consumer process, returns its exit status.
+static int consume(keypad_amp_channel_t* channel) {
+    struct pollfd fd = {doorbell_fd, POLLIN, 0};
+    uint32_t expected = 0;
+    uint32_t event;
+    uint64_t value;
+
+    while (!keypad_amp_rx_ready(channel)) {
+    }
+    while (expected < EVENTS) {
+        // Drain the ring, then wait for the doorbell of the next burst.
+        while (keypad_amp_rx_pop(channel, &event)) {
+            if (event != expected) {
+                fprintf(stderr, "event %u received, %u expected\n", event, expected);
+                return 1;
+            }
+            expected++;
+        }
+        if (expected == EVENTS) {
+            break;
+        }
+        if (poll(&fd, 1, DOORBELL_TIMEOUT_MS) != 1) {
+            fprintf(stderr, "no doorbell after event %u\n", expected);
+            return 1;
+        }
+        if (read(doorbell_fd, &value, sizeof(value)) != sizeof(value)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int main(void) {
+    keypad_amp_channel_t* channel;
+    keypad_amp_tx_t tx;
+    uint32_t event = 0;
+    int status;
+    pid_t child;
+
+    channel = mmap(NULL, sizeof(*channel), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    doorbell_fd = eventfd(0, 0);
+    CHECK(channel != MAP_FAILED && doorbell_fd >= 0);
+
+    child = fork();
+    if (child == 0) {
+        _exit(consume(channel));
+    }
+
+    // Produce every event, retrying while the ring is full.
+    keypad_amp_tx_init(&tx, channel, doorbell, NULL);
+    while (event < EVENTS) {
+        if (keypad_amp_tx_push(&tx, event) == 0) {
+            event++;
+        }
+    }
+
+    CHECK(waitpid(child, &status, 0) == child);
+    CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    CHECK(channel->head == EVENTS && channel->tail == EVENTS);
+    printf("%s keypad_amp\n", keypad_test_failures ? "FAIL" : "ok  ");
+    return keypad_test_failures != 0;
+}
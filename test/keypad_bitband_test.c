@@ -0,0 +1,39 @@
+#include "../src/keypad_config.h"
+#include "keypad_test.h"
+
+/**
+ * Host check of the register and bit-band alias addresses of the GD32 configuration in src/keypad_config.h,
+ * against addresses worked out from the GD32F10x memory map: the alias of bit B of a peripheral register at
+ * address R is 0x42000000 + (R - 0x40000000) * 32 + B * 4.
+ */
+
+// Address of a register or alias word.
+#define ADDRESS(PTR) ((uintptr_t)(PTR))
+
+int main(void) {
+    size_t i;
+
+    // OCTL of GPIOA at 0x4001080C, ISTAT of GPIOC at 0x40011008.
+    CHECK(KEYPAD_GPIO_OUT_REG(GPIOA) == 0x4001080CUL);
+    CHECK(KEYPAD_GPIO_IN_REG(GPIOC) == 0x40011008UL);
+    CHECK(ADDRESS(KEYPAD_BITBAND_ALIAS(KEYPAD_GPIO_OUT_REG(GPIOA), 0)) == 0x42210180UL);
+    CHECK(ADDRESS(KEYPAD_BITBAND_ALIAS(KEYPAD_GPIO_OUT_REG(GPIOA), 5)) == 0x42210194UL);
+    CHECK(ADDRESS(KEYPAD_BITBAND_ALIAS(KEYPAD_GPIO_IN_REG(GPIOC), 9)) == 0x42220124UL);
+    CHECK(ADDRESS(KEYPAD_BITBAND_ALIAS(KEYPAD_GPIO_OUT_REG(GPIOG), 15)) == 0x422401BCUL);
+
+    // CTL0 holds the mode bits of pins 0 to 7, CTL1 those of pins 8 to 15.
+    CHECK(ADDRESS(KEYPAD_GPIO_MODE_REG(GPIOA, 7)) == 0x40010800UL);
+    CHECK(ADDRESS(KEYPAD_GPIO_MODE_REG(GPIOA, 9)) == 0x40010804UL);
+    CHECK(KEYPAD_GPIO_MODE_SHIFT(9) == 4);
+
+    // The pins of the example layout sit in the GPIO region of KEYPAD_MPU.
+    for (i = 0; i < sizeof(KEYPAD_ROW_GPIO) / sizeof(KEYPAD_ROW_GPIO[0]); i++) {
+        CHECK(KEYPAD_ROW_GPIO[i].port - KEYPAD_MPU_GPIO_BASE < KEYPAD_MPU_GPIO_SIZE);
+    }
+    for (i = 0; i < sizeof(KEYPAD_COL_GPIO) / sizeof(KEYPAD_COL_GPIO[0]); i++) {
+        CHECK(KEYPAD_COL_GPIO[i].port - KEYPAD_MPU_GPIO_BASE < KEYPAD_MPU_GPIO_SIZE);
+    }
+
+    printf("%s keypad_bitband\n", keypad_test_failures ? "FAIL" : "ok  ");
+    return keypad_test_failures != 0;
+}
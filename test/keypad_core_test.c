@@ -0,0 +1,863 @@
+/**
+ * Tests of the keypad task of keypad.c, run on the fake kernel with the simulated keypad of config/keypad_config.h.
+ */
+#include <assert.h>
+#include <string.h>
+#define configASSERT(COND) assert(COND)
+#include "../src/keypad.c"
+#include "freertos_fake.h"
+#include "keypad_test.h"
+
+// Consumer of the queue of the first keypad, the only reader of the queue.
+static keypad_consumer_t consumer;
+
+// Runs the keypad task for the given number of scan cycles.
+static void run_cycles(uint32_t cycles) {
+    fake_task_run(keypad_read, NULL, cycles);
+}
+
+// Holds keys on the first keypad until they are debounced, then releases them for one cycle.
+static void press(uint32_t keys) {
+    keypad_sim_keys[0] = keys;
+    run_cycles(keypads[0].debounce_time / keypad_task_delay + 2);
+    keypad_sim_keys[0] = 0;
+    run_cycles(1);
+}
+
+// Receives the queued events of the first keypad, returns their number and the last one in event. The
+// announcements of KEYPAD_SPECULATIVE_EVENTS are received but not counted, test_speculative checks them.
+static uint32_t drain(uint32_t* event) {
+    uint32_t count = 0;
+    uint32_t received;
+
+    while (keypad_event_receive(&consumer, &received, 0) == pdPASS) {
+#if KEYPAD_SPECULATIVE_EVENTS
+        if (KEY_EVENT_KIND(received) >= KEY_TENTATIVE && KEY_EVENT_KIND(received) <= KEY_CANCEL) {
+            continue;
+        }
+#endif
+        *event = received;
+        count++;
+    }
+    return count;
+}
+
+#if (KEYPAD_SEQUENCE_DETECT || KEYPAD_SPECULATIVE_EVENTS || (KEYPAD_PRESENCE_DETECT != KEYPAD_PRESENCE_NONE))
+// Receives all queued events of the first keypad into events, returns their number.
+static uint32_t collect(uint32_t* events, uint32_t max) {
+    uint32_t count = 0;
+    uint32_t event;
+
+    while (keypad_event_receive(&consumer, &event, 0) == pdPASS) {
+        if (count < max) {
+            events[count] = event;
+        }
+        count++;
+    }
+    return count;
+}
+#endif
+
+#if ((KEYPAD_DEBOUNCE_MODE != KEYPAD_DEBOUNCE_EAGER) && !KEYPAD_EDGE_TIMESTAMPS)
+// A timing change keeps a running debounce running and leaves a dormant debounce timer dormant.
+static void test_timing_change(void) {
+    keypad_t* kp = &keypads[0];
+    uint32_t event;
+
+    keypad_set_timing(KEYPAD_MS_TO_TICKS(KEYPAD_TASK_DELAY_MS), KEYPAD_MS_TO_TICKS(100));
+    run_cycles(1);
+    CHECK(kp->debounce_time == KEYPAD_MS_TO_TICKS(100));
+    CHECK(!xTimerIsTimerActive(kp->timer_debounce));
+
+    // Press a key, the debounce starts, and change the timing while it runs.
+    keypad_sim_keys[0] = KEY_5;
+    run_cycles(1);
+    CHECK(xTimerIsTimerActive(kp->timer_debounce));
+    keypad_set_timing(KEYPAD_MS_TO_TICKS(KEYPAD_TASK_DELAY_MS), KEYPAD_MS_TO_TICKS(200));
+    run_cycles(1);
+    CHECK(xTimerIsTimerActive(kp->timer_debounce));
+
+    // Released before the new debounce time passed, the bounce is not reported.
+    keypad_sim_keys[0] = 0;
+    run_cycles(2);
+    CHECK(drain(&event) == 0);
+
+    // Held for the new debounce time, the press is reported on release.
+    press(KEY_5);
+    CHECK(drain(&event) == 1 && event == KEY_5);
+}
+#endif
+
+// Keys beyond the lower keys of the keypad are published in a second event word instead of being dropped.
+static void test_upper_keys(void) {
+    keypad_t* kp = &keypads[0];
+    uint32_t event;
+
+    keypad_publish(kp, KEY_EVENT_KEY, (1UL << 31) | KEY_1);
+    CHECK(keypad_event_receive(&consumer, &event, 0) == pdPASS && event == KEY_1);
+    CHECK(keypad_event_receive(&consumer, &event, 0) == pdPASS);
+    CHECK(event == (KEY_EVENT_UPPER | (1UL << (31 - kp->upper_shift))));
+    CHECK(drain(&event) == 0);
+    keypad_publish(kp, KEY_EVENT_KEY, 1UL << 31);
+    CHECK(drain(&event) == 1 && KEY_EVENT_BASE_KIND(event) == KEY_EVENT_KEY && (event & KEY_EVENT_UPPER));
+    xEventGroupClearBits(kp->pulse_groups[0], KEY_EVENT_BITMASK);
+
+#if KEYPAD_BIDIRECTIONAL
+    // Reverse keys arrive in the upper word at the position of their forward key.
+    CHECK(kp->upper_shift == 16);
+    press(KEY_1 | KEY_REVERSE_HELD(KEY_5));
+    CHECK(drain(&event) == 2 && event == KEY_REVERSE(KEY_5));
+    CHECK(KEY_REVERSE(KEY_1) != KEY_LONG && KEY_EVENT_KEYS(KEY_REVERSE(KEY_ENTER)) == KEY_ENTER);
+#endif
+}
+
+#if KEYPAD_CHARLIEPLEX
+// The mode images computed at init switch each pin alone, every pass drives one pin and senses the others.
+static void test_charlieplex(void) {
+    keypad_charlie_pin_t* image;
+    uint32_t event;
+    uint8_t pin;
+
+    CHECK(keypads[0].row_count == KEYPAD_SIM_CHARLIE_PINS && keypads[0].col_count == KEYPAD_SIM_CHARLIE_PINS - 1);
+    for (pin = 0; pin < KEYPAD_SIM_CHARLIE_PINS; pin++) {
+        image = &keypad_charlie_pins[0][pin];
+        CHECK(image->reg == &keypad_sim_mode[0][0]);
+        CHECK(image->mask == 0xFUL << (4 * pin));
+        CHECK(image->drive == (uint32_t)KEYPAD_GPIO_MODE_OUT_OD << (4 * pin));
+        CHECK(image->sense == (uint32_t)KEYPAD_GPIO_MODE_IPU << (4 * pin));
+    }
+
+    // Between scans every pin senses with its pull-up and none drives.
+    run_cycles(1);
+    CHECK(keypad_sim_mode[0][0] == 0x88888);
+    CHECK(keypad_charlie_drive[0] == KEYPAD_SIM_CHARLIE_PINS);
+
+    // Pin 2 driving reads pin 4 as its fourth column, pin 4 driving reads pin 0 as its first.
+    press(1UL << (2 * 4 + 3));
+    CHECK(drain(&event) == 1 && event == 1UL << (2 * 4 + 3));
+    press((1UL << (4 * 4)) | (1UL << 1));
+    CHECK(drain(&event) == 1 && event == ((1UL << (4 * 4)) | (1UL << 1)));
+}
+#endif
+
+#if KEYPAD_MUX
+// The channels are read in a Gray order, one select line changes per step, also between rows and scans.
+static void test_mux(void) {
+    static const uint8_t order[KEYPAD_SIM_MUX_CHANNELS] = {5, 4, 0, 1, 3, 2};
+    uint32_t event, bits, i;
+
+    CHECK(memcmp(keypad_mux_order[0], order, sizeof(order)) == 0);
+
+    // 4 rows of 6 channels, 5 changes per row.
+    keypad_sim_mux_read_count = 0;
+    keypad_sim_mux_changes = 0;
+    run_cycles(1);
+    CHECK(keypad_sim_mux_read_count == 4 * KEYPAD_SIM_MUX_CHANNELS);
+    CHECK(keypad_sim_mux_changes == 4 * (KEYPAD_SIM_MUX_CHANNELS - 1));
+    for (i = 1; i < keypad_sim_mux_read_count; i++) {
+        bits = keypad_sim_mux_reads[i] ^ keypad_sim_mux_reads[i - 1];
+        CHECK((bits & (bits - 1)) == 0);
+    }
+
+    // Row 2 reads channel 3 as its fourth column.
+    press(1UL << (2 * KEYPAD_SIM_MUX_CHANNELS + 3));
+    CHECK(drain(&event) == 1 && event == 1UL << (2 * KEYPAD_SIM_MUX_CHANNELS + 3));
+}
+#endif
+
+#if (KEYPAD_WATCHDOG && (KEYPAD_WATCHDOG_RECOVER_MS > 0))
+// Last KEY_STATE event of the lower keys passed to the callbacks.
+static uint32_t state_event;
+
+static void record_state(const keypad_t* kp, uint32_t event, void* ctx) {
+    (void)kp;
+    (void)ctx;
+    if (KEY_EVENT_BASE_KIND(event) == KEY_STATE && !(event & KEY_EVENT_UPPER)) {
+        state_event = event;
+    }
+}
+
+// A stalled task is restarted with its held keys released and its lines forward, backing off while it stays stuck.
+static void test_watchdog(void) {
+    const TickType_t recover = KEYPAD_MS_TO_TICKS(KEYPAD_WATCHDOG_RECOVER_MS);
+    keypad_t* kp = &keypads[0];
+    uint32_t created = fake_tasks_created;
+    uint32_t deleted = fake_tasks_deleted;
+    keypad_stall_t stall;
+    uint32_t beats;
+    uint32_t event;
+
+    CHECK(keypad_register_callback(record_state, NULL) == pdPASS);
+
+    // Stalled with a key held and a second one debounced at the boosted priority, in the middle of a reverse pass.
+    keypad_sim_keys[0] = KEY_5;
+    run_cycles(kp->debounce_time / keypad_task_delay + 2);
+    CHECK(kp->keys_held == KEY_5);
+    keypad_sim_keys[0] = KEY_5 | KEY_6;
+    keypad_stats.boost_ticks = 0;
+    run_cycles(1);
+    CHECK(keypad_boosted);
+    keypad_orient(1);
+    fake_tick_advance(recover + 1);
+    CHECK(keypad_watchdog_check(&stall) == pdFAIL && stall.recovered);
+    CHECK(keypad_stats.boost_ticks > recover);
+    CHECK(fake_tasks_deleted == deleted + 1 && fake_tasks_created == created + 1);
+    CHECK(kp->keys_held == KEY_NONE && state_event == KEY_STATE);
+    CHECK(xEventGroupGetBits(kp->held_groups[0]) == 0);
+    CHECK(keypad_reversed == 0);
+
+    // Still stuck, the next restart waits twice as long.
+    fake_tick_advance(recover + 1);
+    CHECK(keypad_watchdog_check(&stall) == pdFAIL && !stall.recovered);
+    fake_tick_advance(recover);
+    CHECK(keypad_watchdog_check(&stall) == pdFAIL && stall.recovered);
+
+    // A completed cycle ends the back-off.
+    keypad_sim_keys[0] = 0;
+    run_cycles(kp->debounce_time / keypad_task_delay + 2);
+    drain(&event);
+
+    // A debounce timer command that times out on the full timer queue is a fault, the task stops publishing its
+    // heartbeat and is restarted instead of waiting forever.
+    fake_timer_queue_full = 1;
+    keypad_stats.timer_faults = 0;
+    keypad_sim_keys[0] = KEY_1;
+    run_cycles(1);
+    CHECK(keypad_stats.timer_faults >= 1 && keypad_heartbeat.timer_wait);
+    beats = keypad_heartbeat.count;
+    run_cycles(3);
+    CHECK(keypad_heartbeat.count == beats);
+    fake_timer_queue_full = 0;
+    keypad_sim_keys[0] = 0;
+    fake_tick_advance(recover + 1);
+    CHECK(keypad_watchdog_check(&stall) == pdFAIL && stall.recovered && stall.recoveries == 3);
+    CHECK(!keypad_heartbeat.timer_wait);
+
+    // The restarted task scans forward again.
+    press(KEY_1);
+    CHECK(drain(&event) == 1 && event == KEY_1);
+}
+#endif
+
+#if (KEYPAD_PRESENCE_DETECT != KEYPAD_PRESENCE_NONE)
+// An unplugged keypad is released and reported removed, the task then only wakes up to probe it until it is back.
+static void test_presence(void) {
+    const TickType_t probe = KEYPAD_MS_TO_TICKS(KEYPAD_PRESENCE_PROBE_MS);
+    keypad_t* kp = &keypads[0];
+    uint32_t events[2];
+    TickType_t tick;
+    uint32_t reads;
+    uint32_t event;
+
+    // Unplugged with a key held, right when a line signature probe is due, so both modes see it on the next cycle
+    // and confirm it on the one after. The scan of that next cycle already reads the key released and reports it.
+    drain(&event);
+    keypad_sim_keys[0] = KEY_1;
+    run_cycles(kp->debounce_time / keypad_task_delay + 2);
+    CHECK(kp->keys_held == KEY_1);
+    kp->tick_probe = xTaskGetTickCount() - probe;
+    keypad_sim_unplugged[0] = 1;
+    run_cycles(2);
+    CHECK(collect(events, 2) == 2 && events[0] == KEY_1 && events[1] == KEY_REMOVED);
+    CHECK(!kp->present && kp->keys_held == KEY_NONE && kp->keys_pressed == KEY_NONE);
+    CHECK(xEventGroupGetBits(kp->held_groups[0]) == 0);
+
+    // Without an attached keypad the scans pause, every cycle is a probe. Only the line signature reads the columns.
+    tick = xTaskGetTickCount();
+    reads = keypad_sim_col_reads[0];
+    run_cycles(3);
+    CHECK((TickType_t)(xTaskGetTickCount() - tick) == 3 * probe);
+#if (KEYPAD_PRESENCE_DETECT == KEYPAD_PRESENCE_PIN)
+    CHECK(keypad_sim_col_reads[0] == reads);
+#else
+    CHECK(keypad_sim_col_reads[0] == reads + 3 * kp->col_count);
+#endif
+    CHECK(drain(&event) == 0);
+
+    // Plugged back in with the key let go, the next probe sees it, the following cycle confirms it and the scans
+    // resume.
+    keypad_sim_keys[0] = 0;
+    keypad_sim_unplugged[0] = 0;
+    run_cycles(2);
+    CHECK(drain(&event) == 1 && event == KEY_ATTACHED);
+    CHECK(kp->present);
+    tick = xTaskGetTickCount();
+    run_cycles(1);
+    CHECK((TickType_t)(xTaskGetTickCount() - tick) == keypad_task_delay);
+    press(KEY_2);
+    CHECK(drain(&event) == 1 && event == KEY_2);
+}
+#endif
+
+#if (configUSE_QUEUE_SETS == 1)
+// A consumer blocked on a queue set holding the keypad queue and the queue of another source wakes up for both,
+// keypad_event_select only takes and decodes the keypad events.
+static void test_queue_set(void) {
+    QueueSetMemberHandle_t member;
+    keypad_event_t selected;
+    QueueSetHandle_t set;
+    QueueHandle_t other;
+    uint32_t item;
+    uint32_t event;
+
+    drain(&event);
+    other = xQueueCreate(4, sizeof(uint32_t));
+    set = xQueueCreateSet(keypad_queue_set_length() + 4);
+    CHECK(keypad_queue_set_add(set) == pdPASS);
+    CHECK(xQueueAddToSet(other, set) == pdPASS);
+    CHECK(xQueueSelectFromSet(set, 0) == NULL);
+
+    // A queue belongs to a single set.
+    CHECK(keypad_queue_set_add(set) == pdFAIL);
+
+    // The other source posts first, then a key is pressed.
+    item = 0x1234;
+    CHECK(xQueueSend(other, &item, 0) == pdPASS);
+    press(KEY_3);
+
+    member = xQueueSelectFromSet(set, portMAX_DELAY);
+    CHECK(member == other);
+    CHECK(keypad_event_select(&consumer, 1, member, &selected) == pdFAIL);
+    CHECK(xQueueReceive(member, &item, 0) == pdTRUE && item == 0x1234);
+
+    member = xQueueSelectFromSet(set, portMAX_DELAY);
+    CHECK(member == keypads[0].queue);
+    CHECK(keypad_event_select(&consumer, 1, member, &selected) == pdPASS);
+    CHECK(selected.consumer == &consumer && selected.index == 0);
+    CHECK(selected.kind == KEY_EVENT_KEY && selected.keys == KEY_3);
+    CHECK(xQueueSelectFromSet(set, 0) == NULL && drain(&event) == 0);
+}
+#endif
+
+#if (KEYPAD_TEST_COLUMNS > 4)
+// Keys of a 32 key matrix past KEYPAD_EVENT_GROUP_BITS land in the second shard of the event groups and in the
+// upper event word.
+static void test_shards(void) {
+    const uint32_t key = 1UL << (3 * KEYPAD_TEST_COLUMNS + 5);
+    keypad_t* kp = &keypads[0];
+    uint32_t event;
+
+    CHECK(kp->pulse_groups[1] != NULL && kp->held_groups[1] != NULL);
+    drain(&event);
+    xEventGroupClearBits(kp->pulse_groups[0], KEY_EVENT_BITMASK);
+    xEventGroupClearBits(kp->pulse_groups[1], KEY_EVENT_BITMASK);
+
+    // Held, each key sets the held bit of its own shard, nothing is pulsed before the release.
+    keypad_sim_keys[0] = KEY_1 | key;
+    run_cycles(kp->debounce_time / keypad_task_delay + 2);
+    CHECK(kp->keys_held == (KEY_1 | key));
+    CHECK(xEventGroupGetBits(kp->held_groups[0]) == KEY_1);
+    CHECK(xEventGroupGetBits(kp->held_groups[1]) == KEYPAD_EVENT_GROUP_KEYS(key, 1));
+    CHECK(xEventGroupGetBits(kp->pulse_groups[1]) == 0);
+
+    // Released, both shards are pulsed, the held bits clear once the release is debounced.
+    keypad_sim_keys[0] = 0;
+    run_cycles(1);
+    CHECK((xEventGroupGetBits(kp->pulse_groups[0]) & KEY_EVENT_BITMASK) == KEY_1);
+    CHECK(xEventGroupGetBits(kp->pulse_groups[1]) == KEYPAD_EVENT_GROUP_KEYS(key, 1));
+    CHECK(drain(&event) == 2 && event == (KEY_EVENT_UPPER | (key >> kp->upper_shift)));
+    run_cycles(kp->debounce_time / keypad_task_delay + 2);
+    CHECK(xEventGroupGetBits(kp->held_groups[0]) == 0 && xEventGroupGetBits(kp->held_groups[1]) == 0);
+    xEventGroupClearBits(kp->pulse_groups[0], KEY_EVENT_BITMASK);
+    xEventGroupClearBits(kp->pulse_groups[1], KEY_EVENT_BITMASK);
+}
+#endif
+
+#if (KEYPAD_TEST_ROW_DIVIDER > 1)
+// The last row is only sampled every KEYPAD_TEST_ROW_DIVIDER cycles, and the debounce time is stretched so it
+// spans two of its samples.
+static void test_row_divider(void) {
+    keypad_t* kp = &keypads[0];
+    uint32_t cycles;
+    uint32_t event;
+
+    CHECK(kp->debounce_time == 2 * KEYPAD_TEST_ROW_DIVIDER * keypad_task_delay);
+    CHECK(kp->debounce_time > KEYPAD_MS_TO_TICKS(KEYPAD_DEBOUNCE_MS));
+
+    // A key of the first row is seen on the next cycle, one of the last row on the next cycle sampling it.
+    keypad_sim_keys[0] = KEY_1 | KEY_STAR;
+    run_cycles(1);
+    CHECK(kp->keys_pressed & KEY_1);
+    for (cycles = 1; !(kp->keys_pressed & KEY_STAR) && cycles <= KEYPAD_TEST_ROW_DIVIDER; cycles++) {
+        run_cycles(1);
+    }
+    CHECK(kp->keys_pressed & KEY_STAR);
+
+    // Released right after that sample, the last row keeps reading pressed until its next sample.
+    keypad_sim_keys[0] = 0;
+    run_cycles(1);
+    CHECK(!(kp->keys_pressed & KEY_1));
+    for (cycles = 1; (kp->keys_pressed & KEY_STAR) && cycles <= KEYPAD_TEST_ROW_DIVIDER; cycles++) {
+        run_cycles(1);
+    }
+    CHECK(cycles == KEYPAD_TEST_ROW_DIVIDER && !(kp->keys_pressed & KEY_STAR));
+    run_cycles(kp->debounce_time / keypad_task_delay + 2);
+    drain(&event);
+
+    // Held longer than KEYPAD_DEBOUNCE_MS but shorter than the stretched time, a key is not reported.
+    keypad_sim_keys[0] = KEY_1;
+    run_cycles((KEYPAD_MS_TO_TICKS(KEYPAD_DEBOUNCE_MS) + kp->debounce_time) / 2 / keypad_task_delay);
+    keypad_sim_keys[0] = 0;
+    run_cycles(1);
+    CHECK(drain(&event) == 0);
+    run_cycles(kp->debounce_time / keypad_task_delay + 2);
+    press(KEY_1);
+    CHECK(drain(&event) == 1 && event == KEY_1);
+}
+#endif
+
+#if KEYPAD_EDGE_TIMESTAMPS
+// The column edges recorded by keypad_edge_isr between two scans extend the debounce of the pressed keys, the
+// task wakes up right when they settled, and a full ring counts as an edge seen when it is drained.
+static void test_edges(void) {
+    const uint32_t settle = KEYPAD_EDGE_SETTLE_US * (KEYPAD_EDGE_CLOCK_HZ / 1000000UL);
+    keypad_edge_ring_t* ring = &keypad_edge_rings[0][1];
+    uint32_t edge, head, i;
+    uint32_t event;
+
+    // Edges are ignored while the rows are released and for the guard time after they were driven again.
+    head = ring->head;
+    keypad_edge_arm(0);
+    keypad_edge_isr(0, 1);
+    keypad_edge_arm(1);
+    keypad_edge_isr(0, 1);
+    CHECK(ring->head == head);
+
+    // A press of key 5 on column 1 starts the debounce, a bounce recorded before the next scan is queued with
+    // its timestamp.
+    drain(&event);
+    keypad_sim_keys[0] = KEY_5;
+    run_cycles(1);
+    CHECK(!keypad_edge_stable[0]);
+    edge = KEYPAD_EDGE_CLOCK();
+    keypad_edge_isr(0, 1);
+    CHECK(ring->head == (head + 1) % KEYPAD_EDGE_RING_SIZE && ring->stamp[head] == edge);
+
+    // The next scan drains it, the keys settle KEYPAD_EDGE_SETTLE_US after it, and the last wait is shortened to
+    // wake up right then.
+    fake_tick_advance(2);
+    run_cycles(1);
+    CHECK(ring->tail == ring->head && keypad_edge_last[0] == edge && !keypad_edge_stable[0]);
+    while (KEYPAD_EDGE_CLOCK() - edge < settle) {
+        run_cycles(1);
+        CHECK(!keypad_edge_stable[0] || KEYPAD_EDGE_CLOCK() - edge >= settle);
+    }
+    CHECK(KEYPAD_EDGE_CLOCK() - edge == settle);
+    run_cycles(1);
+    CHECK(keypad_edge_stable[0]);
+
+    // Edges of settled keys no longer extend their debounce.
+    keypad_edge_isr(0, 1);
+    run_cycles(1);
+    CHECK(keypad_edge_stable[0] && keypad_edge_last[0] == edge);
+
+    // Released and pressed again, edges beyond the ring size are dropped and counted, the drain takes the
+    // overflow as an edge seen at the scan.
+    keypad_sim_keys[0] = 0;
+    run_cycles(1);
+    CHECK(drain(&event) == 1 && event == KEY_5);
+    keypad_sim_keys[0] = KEY_5;
+    run_cycles(1);
+    head = ring->head;
+    for (i = 0; i < KEYPAD_EDGE_RING_SIZE; i++) {
+        keypad_edge_isr(0, 1);
+    }
+    CHECK(ring->overflow == 1 && (ring->head + 1) % KEYPAD_EDGE_RING_SIZE == ring->tail);
+    fake_tick_advance(2);
+    edge = KEYPAD_EDGE_CLOCK();
+    run_cycles(1);
+    CHECK(ring->tail == ring->head && keypad_edge_overflow[0][1] == 1);
+    CHECK(keypad_edge_last[0] == edge && !keypad_edge_stable[0]);
+
+    // The press is still reported once it settled.
+    press(KEY_5);
+    CHECK(drain(&event) == 1 && event == KEY_5);
+}
+#endif
+
+#if (KEYPAD_DEBOUNCE_MODE == KEYPAD_DEBOUNCE_EAGER)
+// A press is reported on its first edge, its bounce is held off and the release is debounced before the key can
+// be reported again.
+static void test_eager(void) {
+    const keypad_t* kp = &keypads[0];
+    uint32_t event;
+
+    run_cycles(kp->debounce_time / keypad_task_delay + 2);
+    drain(&event);
+
+    // Reported on the first scan that sees it, the hold-off window opens.
+    keypad_sim_keys[0] = KEY_5;
+    run_cycles(1);
+    CHECK(drain(&event) == 1 && event == KEY_5);
+    CHECK(xTimerIsTimerActive(kp->timer_holdoff) && kp->keys_held == KEY_5);
+
+    // The bounce inside the hold-off window is dropped.
+    keypad_sim_keys[0] = KEY_NONE;
+    run_cycles(1);
+    keypad_sim_keys[0] = KEY_5;
+    run_cycles(1);
+    CHECK(drain(&event) == 0 && xTimerIsTimerActive(kp->timer_holdoff));
+
+    // After the hold-off, a release that bounces back within the debounce time is the same press.
+    run_cycles(KEYPAD_EAGER_HOLDOFF_MS / KEYPAD_TASK_DELAY_MS + 1);
+    CHECK(!xTimerIsTimerActive(kp->timer_holdoff));
+    keypad_sim_keys[0] = KEY_NONE;
+    run_cycles(1);
+    CHECK(xTimerIsTimerActive(kp->timer_debounce) && kp->keys_held == KEY_5);
+    keypad_sim_keys[0] = KEY_5;
+    run_cycles(1);
+    CHECK(drain(&event) == 0);
+
+    // Released for the whole debounce time, the key is forgotten and reported again on its next press.
+    keypad_sim_keys[0] = KEY_NONE;
+    run_cycles(kp->debounce_time / keypad_task_delay + 2);
+    CHECK(kp->keys_held == KEY_NONE && kp->keys_down == KEY_NONE && drain(&event) == 0);
+    press(KEY_5);
+    CHECK(drain(&event) == 1 && event == KEY_5);
+    run_cycles(kp->debounce_time / keypad_task_delay + 2);
+}
+#endif
+
+#if KEYPAD_SPECULATIVE_EVENTS
+// Presses are announced on their first edge and resolved once the pressed keys settled.
+static void test_speculative(void) {
+    const keypad_t* kp = &keypads[0];
+    uint32_t events[8];
+    uint32_t event;
+    uint32_t i;
+
+    run_cycles(kp->debounce_time / keypad_task_delay + 2);
+    drain(&event);
+
+    // A clean press is announced at once, confirmed after the debounce time and reported on release.
+    keypad_sim_keys[0] = KEY_5;
+    run_cycles(1);
+    CHECK(collect(events, 8) == 1 && events[0] == (KEY_TENTATIVE | KEY_5));
+    run_cycles(kp->debounce_time / keypad_task_delay + 2);
+    CHECK(collect(events, 8) == 1 && events[0] == (KEY_CONFIRM | KEY_5));
+    keypad_sim_keys[0] = KEY_NONE;
+    run_cycles(1);
+    CHECK(collect(events, 8) == 1 && events[0] == KEY_5);
+
+    // A bounce that dies before the debounce time passed is cancelled and not reported.
+    run_cycles(kp->debounce_time / keypad_task_delay + 2);
+    keypad_sim_keys[0] = KEY_6;
+    run_cycles(1);
+    keypad_sim_keys[0] = KEY_NONE;
+    run_cycles(kp->debounce_time / keypad_task_delay + 2);
+    CHECK(collect(events, 8) == 2 && events[0] == (KEY_TENTATIVE | KEY_6) && events[1] == (KEY_CANCEL | KEY_6));
+
+    // Repeated bounces before the contact settles announce the key once, then confirm it.
+    for (i = 0; i < 4; i++) {
+        keypad_sim_keys[0] = KEY_7;
+        run_cycles(1);
+        keypad_sim_keys[0] = KEY_NONE;
+        run_cycles(1);
+    }
+    keypad_sim_keys[0] = KEY_7;
+    run_cycles(kp->debounce_time / keypad_task_delay + 2);
+    CHECK(collect(events, 8) == 2 && events[0] == (KEY_TENTATIVE | KEY_7) && events[1] == (KEY_CONFIRM | KEY_7));
+    keypad_sim_keys[0] = KEY_NONE;
+    run_cycles(1);
+    CHECK(collect(events, 8) == 1 && events[0] == KEY_7);
+}
+#endif
+
+#if KEYPAD_SEQUENCE_DETECT
+// Automaton of the sequences 1 2 3 (ID 0) and 2 1 (ID 1), as keypad::compile_sequences builds it. The symbols
+// are keys 1, 2 and 3, state 1 is "1", 2 "1 2", 3 "1 2 3", 4 "2" and 5 "2 1". The completed states 3 and 5 are
+// left at once, their transitions are never taken.
+static const uint8_t sequence_symbol[32] = {
+    0, 1, 2, KEYPAD_SEQUENCE_NO_SYMBOL, KEYPAD_SEQUENCE_NO_SYMBOL, KEYPAD_SEQUENCE_NO_SYMBOL,
+    KEYPAD_SEQUENCE_NO_SYMBOL, KEYPAD_SEQUENCE_NO_SYMBOL, KEYPAD_SEQUENCE_NO_SYMBOL, KEYPAD_SEQUENCE_NO_SYMBOL,
+    KEYPAD_SEQUENCE_NO_SYMBOL, KEYPAD_SEQUENCE_NO_SYMBOL, KEYPAD_SEQUENCE_NO_SYMBOL, KEYPAD_SEQUENCE_NO_SYMBOL,
+    KEYPAD_SEQUENCE_NO_SYMBOL, KEYPAD_SEQUENCE_NO_SYMBOL};
+static const uint16_t sequence_next[6 * 3] = {1, 4, 0, 1, 2, 0, 5, 4, 3, 1, 4, 0, 5, 4, 0, 1, 4, 0};
+static const uint16_t sequence_match[6] = {0, 0, 0, 1, 0, 2};
+static const keypad_sequence_table_t sequence_table = {sequence_symbol, sequence_next, sequence_match, 3, 6};
+static const keypad_sequence_table_t sequence_table_copy = {sequence_symbol, sequence_next, sequence_match, 3, 6};
+
+// The key events scanned by the keypad task advance the automaton, completed sequences are queued after the key.
+static void test_sequences(void) {
+    uint32_t events[8];
+    uint32_t event;
+
+    // Without a table only the keys are reported.
+    drain(&event);
+    press(KEY_1);
+    press(KEY_2);
+    press(KEY_3);
+    CHECK(collect(events, 8) == 3);
+
+    keypad_set_sequences(&sequence_table);
+    press(KEY_1);
+    press(KEY_2);
+    press(KEY_3);
+    CHECK(collect(events, 8) == 4 && events[2] == KEY_3 && events[3] == (KEY_SEQUENCE | 0));
+
+    // A sequence ending the keys typed so far is found, keys outside all sequences start over.
+    press(KEY_1);
+    press(KEY_2);
+    press(KEY_1);
+    CHECK(collect(events, 8) == 4 && events[3] == (KEY_SEQUENCE | 1));
+    press(KEY_2);
+    press(KEY_4);
+    press(KEY_1);
+    CHECK(collect(events, 8) == 3);
+
+    // A chord is not a symbol, it starts over as well.
+    press(KEY_1);
+    press(KEY_2);
+    press(KEY_1 | KEY_3);
+    press(KEY_3);
+    CHECK(collect(events, 8) == 4 && events[2] == (KEY_1 | KEY_3));
+
+    // A new table starts from its start state, the keys typed with the old one are forgotten.
+    press(KEY_1);
+    press(KEY_2);
+    keypad_set_sequences(&sequence_table_copy);
+    press(KEY_3);
+    CHECK(collect(events, 8) == 3);
+    press(KEY_2);
+    press(KEY_1);
+    CHECK(collect(events, 8) == 3 && events[2] == (KEY_SEQUENCE | 1));
+
+    // Without a table the detection stops.
+    keypad_set_sequences(NULL);
+    press(KEY_2);
+    press(KEY_1);
+    CHECK(collect(events, 8) == 2);
+}
+#endif
+
+// Scans are counted in the histogram bin of their duration.
+static void test_scan_histogram(void) {
+    keypad_stats = (keypad_stats_t){0};
+    keypad_scan_record(KEYPAD_SCAN_HISTOGRAM_US - 1);
+    keypad_scan_record(KEYPAD_SCAN_HISTOGRAM_US);
+    keypad_scan_record(2 * KEYPAD_SCAN_HISTOGRAM_US - 1);
+    keypad_scan_record(2 * KEYPAD_SCAN_HISTOGRAM_US);
+    keypad_scan_record(1000000);
+    CHECK(keypad_stats.scan_count == 5);
+    CHECK(keypad_stats.scan_histogram[0] == 1);
+    CHECK(keypad_stats.scan_histogram[1] == 2);
+    CHECK(keypad_stats.scan_histogram[2] == 1);
+    CHECK(keypad_stats.scan_histogram[KEYPAD_SCAN_HISTOGRAM_BINS - 1] == 1);
+
+    // The keypad task times its scans, 4 rows of KEYPAD_GPIO_STABILIZATION_US each.
+    keypad_stats = (keypad_stats_t){0};
+    run_cycles(1);
+    CHECK(keypad_stats.scan_count == 1);
+    CHECK(keypad_stats.scan_histogram[0] == 0);
+}
+
+// The task is boosted while a press is debounced or its event waits in the queue, not while a key stays held.
+static void test_priority(void) {
+    const keypad_t* kp = &keypads[0];
+    uint32_t event;
+
+    // Let the held state of the previous tests settle.
+    run_cycles(kp->debounce_time / keypad_task_delay + 2);
+    drain(&event);
+    run_cycles(1);
+    CHECK(fake_task_priority == KEYPAD_TASK_PRIORITY);
+    keypad_stats.boost_count = 0;
+    keypad_stats.boost_ticks = 0;
+
+    // The press starts the debounce timer.
+    keypad_sim_keys[0] = KEY_5;
+    run_cycles(1);
+    CHECK(fake_task_priority == KEYPAD_TASK_PRIORITY_BOOST && keypad_stats.boost_count == 1);
+
+    // Debounced, the held state settled and the announcements of speculative mode received, the task drops back
+    // although the key stays held.
+    run_cycles(kp->debounce_time / keypad_task_delay + 2);
+    CHECK(kp->keys_held == KEY_5);
+    drain(&event);
+    run_cycles(1);
+    CHECK(fake_task_priority == KEYPAD_TASK_PRIORITY);
+    CHECK(keypad_stats.boost_count == 1 && keypad_stats.boost_ticks >= kp->debounce_time);
+    CHECK(keypad_stats.boost_ticks <= kp->debounce_time + 3 * keypad_task_delay);
+
+    // A long hold runs at the idle priority.
+    run_cycles(100);
+    CHECK(fake_task_priority == KEYPAD_TASK_PRIORITY && keypad_stats.boost_count == 1);
+
+    // The release reports the key, boosted until it is debounced and received.
+    keypad_sim_keys[0] = KEY_NONE;
+    run_cycles(1);
+    CHECK(fake_task_priority == KEYPAD_TASK_PRIORITY_BOOST && keypad_stats.boost_count == 2);
+    run_cycles(kp->debounce_time / keypad_task_delay + 2);
+#if (KEYPAD_DEBOUNCE_MODE == KEYPAD_DEBOUNCE_EAGER)
+    // Eager mode reported the key on the press, the release is only debounced.
+    CHECK(kp->keys_held == KEY_NONE && drain(&event) == 0);
+#else
+    CHECK(kp->keys_held == KEY_NONE && fake_task_priority == KEYPAD_TASK_PRIORITY_BOOST);
+    CHECK(drain(&event) == 1 && event == KEY_5);
+#endif
+    run_cycles(1);
+    CHECK(fake_task_priority == KEYPAD_TASK_PRIORITY && keypad_stats.boost_count == 2);
+}
+
+#if KEYPAD_LATENCY_TRACKING
+// The emit ring follows the queue of a keypad with its single consumer.
+static void test_single_consumer(void) {
+    static keypad_consumer_t second;
+    uint32_t event;
+
+    CHECK(keypad_consumer_init(&second, 0) == pdFAIL);
+    CHECK(keypad_consumer_init(&consumer, 0) == pdPASS);
+    CHECK(keypad_consumer_init(&second, KEYPAD_INSTANCE_COUNT) == pdFAIL);
+
+    // Two events waiting, received 10 ticks after the second one was emitted.
+    press(KEY_1);
+    press(KEY_2);
+    fake_tick_advance(10 - keypad_task_delay);
+    CHECK(keypad_event_receive(&consumer, &event, 0) == pdPASS && event == KEY_1);
+    CHECK(keypad_event_receive(&consumer, &event, 0) == pdPASS && event == KEY_2);
+    CHECK(consumer.tick_emit == keypad_trace[(keypad_trace_count - 1) % KEYPAD_TRACE_SIZE].tick);
+    CHECK(consumer.receive_histogram[4] == 1);
+    CHECK(keypad_event_receive(&consumer, &event, 0) == pdFAIL);
+}
+#endif
+
+#if KEYPAD_FAULT_INJECTION
+// The fault hooks degrade the scan, the timers, the queue and the scheduling as the profile asks.
+static void test_faults(void) {
+    keypad_fault_profile_t profile = {0};
+    keypad_fault_stats_t stats;
+    uint32_t event, glitches, drops;
+    TickType_t tick;
+
+    // Stuck columns read the same whatever the keys do, here on every row of column 1.
+    profile.stuck_low = 1UL << 1;
+    keypad_fault_set(&profile);
+    run_cycles(1);
+    CHECK(keypads[0].keys_pressed == 0x2222);
+    profile.stuck_low = 0;
+    profile.stuck_high = 1UL << 1;
+    keypad_fault_set(&profile);
+    keypad_sim_keys[0] = KEY_5 | KEY_6;
+    run_cycles(1);
+    CHECK(keypads[0].keys_pressed == KEY_6);
+    keypad_fault_set(NULL);
+    keypad_sim_keys[0] = 0;
+    run_cycles(keypads[0].debounce_time / keypad_task_delay + 2);
+    drain(&event);
+
+    // Glitches come from the seeded generator, the same seed replays the same glitches.
+    profile = (keypad_fault_profile_t){.seed = 1234, .glitch_rate = 4096};
+    keypad_fault_set(&profile);
+    run_cycles(20);
+    keypad_fault_get_stats(&stats);
+    glitches = stats.glitches;
+    keypad_fault_set(&profile);
+    run_cycles(20);
+    keypad_fault_get_stats(&stats);
+    CHECK(glitches > 0 && stats.glitches == glitches);
+    keypad_fault_set(NULL);
+    run_cycles(keypads[0].debounce_time / keypad_task_delay + 2);
+    drain(&event);
+
+    // Without the debounce timer reset, a single bouncing sample is reported as a press.
+    profile = (keypad_fault_profile_t){.seed = 1, .timer_drop_rate = 0xFFFF};
+    keypad_fault_set(&profile);
+    keypad_sim_keys[0] = KEY_1;
+    run_cycles(1);
+    keypad_sim_keys[0] = 0;
+    run_cycles(1);
+    keypad_fault_get_stats(&stats);
+    CHECK(stats.timer_drops >= 1);
+    CHECK(drain(&event) == 1 && event == KEY_1);
+
+    // A delayed reset leaves the timer dormant until the delay has passed.
+    profile = (keypad_fault_profile_t){.seed = 1, .timer_delay_rate = 0xFFFF, .timer_delay = 20};
+    keypad_fault_set(&profile);
+    keypad_sim_keys[0] = KEY_1;
+    run_cycles(1);
+    CHECK(!xTimerIsTimerActive(keypads[0].timer_debounce));
+    run_cycles(20 / keypad_task_delay + 1);
+    CHECK(xTimerIsTimerActive(keypads[0].timer_debounce));
+    keypad_fault_get_stats(&stats);
+    CHECK(stats.timer_delays == 1);
+    keypad_fault_set(NULL);
+    keypad_sim_keys[0] = 0;
+    run_cycles(keypads[0].debounce_time / keypad_task_delay + 2);
+    drain(&event);
+
+    // Refused events are counted like a full queue and still traced.
+    profile = (keypad_fault_profile_t){.seed = 1, .queue_full_rate = 0xFFFF};
+    keypad_fault_set(&profile);
+    drops = keypad_stats.queue_drops;
+    press(KEY_3);
+    keypad_fault_get_stats(&stats);
+    CHECK(stats.queue_fulls == 1 && keypad_stats.queue_drops == drops + 1);
+    CHECK(drain(&event) == 0);
+    CHECK(keypad_trace[(keypad_trace_count - 1) % KEYPAD_TRACE_SIZE].event == KEY_3);
+
+    // Late wake-ups stretch the cycles by up to sched_delay_max ticks.
+    profile = (keypad_fault_profile_t){.seed = 1, .sched_delay_max = 10};
+    keypad_fault_set(&profile);
+    tick = xTaskGetTickCount();
+    run_cycles(10);
+    keypad_fault_get_stats(&stats);
+    CHECK(stats.sched_delays > 0);
+    CHECK((TickType_t)(xTaskGetTickCount() - tick) > 10 * keypad_task_delay);
+    CHECK((TickType_t)(xTaskGetTickCount() - tick) <= 10 * (keypad_task_delay + 10));
+    keypad_fault_set(NULL);
+}
+#endif
+
+int main(void) {
+    CHECK(keypad_init() == pdPASS);
+    CHECK(keypad_consumer_init(&consumer, 0) == pdPASS);
+    run_cycles(1);
+
+#if (KEYPAD_TEST_ROW_DIVIDER > 1)
+    test_row_divider();
+#endif
+#if KEYPAD_EDGE_TIMESTAMPS
+    test_edges();
+#endif
+#if KEYPAD_LATENCY_TRACKING
+    test_single_consumer();
+#endif
+#if KEYPAD_CHARLIEPLEX
+    test_charlieplex();
+#endif
+#if KEYPAD_MUX
+    test_mux();
+#endif
+#if (KEYPAD_DEBOUNCE_MODE == KEYPAD_DEBOUNCE_EAGER)
+    test_eager();
+#elif !KEYPAD_EDGE_TIMESTAMPS
+    test_timing_change();
+#endif
+    test_upper_keys();
+#if (KEYPAD_TEST_COLUMNS > 4)
+    test_shards();
+#endif
+#if KEYPAD_FAULT_INJECTION
+    test_faults();
+#endif
+    test_priority();
+#if KEYPAD_SEQUENCE_DETECT
+    test_sequences();
+#endif
+#if KEYPAD_SPECULATIVE_EVENTS
+    test_speculative();
+#endif
+#if (KEYPAD_PRESENCE_DETECT != KEYPAD_PRESENCE_NONE)
+    test_presence();
+#endif
+#if (configUSE_QUEUE_SETS == 1)
+    test_queue_set();
+#endif
+    test_scan_histogram();
+#if (KEYPAD_WATCHDOG && (KEYPAD_WATCHDOG_RECOVER_MS > 0))
+    test_watchdog();
+#endif
+
+    printf("%s keypad_core\n", keypad_test_failures ? "FAIL" : "ok  ");
+    return keypad_test_failures != 0;
+}
@@ -0,0 +1,125 @@
+/**
+ * Degradation of the debounce modes under the faults of keypad_fault.h, built once per KEYPAD_DEBOUNCE_MODE.
+ *
+ * For every fault profile the same scripted presses are played on keypad 0 of the simulated matrix: each key is
+ * held for HOLD_CYCLES scan cycles and then released for GAP_CYCLES. The queue is drained after every cycle, a
+ * key event is matched to the press being played. A press without its event is missed, any other key event is
+ * spurious. The latency of a matched event runs from the press in eager mode, which reports presses, and from
+ * the release in deferred mode, which reports releases, to the cycle that dequeued it.
+ */
+#include "../src/keypad.c"
+#include "freertos_fake.h"
+#include "keypad_test.h"
+
+#define PRESSES     160
+#define HOLD_CYCLES (KEYPAD_DEBOUNCE_MS / KEYPAD_TASK_DELAY_MS + 4)
+#define GAP_CYCLES  (KEYPAD_DEBOUNCE_MS / KEYPAD_TASK_DELAY_MS + 4)
+
+#if (KEYPAD_DEBOUNCE_MODE == KEYPAD_DEBOUNCE_EAGER)
+#define BENCH_MODE "eager"
+#else
+#define BENCH_MODE "deferred"
+#endif
+
+// Fault profiles played, each with the same presses.
+static const struct {
+    const char* name;
+    keypad_fault_profile_t profile;
+} bench_profiles[] = {
+    {"none", {.seed = 1}},
+    {"glitches", {.seed = 1, .glitch_rate = 512}},
+    {"stuck low", {.seed = 1, .stuck_low = 1U << 1}},
+    {"stuck high", {.seed = 1, .stuck_high = 1U << 1}},
+    {"timer drops", {.seed = 1, .timer_drop_rate = 8192}},
+    {"timer delays", {.seed = 1, .timer_delay_rate = 8192, .timer_delay = 20}},
+    {"queue full", {.seed = 1, .queue_full_rate = 4096}},
+    {"sched delays", {.seed = 1, .sched_delay_max = 10}},
+};
+
+// Results of the profile being played.
+typedef struct {
+    uint32_t missed;
+    uint32_t spurious;
+    uint32_t matched;
+    TickType_t latency_sum;
+    TickType_t latency_max;
+} bench_result_t;
+
+// Runs one scan cycle, then matches the dequeued key events to the press of key, referenced at tick ref.
+static void bench_cycle(bench_result_t* result, uint32_t key, TickType_t ref, uint8_t* matched) {
+    TickType_t latency;
+    uint32_t event;
+
+    fake_task_run(keypad_read, NULL, 1);
+    while (xQueueReceive(keypads[0].queue, &event, 0) == pdPASS) {
+        if (KEY_EVENT_KIND(event) != KEY_EVENT_KEY) {
+            continue;
+        }
+        if (key == KEY_NONE || *matched || KEY_EVENT_KEYS(event) != key) {
+            result->spurious++;
+            continue;
+        }
+        *matched = 1;
+        latency = xTaskGetTickCount() - ref;
+        result->matched++;
+        result->latency_sum += latency;
+        if (latency > result->latency_max) {
+            result->latency_max = latency;
+        }
+    }
+}
+
+static void bench_play(const char* name, const keypad_fault_profile_t* profile) {
+    bench_result_t result = {0};
+    bench_result_t settle = {0};
+    TickType_t ref;
+    uint8_t matched;
+    uint32_t key;
+    uint32_t i, cycle;
+
+    keypad_fault_set(profile);
+    for (i = 0; i < PRESSES; i++) {
+        key = 1UL << (i % 16);
+        matched = 0;
+        keypad_sim_keys[0] = key;
+        ref = xTaskGetTickCount();
+        for (cycle = 0; cycle < HOLD_CYCLES; cycle++) {
+            bench_cycle(&result, key, ref, &matched);
+        }
+        keypad_sim_keys[0] = KEY_NONE;
+#if (KEYPAD_DEBOUNCE_MODE != KEYPAD_DEBOUNCE_EAGER)
+        ref = xTaskGetTickCount();
+#endif
+        for (cycle = 0; cycle < GAP_CYCLES; cycle++) {
+            bench_cycle(&result, key, ref, &matched);
+        }
+        result.missed += !matched;
+    }
+
+    // Let the keypad settle without faults before the next profile, whatever it reports then does not count.
+    keypad_fault_set(NULL);
+    for (cycle = 0; cycle < 2 * GAP_CYCLES; cycle++) {
+        bench_cycle(&settle, KEY_NONE, 0, &matched);
+    }
+
+    printf("  %-12s %3u missed, %3u spurious, latency ", name, (unsigned)result.missed, (unsigned)result.spurious);
+    if (result.matched) {
+        printf("%5.1f ms mean, %3u ms max\n", (double)result.latency_sum / result.matched / configTICK_RATE_HZ * 1000,
+               (unsigned)(result.latency_max * 1000 / configTICK_RATE_HZ));
+    } else {
+        printf("    -\n");
+    }
+}
+
+int main(void) {
+    uint32_t i;
+
+    CHECK(keypad_init() == pdPASS);
+
+    printf("keypad_fault_bench, %s debounce: %u presses of %u ms, %u ms apart\n", BENCH_MODE, PRESSES,
+           HOLD_CYCLES * KEYPAD_TASK_DELAY_MS, GAP_CYCLES * KEYPAD_TASK_DELAY_MS);
+    for (i = 0; i < sizeof(bench_profiles) / sizeof(bench_profiles[0]); i++) {
+        bench_play(bench_profiles[i].name, &bench_profiles[i].profile);
+    }
+    return keypad_test_failures != 0;
+}
@@ -0,0 +1,242 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <gpiod.h>
+#include "keypad_test.h"
+#include "keypad_gpio_linux.h"
+
+/**
+ * Test of the libgpiod backend against a mock GPIO chip.
+ *
+ * The mock chip implements the libgpiod calls of keypad_gpio_linux.c and wires a 4x4 key matrix to its lines:
+ * rows on offsets 0 to 3, columns on offsets 4 to 7. A column reads low while a pressed key connects it to a
+ * row driven low. Every scenario runs in its own process, the backend keeps its state in static variables.
+ */
+
+#define MOCK_LINES 16
+#define MOCK_ROWS  4
+#define MOCK_COLS  4
+
+// type define of structure holding a line of the mock chip.
+struct gpiod_line {
+    unsigned int offset; // Offset on the chip
+    int requested;       // 0: free, 1: output, 2: input
+    int flags;           // Request flags
+    int value;           // Level driven by an output
+};
+
+// Mock chip, its lines are indexed by offset.
+struct gpiod_chip {
+    struct gpiod_line lines[MOCK_LINES];
+};
+
+static struct gpiod_chip mock_chip;
+static int mock_open_count;                     // Calls of gpiod_chip_open_lookup
+static int mock_close_count;                    // Calls of gpiod_chip_close
+static int mock_set_count;                      // Calls of gpiod_line_set_value
+static int mock_read_count;                     // Calls of gpiod_line_get_value_bulk
+static int mock_fail_input;                     // Whether the input request fails
+static uint8_t mock_keys[MOCK_ROWS][MOCK_COLS]; // Pressed keys of the matrix
+
+struct gpiod_chip* gpiod_chip_open_lookup(const char* descr) {
+    unsigned int i;
+
+    mock_open_count++;
+    memset(&mock_chip, 0, sizeof(mock_chip));
+    for (i = 0; i < MOCK_LINES; i++) {
+        mock_chip.lines[i].offset = i;
+    }
+    return (strcmp(descr, KEYPAD_LINUX_GPIO_CHIP) == 0) ? &mock_chip : NULL;
+}
+
+void gpiod_chip_close(struct gpiod_chip* chip) {
+    (void)chip;
+    mock_close_count++;
+}
+
+int gpiod_chip_get_lines(struct gpiod_chip* chip, unsigned int* offsets, unsigned int num_offsets,
+                         struct gpiod_line_bulk* bulk) {
+    unsigned int i;
+
+    for (i = 0; i < num_offsets; i++) {
+        if (offsets[i] >= MOCK_LINES) {
+            return -1;
+        }
+        bulk->lines[i] = &chip->lines[offsets[i]];
+    }
+    bulk->num_lines = num_offsets;
+    return 0;
+}
+
+int gpiod_line_request_bulk_output_flags(struct gpiod_line_bulk* bulk, const char* consumer, int flags,
+                                         const int* default_vals) {
+    unsigned int i;
+
+    (void)consumer;
+    for (i = 0; i < bulk->num_lines; i++) {
+        bulk->lines[i]->requested = 1;
+        bulk->lines[i]->flags = flags;
+        bulk->lines[i]->value = default_vals[i];
+    }
+    return 0;
+}
+
+int gpiod_line_request_bulk_input_flags(struct gpiod_line_bulk* bulk, const char* consumer, int flags) {
+    unsigned int i;
+
+    (void)consumer;
+    if (mock_fail_input) {
+        return -1;
+    }
+    for (i = 0; i < bulk->num_lines; i++) {
+        bulk->lines[i]->requested = 2;
+        bulk->lines[i]->flags = flags;
+    }
+    return 0;
+}
+
+void gpiod_line_release_bulk(struct gpiod_line_bulk* bulk) {
+    unsigned int i;
+
+    for (i = 0; i < bulk->num_lines; i++) {
+        bulk->lines[i]->requested = 0;
+    }
+}
+
+int gpiod_line_set_value(struct gpiod_line* line, int value) {
+    mock_set_count++;
+    if (line == NULL || line->requested != 1) {
+        return -1;
+    }
+    line->value = value;
+    return 0;
+}
+
+int gpiod_line_get_value_bulk(struct gpiod_line_bulk* bulk, int* values) {
+    unsigned int i, row, col;
+
+    mock_read_count++;
+    for (i = 0; i < bulk->num_lines; i++) {
+        if (bulk->lines[i]->requested != 2) {
+            return -1;
+        }
+        col = bulk->lines[i]->offset - MOCK_ROWS;
+        values[i] = 1;
+        for (row = 0; row < MOCK_ROWS; row++) {
+            if (mock_chip.lines[row].requested == 1 && mock_chip.lines[row].value == 0 && mock_keys[row][col]) {
+                values[i] = 0;
+            }
+        }
+    }
+    return 0;
+}
+
+// Declares the lines like keypad_gpio_init does for the default layout of src/linux/keypad_config.h.
+static void declare_lines(void) {
+    uint32_t i;
+
+    for (i = 0; i < MOCK_ROWS; i++) {
+        keypad_linux_gpio_init(i, KEYPAD_LINUX_MODE_OUT_OD);
+        keypad_linux_gpio_write(i, 1);
+    }
+    for (i = 0; i < MOCK_COLS; i++) {
+        keypad_linux_gpio_init(MOCK_ROWS + i, KEYPAD_LINUX_MODE_IPU);
+    }
+}
+
+// All lines are requested in one go by the finish hook, and the matrix reads through them.
+static void test_request_and_scan(void) {
+    uint32_t i;
+
+    declare_lines();
+    CHECK(mock_open_count == 0);
+    CHECK(mock_set_count == 0);
+    CHECK(keypad_linux_gpio_read(MOCK_ROWS) == 1);
+
+    CHECK(keypad_linux_gpio_request() == 0);
+    CHECK(mock_open_count == 1);
+    for (i = 0; i < MOCK_ROWS; i++) {
+        CHECK(mock_chip.lines[i].requested == 1);
+        CHECK(mock_chip.lines[i].flags == GPIOD_LINE_REQUEST_FLAG_OPEN_DRAIN);
+        CHECK(mock_chip.lines[i].value == 1);
+    }
+    for (i = 0; i < MOCK_COLS; i++) {
+        CHECK(mock_chip.lines[MOCK_ROWS + i].requested == 2);
+        CHECK(mock_chip.lines[MOCK_ROWS + i].flags == GPIOD_LINE_REQUEST_FLAG_BIAS_PULL_UP);
+    }
+
+    // Key at row 2, column 1 pressed: only that column of that row reads low, one bulk read per row
+    mock_keys[2][1] = 1;
+    keypad_linux_gpio_write(2, 0);
+    CHECK(keypad_linux_gpio_read(MOCK_ROWS + 0) == 1);
+    CHECK(keypad_linux_gpio_read(MOCK_ROWS + 1) == 0);
+    CHECK(keypad_linux_gpio_read(MOCK_ROWS + 2) == 1);
+    CHECK(keypad_linux_gpio_read(MOCK_ROWS + 3) == 1);
+    CHECK(mock_read_count == 1);
+    keypad_linux_gpio_write(2, 1);
+    keypad_linux_gpio_write(3, 0);
+    CHECK(keypad_linux_gpio_read(MOCK_ROWS + 1) == 1);
+    CHECK(mock_read_count == 2);
+    keypad_linux_gpio_write(3, 1);
+
+    // Finishing again, as after a restart of the keypad task, keeps the request
+    CHECK(keypad_linux_gpio_request() == 0);
+    CHECK(mock_open_count == 1);
+}
+
+// A failed request is reported and leaves every line unused, the scan reads every key released.
+static void test_request_failure(void) {
+    uint32_t i;
+
+    mock_fail_input = 1;
+    declare_lines();
+    CHECK(keypad_linux_gpio_request() == -1);
+    CHECK(mock_close_count == 1);
+    for (i = 0; i < MOCK_ROWS; i++) {
+        CHECK(mock_chip.lines[i].requested == 0);
+    }
+
+    mock_keys[1][0] = 1;
+    for (i = 0; i < MOCK_ROWS; i++) {
+        keypad_linux_gpio_write(i, 0);
+        CHECK(keypad_linux_gpio_read(MOCK_ROWS) == 1);
+        keypad_linux_gpio_write(i, 1);
+    }
+    CHECK(mock_set_count == 0);
+    CHECK(mock_read_count == 0);
+}
+
+// Without columns there is no keypad to request, the chip is not even opened.
+static void test_request_without_columns(void) {
+    keypad_linux_gpio_init(0, KEYPAD_LINUX_MODE_OUT_OD);
+    CHECK(keypad_linux_gpio_request() == -1);
+    CHECK(mock_open_count == 0);
+}
+
+// Runs a scenario in a child process, with the backend in its initial state.
+static void run(const char* name, void (*scenario)(void)) {
+    int status;
+    pid_t pid;
+
+    fflush(stdout);
+    pid = fork();
+    if (pid == 0) {
+        scenario();
+        exit(keypad_test_failures ? EXIT_FAILURE : EXIT_SUCCESS);
+    }
+    if (pid < 0 || waitpid(pid, &status, 0) != pid || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        printf("FAIL %s\n", name);
+        keypad_test_failures++;
+    } else {
+        printf("ok   %s\n", name);
+    }
+}
+
+int main(void) {
+    run("request and scan", test_request_and_scan);
+    run("request failure", test_request_failure);
+    run("request without columns", test_request_without_columns);
+    return keypad_test_failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
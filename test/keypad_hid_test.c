@@ -0,0 +1,122 @@
+#include <stdlib.h>
+#include <string.h>
+#include <keypad_hid.h>
+#include "keypad_test.h"
+
+/**
+ * Test of the boot-keyboard report encoding of keypad_hid.c and of the keypad binding of its callback.
+ */
+
+// Usage of every key bit: digits, an unmapped key, LeftShift and more digits for the rollover.
+static const uint8_t usages[] = {0x1E, 0x1F, 0x20, 0x00, 0xE1, 0x21, 0x22, 0x23, 0x24};
+
+// Keypad callback registered by keypad_hid_attach, and the number of keypads reported by keypad_count.
+static keypad_callback_t registered_callback;
+static void* registered_ctx;
+
+BaseType_t keypad_register_callback(keypad_callback_t callback, void* ctx) {
+    registered_callback = callback;
+    registered_ctx = ctx;
+    return pdPASS;
+}
+
+uint8_t keypad_count(void) {
+    return 2;
+}
+
+// Checks a report byte by byte against the expected modifiers and key usages.
+static int report_is(const keypad_hid_t* hid, uint8_t modifiers, const uint8_t keys[KEYPAD_HID_ROLLOVER]) {
+    return hid->report[0] == modifiers && hid->report[1] == 0
+           && memcmp(&hid->report[2], keys, KEYPAD_HID_ROLLOVER) == 0;
+}
+
+// Keys are reported in press order, a released key leaves its slot and the others move up.
+static void test_press_order(void) {
+    static const uint8_t two_then_one[KEYPAD_HID_ROLLOVER] = {0x1F, 0x1E};
+    static const uint8_t one[KEYPAD_HID_ROLLOVER] = {0x1E};
+    static const uint8_t none[KEYPAD_HID_ROLLOVER] = {0};
+    keypad_hid_t hid;
+
+    keypad_hid_init(&hid, usages, sizeof(usages), 8);
+    keypad_hid_update(&hid, 1UL << 1);
+    keypad_hid_update(&hid, (1UL << 1) | (1UL << 0));
+    CHECK(report_is(&hid, 0, two_then_one));
+    keypad_hid_update(&hid, 1UL << 0);
+    CHECK(report_is(&hid, 0, one));
+    keypad_hid_update(&hid, 0);
+    CHECK(report_is(&hid, 0, none));
+}
+
+// Modifier usages are bits of byte 0 and take no slot, unmapped keys are not reported.
+static void test_modifiers_and_unmapped(void) {
+    static const uint8_t one[KEYPAD_HID_ROLLOVER] = {0x1E};
+    keypad_hid_t hid;
+
+    keypad_hid_init(&hid, usages, sizeof(usages), 8);
+    keypad_hid_update(&hid, (1UL << 0) | (1UL << 3) | (1UL << 4));
+    CHECK(report_is(&hid, 1U << (0xE1 - 0xE0), one));
+}
+
+// More keys than slots report ErrorRollOver in every slot, the modifiers are still reported.
+static void test_rollover(void) {
+    static const uint8_t rollover[KEYPAD_HID_ROLLOVER] = {0x01, 0x01, 0x01, 0x01, 0x01, 0x01};
+    static const uint8_t six[KEYPAD_HID_ROLLOVER] = {0x1E, 0x1F, 0x20, 0x21, 0x22, 0x23};
+    keypad_hid_t hid;
+
+    keypad_hid_init(&hid, usages, sizeof(usages), 8);
+    keypad_hid_update(&hid, 0x1F7);
+    CHECK(report_is(&hid, 1U << (0xE1 - 0xE0), rollover));
+    keypad_hid_update(&hid, 0x0E7);
+    CHECK(report_is(&hid, 0, six));
+}
+
+// Reports go out once per interval at most, changes within an interval are coalesced into the latest state.
+static void test_poll_interval(void) {
+    uint8_t report[KEYPAD_HID_REPORT_SIZE];
+    keypad_hid_t hid;
+
+    keypad_hid_init(&hid, usages, sizeof(usages), 8);
+    CHECK(keypad_hid_poll(&hid, 100, report) == pdFALSE);
+    keypad_hid_update(&hid, 1UL << 0);
+    CHECK(keypad_hid_poll(&hid, 100, report) == pdTRUE);
+    CHECK(report[2] == 0x1E);
+    CHECK(keypad_hid_poll(&hid, 101, report) == pdFALSE);
+    keypad_hid_update(&hid, 1UL << 1);
+    keypad_hid_update(&hid, (1UL << 1) | (1UL << 2));
+    CHECK(keypad_hid_poll(&hid, 107, report) == pdFALSE);
+    CHECK(keypad_hid_poll(&hid, 108, report) == pdTRUE);
+    CHECK(report[2] == 0x1F && report[3] == 0x20 && report[4] == 0);
+}
+
+// The generator follows the keypad it was attached to and ignores the others.
+static void test_keypad_binding(void) {
+    keypad_t kp;
+    keypad_hid_t hid;
+
+    keypad_hid_init(&hid, usages, sizeof(usages), 8);
+    CHECK(keypad_hid_attach(&hid, 2) == pdFAIL);
+    CHECK(keypad_hid_attach(&hid, 1) == pdPASS);
+    CHECK(registered_ctx == &hid);
+
+    memset(&kp, 0, sizeof(kp));
+    kp.index = 0;
+    kp.keys_held = 1UL << 0;
+    registered_callback(&kp, KEY_STATE | kp.keys_held, registered_ctx);
+    CHECK(hid.report[2] == 0);
+
+    kp.index = 1;
+    registered_callback(&kp, KEY_EVENT_KEY | kp.keys_held, registered_ctx);
+    CHECK(hid.report[2] == 0);
+    registered_callback(&kp, KEY_STATE | kp.keys_held, registered_ctx);
+    CHECK(hid.report[2] == 0x1E);
+}
+
+int main(void) {
+    test_press_order();
+    test_modifiers_and_unmapped();
+    test_rollover();
+    test_poll_interval();
+    test_keypad_binding();
+    printf("%s keypad_hid\n", keypad_test_failures ? "FAIL" : "ok  ");
+    return keypad_test_failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
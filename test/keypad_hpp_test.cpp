@@ -0,0 +1,133 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <keypad.hpp>
+#include "keypad_test.h"
+
+/**
+ * Test of the coroutine consumer API of keypad.hpp.
+ *
+ * A minimal executor stands in for the keypad task: it owns the callback registered by Keypad::attach and
+ * delivers a script of events to it, one keypad_t per keypad, resuming the flows exactly like the keypad task.
+ */
+
+namespace {
+
+// Keypad callback registered by Keypad::attach.
+keypad_callback_t registered_callback;
+void* registered_ctx;
+
+// Runs the keypad side of the test: delivers events of a keypad to the registered callback.
+struct Executor {
+    keypad_t keypads[2];
+
+    Executor() {
+        std::memset(keypads, 0, sizeof(keypads));
+        keypads[0].index = 0;
+        keypads[1].index = 1;
+    }
+
+    void publish(uint8_t index, uint32_t event) { registered_callback(&keypads[index], event, registered_ctx); }
+};
+
+// Event words received by the flows, in order.
+uint32_t received[16];
+unsigned received_count;
+
+void record(uint32_t event) {
+    if (received_count < sizeof(received) / sizeof(received[0])) {
+        received[received_count] = event;
+    }
+    received_count++;
+}
+
+// Waits for key 0, then for keypad 1 to be removed, then for the first sequence.
+keypad::Flow service_flow(keypad::Keypad& keypad) {
+    record(co_await keypad.next_event(0x1));
+    record(co_await keypad.next_kind(KEY_REMOVED, 1));
+    record(co_await keypad.next_kind(KEY_SEQUENCE));
+}
+
+// Waits for two key events of keypad 1, waiting again right after the first one.
+keypad::Flow keypad_one_flow(keypad::Keypad& keypad) {
+    record(co_await keypad.next_event(KEY_EVENT_BITMASK, KEY_EVENT_KEY, 1));
+    record(co_await keypad.next_event(KEY_EVENT_BITMASK, KEY_EVENT_KEY, 1));
+}
+
+} // namespace
+
+extern "C" BaseType_t keypad_register_callback(keypad_callback_t callback, void* ctx) {
+    registered_callback = callback;
+    registered_ctx = ctx;
+    return pdPASS;
+}
+
+// Keyless kinds and the ID 0 of the first sequence wake the waits on their kind, the keypad filter holds.
+static void test_kind_waits() {
+    keypad::Keypad keypad;
+    Executor executor;
+
+    received_count = 0;
+    CHECK(keypad.attach() == pdPASS);
+    service_flow(keypad);
+
+    executor.publish(0, KEY_EVENT_KEY | 0x2);
+    CHECK(received_count == 0);
+    executor.publish(0, KEY_EVENT_KEY | 0x3);
+    CHECK(received_count == 1 && received[0] == 0x3);
+
+    executor.publish(0, KEY_REMOVED);
+    CHECK(received_count == 1);
+    executor.publish(1, KEY_ATTACHED);
+    CHECK(received_count == 1);
+    executor.publish(1, KEY_REMOVED);
+    CHECK(received_count == 2 && received[1] == KEY_REMOVED);
+
+    executor.publish(0, KEY_SEQUENCE | 0);
+    CHECK(received_count == 3 && received[2] == KEY_SEQUENCE);
+
+    // The flow finished, further events wake nobody
+    executor.publish(0, KEY_SEQUENCE | 1);
+    CHECK(received_count == 3);
+}
+
+// A wait on one keypad ignores the others, and a new wait is not woken by the event that resumed it.
+static void test_keypad_filter() {
+    keypad::Keypad keypad;
+    Executor executor;
+
+    received_count = 0;
+    CHECK(keypad.attach() == pdPASS);
+    keypad_one_flow(keypad);
+
+    executor.publish(0, KEY_EVENT_KEY | 0x10);
+    CHECK(received_count == 0);
+    executor.publish(1, KEY_TENTATIVE | 0x10);
+    CHECK(received_count == 0);
+    executor.publish(1, KEY_EVENT_KEY | 0x20);
+    CHECK(received_count == 1 && received[0] == 0x20);
+    executor.publish(1, KEY_EVENT_KEY | 0x40);
+    CHECK(received_count == 2 && received[1] == 0x40);
+}
+
+// Waiters are resumed in the order they started waiting.
+static void test_order() {
+    keypad::Keypad keypad;
+    Executor executor;
+
+    received_count = 0;
+    CHECK(keypad.attach() == pdPASS);
+    keypad_one_flow(keypad);
+    service_flow(keypad);
+
+    executor.publish(1, KEY_EVENT_KEY | 0x1);
+    CHECK(received_count == 2 && received[0] == 0x1 && received[1] == 0x1);
+}
+
+int main() {
+    test_kind_waits();
+    test_keypad_filter();
+    test_order();
+    std::printf("%s keypad_hpp\n", keypad_test_failures ? "FAIL" : "ok  ");
+    return keypad_test_failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,226 @@
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <keypad_link.h>
+
+/**
+ * Benchmarks of the serial link.
+ *
+ * The codec run encodes full batches and decodes them directly from the transport hook, and prints the cost per
+ * frame and per event of both sides. The end-to-end runs send the frames over the pseudo terminal of
+ * keypad_link_test.c, read back by a receiver thread: events pushed at a steady pace and flushed by a periodic
+ * serial task measure the latency added by the batching and the line, events pushed back to back measure the
+ * events per second the link carries.
+ */
+
+#define BENCH_FRAMES 200000U
+
+// Events of the end-to-end runs, the pace of the paced run and the period of its serial task.
+#define BENCH_PACED_EVENTS 2000U
+#define BENCH_PACED_US     250U
+#define BENCH_FLUSH_US     1000U
+#define BENCH_BULK_EVENTS  200000U
+
+static keypad_link_rx_t rx;
+static double decode_ns;
+static uint32_t events_received;
+
+// Pseudo terminal of the end-to-end runs, push time of every event and the latency statistics of the receiver.
+static int pty_master = -1;
+static int pty_slave = -1;
+static double push_ns[BENCH_BULK_EVENTS];
+static uint32_t bench_expected;
+static double latency_sum_ns;
+static double latency_max_ns;
+static double last_ns;
+
+static double now_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static void link_send(const uint8_t* frame, size_t length, void* ctx) {
+    double start = now_ns();
+
+    (void)ctx;
+    keypad_link_rx_feed(&rx, frame, length);
+    decode_ns += now_ns() - start;
+}
+
+static void link_event(uint8_t keypad, uint32_t event, void* ctx) {
+    (void)keypad;
+    (void)ctx;
+    events_received += (event != 0);
+}
+
+// Writes a frame to the master side of the pty, the line discipline may take it in parts.
+static void pty_send(const uint8_t* frame, size_t length, void* ctx) {
+    ssize_t written;
+
+    (void)ctx;
+    while (length > 0) {
+        written = write(pty_master, frame, length);
+        if (written < 0) {
+            perror("keypad_link_bench: write");
+            exit(EXIT_FAILURE);
+        }
+        frame += written;
+        length -= (size_t)written;
+    }
+}
+
+// Event N of a run is N + 1, its latency runs from its push to its decoding.
+static void pty_event(uint8_t keypad, uint32_t event, void* ctx) {
+    double latency;
+
+    (void)keypad;
+    (void)ctx;
+    last_ns = now_ns();
+    latency = last_ns - push_ns[event - 1];
+    latency_sum_ns += latency;
+    if (latency > latency_max_ns) {
+        latency_max_ns = latency;
+    }
+    events_received++;
+}
+
+// Receiver thread, feeds the slave side to the receiver until every event of the run arrived.
+static void* pty_reader(void* arg) {
+    keypad_link_rx_t* receiver = arg;
+    uint8_t buffer[4096];
+    ssize_t length;
+
+    while (events_received < bench_expected && receiver->errors == 0) {
+        length = read(pty_slave, buffer, sizeof(buffer));
+        if (length <= 0) {
+            break;
+        }
+        keypad_link_rx_feed(receiver, buffer, (size_t)length);
+    }
+    return NULL;
+}
+
+// Opens the pty pair, the slave side blocking and in raw mode so every byte arrives unchanged.
+static int pty_open(void) {
+    struct termios tio;
+
+    pty_master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (pty_master < 0 || grantpt(pty_master) < 0 || unlockpt(pty_master) < 0) {
+        return -1;
+    }
+    pty_slave = open(ptsname(pty_master), O_RDWR | O_NOCTTY);
+    if (pty_slave < 0 || tcgetattr(pty_slave, &tio) < 0) {
+        return -1;
+    }
+    cfmakeraw(&tio);
+    return tcsetattr(pty_slave, TCSANOW, &tio);
+}
+
+/**
+ * Sends events over the pty and waits for the receiver thread to decode them all.
+ *
+ * With a pace, event N is pushed N * pace_us after the start and the serial task flushes every BENCH_FLUSH_US, or
+ * as soon as the batch is full. Without one, the events are pushed back to back and every full batch is flushed.
+ * Returns the time from the first push to the last decoded event, 0 if events were lost.
+ */
+static double pty_run(uint32_t events, uint32_t pace_us) {
+    keypad_link_tx_t tx;
+    keypad_link_rx_t receiver;
+    pthread_t reader;
+    double start, flush;
+    uint32_t i;
+
+    keypad_link_tx_init(&tx, 0, pty_send, NULL);
+    keypad_link_rx_init(&receiver, pty_event, NULL);
+    events_received = 0;
+    bench_expected = events;
+    latency_sum_ns = 0;
+    latency_max_ns = 0;
+    if (pthread_create(&reader, NULL, pty_reader, &receiver) != 0) {
+        return 0;
+    }
+
+    start = now_ns();
+    flush = start;
+    for (i = 0; i < events; i++) {
+        while (now_ns() < start + (double)i * pace_us * 1000.0) {
+            if (now_ns() >= flush + BENCH_FLUSH_US * 1000.0) {
+                keypad_link_tx_flush(&tx);
+                flush += BENCH_FLUSH_US * 1000.0;
+            }
+        }
+        push_ns[i] = now_ns();
+        keypad_link_tx_push(&tx, i + 1);
+        if (keypad_link_tx_pending(&tx) == KEYPAD_LINK_MAX_BATCH) {
+            keypad_link_tx_flush(&tx);
+        }
+    }
+    keypad_link_tx_flush(&tx);
+    pthread_join(reader, NULL);
+
+    if (events_received != events || receiver.errors != 0 || receiver.lost != 0 || tx.dropped != 0) {
+        printf("keypad_link_bench: %lu of %lu events over the pty, %lu errors, %lu frames lost\n",
+               (unsigned long)events_received, (unsigned long)events, (unsigned long)receiver.errors,
+               (unsigned long)receiver.lost);
+        return 0;
+    }
+    return last_ns - start;
+}
+
+int main(void) {
+    keypad_link_tx_t tx;
+    double start, total_ns, encode_ns;
+    uint32_t frame, i;
+
+    keypad_link_tx_init(&tx, 0, link_send, NULL);
+    keypad_link_rx_init(&rx, link_event, NULL);
+
+    start = now_ns();
+    for (frame = 0; frame < BENCH_FRAMES; frame++) {
+        for (i = 0; i < KEYPAD_LINK_MAX_BATCH; i++) {
+            keypad_link_tx_push(&tx, (frame << 8) | (i + 1));
+        }
+        keypad_link_tx_flush(&tx);
+    }
+    total_ns = now_ns() - start;
+    encode_ns = total_ns - decode_ns;
+
+    if (rx.frames != BENCH_FRAMES || rx.errors != 0 || events_received != BENCH_FRAMES * KEYPAD_LINK_MAX_BATCH) {
+        printf("keypad_link_bench: %lu frames, %lu errors\n", (unsigned long)rx.frames, (unsigned long)rx.errors);
+        return EXIT_FAILURE;
+    }
+    printf("keypad_link_bench: %u frames of %u events\n", BENCH_FRAMES, (unsigned)KEYPAD_LINK_MAX_BATCH);
+    printf("  encode %.1f ns/frame, %.1f ns/event\n", encode_ns / BENCH_FRAMES,
+           encode_ns / (BENCH_FRAMES * KEYPAD_LINK_MAX_BATCH));
+    printf("  decode %.1f ns/frame, %.1f ns/event\n", decode_ns / BENCH_FRAMES,
+           decode_ns / (BENCH_FRAMES * KEYPAD_LINK_MAX_BATCH));
+
+    if (pty_open() < 0) {
+        perror("keypad_link_bench: pty");
+        return EXIT_FAILURE;
+    }
+
+    total_ns = pty_run(BENCH_PACED_EVENTS, BENCH_PACED_US);
+    if (total_ns == 0) {
+        return EXIT_FAILURE;
+    }
+    printf("keypad_link_bench: pty, an event every %u us, flushed every %u us\n", BENCH_PACED_US, BENCH_FLUSH_US);
+    printf("  latency %.1f us mean, %.1f us max\n", latency_sum_ns / BENCH_PACED_EVENTS / 1000.0,
+           latency_max_ns / 1000.0);
+
+    total_ns = pty_run(BENCH_BULK_EVENTS, 0);
+    if (total_ns == 0) {
+        return EXIT_FAILURE;
+    }
+    printf("keypad_link_bench: pty, %u events back to back\n", BENCH_BULK_EVENTS);
+    printf("  %.0f events/s, latency %.1f us mean, %.1f us max\n", BENCH_BULK_EVENTS / (total_ns / 1e9),
+           latency_sum_ns / BENCH_BULK_EVENTS / 1000.0, latency_max_ns / 1000.0);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,183 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+#include <keypad_link.h>
+#include "keypad_test.h"
+
+/**
+ * Loopback test of the serial link over a pseudo terminal.
+ *
+ * The transmitter writes its frames to the master side of a pty and the receiver reads them back from the
+ * raw slave side, so the frames cross a real tty line discipline as they would on a UART.
+ */
+
+// Pseudo terminal carrying the frames, and the frames the transport hook was handed.
+static int pty_master = -1;
+static int pty_slave = -1;
+static unsigned int frames_sent;
+static const uint8_t* frame_last;
+
+// Events decoded by the receiver.
+static uint32_t received[64];
+static uint8_t received_keypad[64];
+static unsigned int received_count;
+
+static void link_send(const uint8_t* frame, size_t length, void* ctx) {
+    (void)ctx;
+    CHECK(write(pty_master, frame, length) == (ssize_t)length);
+    frames_sent++;
+    frame_last = frame;
+}
+
+static void link_event(uint8_t keypad, uint32_t event, void* ctx) {
+    (void)ctx;
+    if (received_count < sizeof(received) / sizeof(received[0])) {
+        received_keypad[received_count] = keypad;
+        received[received_count] = event;
+    }
+    received_count++;
+}
+
+// Opens the pty pair, the slave side in raw mode so every byte arrives unchanged.
+static int pty_open(void) {
+    struct termios tio;
+
+    pty_master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (pty_master < 0 || grantpt(pty_master) < 0 || unlockpt(pty_master) < 0) {
+        return -1;
+    }
+    pty_slave = open(ptsname(pty_master), O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (pty_slave < 0 || tcgetattr(pty_slave, &tio) < 0) {
+        return -1;
+    }
+    cfmakeraw(&tio);
+    return tcsetattr(pty_slave, TCSANOW, &tio);
+}
+
+// Feeds everything the slave side received so far to the receiver.
+static void pty_drain(keypad_link_rx_t* rx) {
+    uint8_t buffer[256];
+    ssize_t length;
+
+    tcdrain(pty_master);
+    usleep(1000);
+    while ((length = read(pty_slave, buffer, sizeof(buffer))) > 0) {
+        keypad_link_rx_feed(rx, buffer, (size_t)length);
+    }
+    CHECK(length < 0 && (errno == EAGAIN || errno == EWOULDBLOCK));
+}
+
+// Events pushed between flushes arrive in order, tagged with the keypad of the transmitter.
+static void test_loopback(void) {
+    keypad_link_tx_t tx;
+    keypad_link_rx_t rx;
+    uint32_t i;
+
+    keypad_link_tx_init(&tx, 1, link_send, NULL);
+    keypad_link_rx_init(&rx, link_event, NULL);
+    received_count = 0;
+
+    for (i = 0; i < 40; i++) {
+        // Event words with zero bytes exercise the COBS blocks
+        CHECK(keypad_link_tx_push(&tx, (i << 24) | (i & 1 ? 0x000100U : 0x010000U)) == 0);
+        if (i % 5 == 4) {
+            keypad_link_tx_flush(&tx);
+        }
+    }
+    CHECK(keypad_link_tx_flush(&tx) == 0);
+    pty_drain(&rx);
+
+    CHECK(frames_sent == 8);
+    CHECK(rx.frames == 8 && rx.errors == 0 && rx.lost == 0);
+    CHECK(received_count == 40);
+    for (i = 0; i < 40 && i < received_count; i++) {
+        CHECK(received_keypad[i] == 1);
+        CHECK(received[i] == ((i << 24) | (i & 1 ? 0x000100U : 0x010000U)));
+    }
+}
+
+// Pushing never sends, a full batch drops the event, and the serial task flushes the batch in one frame.
+static void test_push_only_batches(void) {
+    keypad_link_tx_t tx;
+    keypad_link_rx_t rx;
+    uint32_t i;
+
+    keypad_link_tx_init(&tx, 0, link_send, NULL);
+    keypad_link_rx_init(&rx, link_event, NULL);
+    frames_sent = 0;
+    received_count = 0;
+
+    for (i = 0; i < KEYPAD_LINK_MAX_BATCH; i++) {
+        CHECK(keypad_link_tx_push(&tx, i + 1) == 0);
+    }
+    CHECK(keypad_link_tx_pending(&tx) == KEYPAD_LINK_MAX_BATCH);
+    CHECK(keypad_link_tx_push(&tx, 0xFF) == -1);
+    CHECK(tx.dropped == 1);
+    CHECK(frames_sent == 0);
+
+    CHECK(keypad_link_tx_flush(&tx) > 0);
+    CHECK(keypad_link_tx_pending(&tx) == 0);
+    pty_drain(&rx);
+    CHECK(frames_sent == 1 && rx.frames == 1);
+    CHECK(received_count == KEYPAD_LINK_MAX_BATCH && received[KEYPAD_LINK_MAX_BATCH - 1] == KEYPAD_LINK_MAX_BATCH);
+}
+
+// A frame stays untouched until the flush after the next one, so its transfer may still be running.
+static void test_frame_lifetime(void) {
+    uint8_t copy[KEYPAD_LINK_FRAME_SIZE];
+    const uint8_t* first;
+    keypad_link_tx_t tx;
+    keypad_link_rx_t rx;
+    size_t length;
+
+    keypad_link_tx_init(&tx, 0, link_send, NULL);
+    keypad_link_rx_init(&rx, link_event, NULL);
+
+    keypad_link_tx_push(&tx, 0x11);
+    length = keypad_link_tx_flush(&tx);
+    first = frame_last;
+    memcpy(copy, first, length);
+    keypad_link_tx_push(&tx, 0x22);
+    keypad_link_tx_flush(&tx);
+    CHECK(frame_last != first);
+    CHECK(memcmp(copy, first, length) == 0);
+    pty_drain(&rx);
+}
+
+// Line noise costs the frame it hits, the receiver resynchronizes on the next delimiter.
+static void test_noise(void) {
+    static const uint8_t noise[] = {0x03, 0x55, 0x00, 0x07, 0x01, 0x02, 0x00};
+    keypad_link_tx_t tx;
+    keypad_link_rx_t rx;
+
+    keypad_link_tx_init(&tx, 2, link_send, NULL);
+    keypad_link_rx_init(&rx, link_event, NULL);
+    received_count = 0;
+
+    keypad_link_tx_push(&tx, 0xA5);
+    keypad_link_tx_flush(&tx);
+    CHECK(write(pty_master, noise, sizeof(noise)) == (ssize_t)sizeof(noise));
+    keypad_link_tx_push(&tx, 0x5A);
+    keypad_link_tx_flush(&tx);
+    pty_drain(&rx);
+
+    CHECK(rx.frames == 2 && rx.errors == 2 && rx.lost == 0);
+    CHECK(received_count == 2 && received[0] == 0xA5 && received[1] == 0x5A && received_keypad[1] == 2);
+}
+
+int main(void) {
+    if (pty_open() < 0) {
+        perror("pty");
+        return EXIT_FAILURE;
+    }
+    test_loopback();
+    test_push_only_batches();
+    test_frame_lifetime();
+    test_noise();
+    printf("%s keypad_link\n", keypad_test_failures ? "FAIL" : "ok  ");
+    return keypad_test_failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
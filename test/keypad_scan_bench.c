@@ -0,0 +1,97 @@
+/**
+ * Scan time of the combined row schedule of keypad.c, built once per keypad count (KEYPAD_TEST_KEYPADS).
+ *
+ * Row N of every keypad is driven at the same time and the keypads share one stabilization delay per row, so the
+ * time of a scan should stay close to rows * KEYPAD_GPIO_STABILIZATION_US whatever the number of keypads, where
+ * scanning the keypads one after the other costs that much per keypad.
+ *
+ * The worst-case event latency is measured on the simulated matrix: keys are released on every keypad at once
+ * right before a cycle, and each event is timed when it reaches the callbacks. A release just after a cycle
+ * sampled the rows waits one more scan period. The static RAM of keypad.c per build is reported by `make bench`.
+ *
+ * Built with KEYPAD_MUX, keypad 0 reads its columns through the multiplexer of config/keypad_config.h, every
+ * column read then changes one select line and waits KEYPAD_MUX_SETTLE_US on top of the row delay.
+ */
+#include "../src/keypad.c"
+#include "freertos_fake.h"
+#include "keypad_test.h"
+
+#define SCANS  2000
+#define TRIALS 20
+
+// Column sensing of the build, printed with the results.
+#if KEYPAD_MUX
+#define BENCH_SENSING "multiplexed columns"
+#else
+#define BENCH_SENSING "direct columns"
+#endif
+
+// Clock at the start of the measured cycle, and the time each keypad took to publish its key event since then.
+static uint32_t bench_start_us;
+static uint32_t bench_latency_us[KEYPAD_TEST_KEYPADS];
+static uint32_t bench_events;
+
+static void bench_record(const keypad_t* kp, uint32_t event, void* ctx) {
+    if (KEY_EVENT_KIND(event) == KEY_EVENT_KEY && KEY_EVENT_KEYS(event) != KEY_NONE) {
+        bench_latency_us[kp->index] = keypad_sim_clock_us() - bench_start_us;
+        bench_events++;
+    }
+}
+
+int main(void) {
+    struct timespec start, end;
+    uint32_t worst_us = 0;
+    uint32_t event;
+    uint64_t ns;
+    uint32_t i, trial;
+
+    CHECK(keypad_init() == pdPASS);
+    CHECK(keypad_register_callback(bench_record, NULL) == pdPASS);
+
+    // Hold a different key on every keypad, the scans must read them all.
+    for (i = 0; i < KEYPAD_INSTANCE_COUNT; i++) {
+        keypad_sim_keys[i] = 1UL << (5 * i % 16);
+    }
+
+    keypad_scan();
+    for (i = 0; i < KEYPAD_INSTANCE_COUNT; i++) {
+        CHECK(keypads[i].keys_pressed == keypad_sim_keys[i]);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < SCANS; i++) {
+        keypad_scan();
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    ns = (uint64_t)(end.tv_sec - start.tv_sec) * 1000000000ULL + end.tv_nsec - start.tv_nsec;
+
+    // Debounce the held keys, release them all and time the events of the next cycle.
+    for (trial = 0; trial < TRIALS; trial++) {
+        for (i = 0; i < KEYPAD_INSTANCE_COUNT; i++) {
+            keypad_sim_keys[i] = 1UL << (5 * i % 16);
+        }
+        fake_task_run(keypad_read, NULL, keypads[0].debounce_time / keypad_task_delay + 2);
+        for (i = 0; i < KEYPAD_INSTANCE_COUNT; i++) {
+            keypad_sim_keys[i] = 0;
+        }
+        bench_events = 0;
+        bench_start_us = keypad_sim_clock_us();
+        fake_task_run(keypad_read, NULL, 1);
+        CHECK(bench_events == KEYPAD_INSTANCE_COUNT);
+        for (i = 0; i < KEYPAD_INSTANCE_COUNT; i++) {
+            if (bench_latency_us[i] > worst_us) {
+                worst_us = bench_latency_us[i];
+            }
+            while (xQueueReceive(keypads[i].queue, &event, 0) == pdPASS) {
+            }
+        }
+    }
+
+    printf("keypad scan, %u keypad(s), %s: %.1f us per scan, one keypad after the other would wait %u us\n",
+           (unsigned)KEYPAD_INSTANCE_COUNT, BENCH_SENSING, ns / 1000.0 / SCANS,
+           (unsigned)(KEYPAD_INSTANCE_COUNT * keypad_row_max * KEYPAD_GPIO_STABILIZATION_US));
+    printf("keypad scan, %u keypad(s), %s: worst-case event latency %u us, a %u ms period and %u us to the event\n",
+           (unsigned)KEYPAD_INSTANCE_COUNT, BENCH_SENSING, (unsigned)(KEYPAD_TASK_DELAY_MS * 1000 + worst_us),
+           (unsigned)KEYPAD_TASK_DELAY_MS, (unsigned)worst_us);
+    return keypad_test_failures != 0;
+}
@@ -0,0 +1,87 @@
+#include <cstdio>
+#include <initializer_list>
+#include <keypad_sequence.hpp>
+#include "keypad_test.h"
+
+/**
+ * Compile-time test of the sequence automatons of keypad_sequence.hpp.
+ *
+ * The automatons are built and walked by the compiler, every check is a static_assert. The walk advances the
+ * table view like keypad_sequence_advance in keypad.c. Built with KEYPAD_SEQUENCE_TEST_CONTAINED, the test
+ * compiles a sequence containing another one, which must stop the compilation: test/Makefile checks it does.
+ */
+
+namespace {
+
+// Keys of the 4x4 keypad of keypad_config.h.
+constexpr uint32_t KEY_1 = 0x0001;
+constexpr uint32_t KEY_2 = 0x0002;
+constexpr uint32_t KEY_3 = 0x0004;
+constexpr uint32_t KEY_6 = 0x0040;
+constexpr uint32_t KEY_STAR = 0x1000;
+constexpr uint32_t KEY_0 = 0x2000;
+constexpr uint32_t KEY_POUND = 0x4000;
+
+// Walks an automaton through key events, returns the ID of the last completed sequence, -1 for none.
+constexpr int walk(const keypad_sequence_table_t& table, std::initializer_list<uint32_t> keys) {
+    uint16_t state = 0;
+    int id = -1;
+
+    for (uint32_t key : keys) {
+        uint8_t bit = 0;
+
+        while ((key >> bit) > 1) {
+            bit++;
+        }
+        state = (table.symbol[bit] == KEYPAD_SEQUENCE_NO_SYMBOL)
+                    ? 0
+                    : table.next[state * table.symbol_count + table.symbol[bit]];
+        if (table.match[state] != 0) {
+            id = table.match[state] - 1;
+            state = 0;
+        }
+    }
+    return id;
+}
+
+// The service codes of the keypad_sequence.hpp example.
+constexpr auto service = keypad::compile_sequences<12, 4>({
+    {KEY_STAR, KEY_POUND, KEY_0, KEY_6, KEY_POUND}, // ID 0
+    {KEY_STAR, KEY_POUND, KEY_0, KEY_0, KEY_POUND}, // ID 1
+});
+constexpr keypad_sequence_table_t service_table = service.table();
+
+static_assert(service.state_count == 8, "one state per distinct prefix and the start state");
+static_assert(walk(service_table, {KEY_STAR, KEY_POUND, KEY_0, KEY_6, KEY_POUND}) == 0, "*#06# gives ID 0");
+static_assert(walk(service_table, {KEY_STAR, KEY_POUND, KEY_0, KEY_0, KEY_POUND}) == 1, "*#00# gives ID 1");
+static_assert(walk(service_table, {KEY_STAR, KEY_POUND, KEY_0, KEY_1, KEY_POUND}) == -1, "*#01# is no sequence");
+static_assert(walk(service_table, {KEY_STAR, KEY_POUND, KEY_0, KEY_6}) == -1, "an unfinished sequence waits");
+
+// Keys typed before a sequence, and a prefix typed again, lead to the same sequence.
+static_assert(walk(service_table, {KEY_STAR, KEY_STAR, KEY_POUND, KEY_0, KEY_6, KEY_POUND}) == 0,
+              "a repeated first key still matches");
+static_assert(walk(service_table, {KEY_STAR, KEY_POUND, KEY_STAR, KEY_POUND, KEY_0, KEY_0, KEY_POUND}) == 1,
+              "a restarted prefix still matches");
+static_assert(walk(service_table, {KEY_3, KEY_STAR, KEY_POUND, KEY_0, KEY_6, KEY_POUND}) == 0,
+              "a key outside the sequences starts over");
+
+// A sequence can start inside the prefix of another one.
+constexpr auto overlap = keypad::compile_sequences<8, 3>({{KEY_1, KEY_2, KEY_3}, {KEY_2, KEY_3, KEY_1}});
+constexpr keypad_sequence_table_t overlap_table = overlap.table();
+
+static_assert(walk(overlap_table, {KEY_1, KEY_2, KEY_2, KEY_3, KEY_1}) == 1, "an overlapping prefix still matches");
+static_assert(walk(overlap_table, {KEY_1, KEY_2, KEY_3, KEY_1}) == 0, "keys of a completed sequence are not reused");
+
+#ifdef KEYPAD_SEQUENCE_TEST_CONTAINED
+// {KEY_2} completes inside {KEY_1, KEY_2, KEY_3}, which could then never be completed.
+constexpr auto contained = keypad::compile_sequences<8, 3>({{KEY_1, KEY_2, KEY_3}, {KEY_2}});
+#endif
+
+} // namespace
+
+int main() {
+    // Every check ran at compile time, the table view still has to work at run time.
+    CHECK(walk(service_table, {KEY_STAR, KEY_POUND, KEY_0, KEY_6, KEY_POUND}) == 0);
+    std::printf("%s keypad_sequence\n", keypad_test_failures ? "FAIL" : "ok  ");
+    return keypad_test_failures != 0;
+}
@@ -0,0 +1,22 @@
+#ifndef MATRIX_KEYPAD_TEST_H
+#define MATRIX_KEYPAD_TEST_H
+
+#include <stdio.h>
+
+/**
+ * Checks shared by the host tests. A failed check is reported with its location and counted, the test goes on
+ * and exits with a failure status at the end.
+ */
+
+// Number of failed checks of the test program.
+static int keypad_test_failures = 0;
+
+#define CHECK(COND)                                                                   \
+    do {                                                                              \
+        if (!(COND)) {                                                                \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #COND); \
+            keypad_test_failures++;                                                   \
+        }                                                                             \
+    } while (0)
+
+#endif
@@ -0,0 +1,127 @@
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <keypad.h>
+
+/**
+ * Test of the uinput backend of keypad_uinput.c against stand-ins of the system calls.
+ *
+ * The system headers are included first, so only the calls of keypad_uinput.c are routed to the stand-ins,
+ * which record the input events written and the key codes announced instead of talking to /dev/uinput.
+ */
+#define open  uinput_test_open
+#define close uinput_test_close
+#define ioctl uinput_test_ioctl
+#define write uinput_test_write
+static int uinput_test_open(const char* path, int flags, ...);
+static int uinput_test_close(int fd);
+static int uinput_test_ioctl(int fd, unsigned long request, ...);
+static ssize_t uinput_test_write(int fd, const void* buffer, size_t length);
+
+#include "../src/linux/keypad_uinput.c"
+#include "keypad_test.h"
+
+// Key codes of the key bits: key 2 is unmapped, key 3 is the first key of the upper words of the test keypad.
+static const uint16_t keycodes[] = {KEY_1, KEY_2, 0, KEY_ENTER};
+
+// Input events written to the device, the key codes announced and whether the device was created.
+static struct input_event written[16];
+static unsigned int written_count;
+static uint16_t announced[8];
+static unsigned int announced_count;
+static int created;
+
+// Keypad callback registered by keypad_uinput_init.
+static keypad_callback_t registered_callback;
+
+static int uinput_test_open(const char* path, int flags, ...) {
+    return strcmp(path, "/dev/uinput") == 0 ? 3 : -1;
+}
+
+static int uinput_test_close(int fd) {
+    return 0;
+}
+
+static int uinput_test_ioctl(int fd, unsigned long request, ...) {
+    va_list args;
+
+    va_start(args, request);
+    if (request == UI_SET_KEYBIT && announced_count < sizeof(announced) / sizeof(announced[0])) {
+        announced[announced_count++] = (uint16_t)va_arg(args, int);
+    } else if (request == UI_DEV_CREATE) {
+        created = 1;
+    }
+    va_end(args);
+    return 0;
+}
+
+static ssize_t uinput_test_write(int fd, const void* buffer, size_t length) {
+    CHECK(fd == 3 && length == sizeof(struct input_event));
+    if (written_count < sizeof(written) / sizeof(written[0])) {
+        memcpy(&written[written_count], buffer, sizeof(struct input_event));
+    }
+    written_count++;
+    return (ssize_t)length;
+}
+
+BaseType_t keypad_register_callback(keypad_callback_t callback, void* ctx) {
+    registered_callback = callback;
+    return pdPASS;
+}
+
+uint8_t keypad_count(void) {
+    return 2;
+}
+
+// Checks written event N against a type, code and value.
+static int written_is(unsigned int n, uint16_t type, uint16_t code, int32_t value) {
+    return n < written_count && written[n].type == type && written[n].code == code && written[n].value == value;
+}
+
+// Sets the held keys of the keypad and passes its KEY_STATE event words to the registered callback.
+static void hold(keypad_t* kp, uint32_t keys) {
+    written_count = 0;
+    kp->keys_held = keys;
+    registered_callback(kp, KEY_STATE | (keys & ((1UL << kp->upper_shift) - 1U)), NULL);
+    registered_callback(kp, KEY_EVENT_UPPER | KEY_STATE | (keys >> kp->upper_shift), NULL);
+}
+
+int main(void) {
+    keypad_t kp = {.index = 1, .upper_shift = 3};
+    keypad_t other = {.index = 0, .upper_shift = 3};
+
+    CHECK(keypad_uinput_init(keycodes, sizeof(keycodes) / sizeof(keycodes[0]), 2) == -1);
+    CHECK(keypad_uinput_init(keycodes, sizeof(keycodes) / sizeof(keycodes[0]), 1) == 0);
+    CHECK(created && registered_callback != NULL);
+    CHECK(announced_count == 3 && announced[0] == KEY_1 && announced[1] == KEY_2 && announced[2] == KEY_ENTER);
+
+    // A plain key event, reported once the key was released, sends nothing.
+    written_count = 0;
+    registered_callback(&kp, KEY_EVENT_KEY | 1U, NULL);
+    CHECK(written_count == 0);
+
+    // The press goes down with the held state and stays down while the key is held.
+    hold(&kp, 1U << 0);
+    CHECK(written_count == 2 && written_is(0, EV_KEY, KEY_1, 1) && written_is(1, EV_SYN, SYN_REPORT, 0));
+    hold(&kp, 1U << 0);
+    CHECK(written_count == 0);
+
+    // A chord with a key of the upper word is reported once, the unmapped key is left out.
+    hold(&kp, (1U << 0) | (1U << 2) | (1U << 3));
+    CHECK(written_count == 2 && written_is(0, EV_KEY, KEY_ENTER, 1) && written_is(1, EV_SYN, SYN_REPORT, 0));
+
+    // Releasing all keys sends their releases in one report.
+    hold(&kp, 0);
+    CHECK(written_count == 3 && written_is(0, EV_KEY, KEY_1, 0) && written_is(1, EV_KEY, KEY_ENTER, 0));
+    CHECK(written_is(2, EV_SYN, SYN_REPORT, 0));
+
+    // Other keypads are not reported.
+    hold(&other, 1U << 1);
+    CHECK(written_count == 0);
+
+    printf("%s keypad_uinput\n", keypad_test_failures ? "FAIL" : "ok  ");
+    return keypad_test_failures != 0;
+}
@@ -0,0 +1,44 @@
+#ifndef MATRIX_KEYPAD_TEST_FREERTOS_H
+#define MATRIX_KEYPAD_TEST_FREERTOS_H
+
+/**
+ * Host stand-ins for the FreeRTOS headers, just enough to build the keypad modules on the host. Kernel functions
+ * are only declared: a test defines the ones the module under test calls, or links freertos_fake.c, which runs
+ * the kernel objects of keypad.c on a tick count the test advances. The tests are single threaded, so critical
+ * sections compile to nothing.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef long BaseType_t;
+typedef unsigned long UBaseType_t;
+typedef uint32_t TickType_t;
+typedef uint32_t StackType_t;
+
+#define pdFALSE 0
+#define pdTRUE  1
+#define pdFAIL  0
+#define pdPASS  1
+
+#define errQUEUE_FULL 0
+
+#define portMAX_DELAY            ((TickType_t)0xFFFFFFFFUL)
+#define configTICK_RATE_HZ       1000
+#define configMINIMAL_STACK_SIZE 128
+
+// Tests of the queue sets enable them on the command line, freertos_fake.c then implements them.
+#ifndef configUSE_QUEUE_SETS
+#define configUSE_QUEUE_SETS 0
+#endif
+
+#define portMEMORY_BARRIER() __asm volatile("" ::: "memory")
+
+// Tests of keypad.c define it to assert() before including the keypad headers.
+#ifndef configASSERT
+#define configASSERT(COND)
+#endif
+#define taskENTER_CRITICAL()
+#define taskEXIT_CRITICAL()
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef MATRIX_KEYPAD_TEST_EVENT_GROUPS_H
+#define MATRIX_KEYPAD_TEST_EVENT_GROUPS_H
+
+#include "task.h"
+
+typedef void* EventGroupHandle_t;
+typedef uint32_t EventBits_t;
+
+EventGroupHandle_t xEventGroupCreate(void);
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits);
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits);
+EventBits_t xEventGroupGetBits(EventGroupHandle_t group);
+
+#endif
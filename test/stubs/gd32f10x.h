@@ -0,0 +1,36 @@
+#ifndef MATRIX_KEYPAD_TEST_GD32F10X_H
+#define MATRIX_KEYPAD_TEST_GD32F10X_H
+
+/**
+ * Host stand-in for the GD32F10x device header, just the GPIO port addresses of the reference manual and the pin
+ * and clock names the example configuration of src/keypad_config.h uses, so its address macros can be checked.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define BIT(X) ((uint32_t)((uint32_t)0x01U << (X)))
+
+#define APB2_BUS_BASE 0x40010000UL
+#define GPIO_BASE     (APB2_BUS_BASE + 0x00000800UL)
+#define GPIOA         (GPIO_BASE + 0x00000000UL)
+#define GPIOB         (GPIO_BASE + 0x00000400UL)
+#define GPIOC         (GPIO_BASE + 0x00000800UL)
+#define GPIOD         (GPIO_BASE + 0x00000C00UL)
+#define GPIOE         (GPIO_BASE + 0x00001000UL)
+#define GPIOF         (GPIO_BASE + 0x00001400UL)
+#define GPIOG         (GPIO_BASE + 0x00001800UL)
+
+#define GPIO_PIN_0  BIT(0)
+#define GPIO_PIN_5  BIT(5)
+#define GPIO_PIN_7  BIT(7)
+#define GPIO_PIN_8  BIT(8)
+#define GPIO_PIN_9  BIT(9)
+#define GPIO_PIN_10 BIT(10)
+#define GPIO_PIN_11 BIT(11)
+#define GPIO_PIN_12 BIT(12)
+#define GPIO_PIN_15 BIT(15)
+
+typedef enum { RCU_GPIOA = 2, RCU_GPIOB, RCU_GPIOC, RCU_GPIOD, RCU_GPIOE, RCU_GPIOF, RCU_GPIOG } rcu_periph_enum;
+
+#endif
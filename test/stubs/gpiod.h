@@ -0,0 +1,37 @@
+#ifndef MATRIX_KEYPAD_TEST_GPIOD_H
+#define MATRIX_KEYPAD_TEST_GPIOD_H
+
+/**
+ * Subset of the libgpiod v1 API used by keypad_gpio_linux.c, implemented by the mock chip of the test that
+ * includes it. The declarations match libgpiod 1.6.
+ */
+
+#define GPIOD_LINE_BULK_MAX_LINES 64
+
+#define GPIOD_LINE_REQUEST_FLAG_OPEN_DRAIN   (1 << 0)
+#define GPIOD_LINE_REQUEST_FLAG_BIAS_PULL_UP (1 << 5)
+
+struct gpiod_chip;
+struct gpiod_line;
+
+struct gpiod_line_bulk {
+    struct gpiod_line* lines[GPIOD_LINE_BULK_MAX_LINES];
+    unsigned int num_lines;
+};
+
+struct gpiod_chip* gpiod_chip_open_lookup(const char* descr);
+void gpiod_chip_close(struct gpiod_chip* chip);
+int gpiod_chip_get_lines(struct gpiod_chip* chip, unsigned int* offsets, unsigned int num_offsets,
+                         struct gpiod_line_bulk* bulk);
+int gpiod_line_request_bulk_output_flags(struct gpiod_line_bulk* bulk, const char* consumer, int flags,
+                                         const int* default_vals);
+int gpiod_line_request_bulk_input_flags(struct gpiod_line_bulk* bulk, const char* consumer, int flags);
+void gpiod_line_release_bulk(struct gpiod_line_bulk* bulk);
+int gpiod_line_set_value(struct gpiod_line* line, int value);
+int gpiod_line_get_value_bulk(struct gpiod_line_bulk* bulk, int* values);
+
+static inline struct gpiod_line* gpiod_line_bulk_get_line(struct gpiod_line_bulk* bulk, unsigned int index) {
+    return bulk->lines[index];
+}
+
+#endif
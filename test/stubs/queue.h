@@ -0,0 +1,18 @@
+#ifndef MATRIX_KEYPAD_TEST_QUEUE_H
+#define MATRIX_KEYPAD_TEST_QUEUE_H
+
+#include "task.h"
+
+typedef void* QueueHandle_t;
+typedef void* QueueSetHandle_t;
+typedef void* QueueSetMemberHandle_t;
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size);
+BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t wait);
+BaseType_t xQueueReceive(QueueHandle_t queue, void* item, TickType_t wait);
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue);
+QueueSetHandle_t xQueueCreateSet(UBaseType_t length);
+BaseType_t xQueueAddToSet(QueueSetMemberHandle_t member, QueueSetHandle_t set);
+QueueSetMemberHandle_t xQueueSelectFromSet(QueueSetHandle_t set, TickType_t wait);
+
+#endif
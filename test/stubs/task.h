@@ -0,0 +1,25 @@
+#ifndef MATRIX_KEYPAD_TEST_TASK_H
+#define MATRIX_KEYPAD_TEST_TASK_H
+
+#include "FreeRTOS.h"
+
+typedef void* TaskHandle_t;
+typedef void (*TaskFunction_t)(void* param);
+
+#define tskIDLE_PRIORITY 0
+
+// MPU region descriptor, only named by the keypad API.
+typedef struct {
+    void* pvBaseAddress;
+    uint32_t ulLengthInBytes;
+    uint32_t ulParameters;
+} MemoryRegion_t;
+
+TickType_t xTaskGetTickCount(void);
+BaseType_t xTaskCreate(TaskFunction_t code, const char* name, uint32_t depth, void* param, UBaseType_t priority,
+                       TaskHandle_t* handle);
+void vTaskDelete(TaskHandle_t task);
+void vTaskDelay(TickType_t ticks);
+void vTaskPrioritySet(TaskHandle_t task, UBaseType_t priority);
+
+#endif
@@ -0,0 +1,16 @@
+#ifndef MATRIX_KEYPAD_TEST_TIMERS_H
+#define MATRIX_KEYPAD_TEST_TIMERS_H
+
+#include "task.h"
+
+typedef void* TimerHandle_t;
+typedef void (*TimerCallbackFunction_t)(TimerHandle_t timer);
+
+TimerHandle_t xTimerCreate(const char* name, TickType_t period, UBaseType_t reload, void* id,
+                           TimerCallbackFunction_t callback);
+BaseType_t xTimerReset(TimerHandle_t timer, TickType_t wait);
+BaseType_t xTimerStop(TimerHandle_t timer, TickType_t wait);
+BaseType_t xTimerChangePeriod(TimerHandle_t timer, TickType_t period, TickType_t wait);
+BaseType_t xTimerIsTimerActive(TimerHandle_t timer);
+
+#endif